@@ -0,0 +1,76 @@
+#!/bin/bash
+# ライブラリの動作確認用のサンプルをビルドして実行する(要Python環境)
+# どれか1つでも失敗すると終了コードが0以外になる
+#
+# ./check.sh
+
+mkdir -p build/check
+failed=0
+
+# ahc021 の入力をつくる
+python3 -c '
+import random
+random.seed(0)
+balls = list(range(465))
+random.shuffle(balls)
+k = 0
+for x in range(30):
+    print(*balls[k:k + x + 1])
+    k += x + 1
+' >build/check/ahc021_input.txt
+
+# $1 をビルドして build/check/$1 をつくる。残りの引数はコンパイラに渡す
+build() {
+    name=$1
+    shift
+    if ! g++ -std=c++20 -I thunder/ -O2 -Wall -Wextra "$@" thunder/$name.cpp -o build/check/$name; then
+        echo "NG: build $name"
+        failed=1
+        return 1
+    fi
+}
+
+# $1 をahc021の入力で実行し、出力を build/check/$1.out に書き出す
+run_ahc021() {
+    if ! build/check/$1 <build/check/ahc021_input.txt >build/check/$1.out 2>/dev/null; then
+        echo "NG: run $1"
+        failed=1
+        return 1
+    fi
+    echo "OK: $1"
+}
+
+# RollingSearch で1手ずつ確定した解を、サンプル自身が盤面で実行して確かめる
+for name in ahc021_edge_beam_rolling ahc021_skip_beam_rolling; do
+    build $name && run_ahc021 $name
+done
+
+# expand_batch で子をまとめて追加しても、expand で1つずつ追加したときと同じ解になるか
+if build ahc021_edge_beam_hash && build ahc021_edge_beam_batch &&
+    run_ahc021 ahc021_edge_beam_hash && run_ahc021 ahc021_edge_beam_batch; then
+    if cmp -s build/check/ahc021_edge_beam_hash.out build/check/ahc021_edge_beam_batch.out; then
+        echo "OK: expand_batch matches expand"
+    else
+        echo "NG: expand_batch differs from expand"
+        failed=1
+    fi
+fi
+
+# 書き換えて使うサンプルが、そのままで警告なしにビルドできるか
+for name in sample_annealing sample_mcts; do
+    build $name -Werror && echo "OK: build $name"
+done
+
+# filter_by_threshold のベクトル命令の分岐(AVX2, SSE2, スカラー)を、素朴な比較と突き合わせる
+for flags in "" "-mavx2" "-mno-sse2"; do
+    if build check_filter_by_threshold $flags; then
+        if build/check/check_filter_by_threshold 2>/dev/null; then
+            echo "OK: check_filter_by_threshold $flags"
+        else
+            echo "NG: check_filter_by_threshold $flags"
+            failed=1
+        fi
+    fi
+done
+
+exit $failed
@@ -10,10 +10,51 @@ def read_file_content(file_name: str) -> str:
         return f.read()
 
 
+class Conditions:
+    """#ifdef, #ifndef で無効になっている区間を追跡する
+
+    THUNDER_TRACE のように、defineしたときだけ読み込むファイルを展開しないために使う。
+    ソース中の #define だけを見るので、#if の式など判定できないものは有効として扱う
+    """
+
+    def __init__(self) -> None:
+        self.defined: Set[str] = set()
+        # (親が有効か, 条件を判定できたか, 今の分岐が有効か)
+        self.stack: list[tuple[bool, bool, bool]] = []
+
+    def active(self) -> bool:
+        return all(branch for _, _, branch in self.stack)
+
+    def update(self, line: str) -> None:
+        match = re.match(r"^\s*#\s*(\w+)\s*(\w*)", line)
+        if not match:
+            return
+        directive, name = match.groups()
+        parent = self.active()
+        if directive == "ifdef":
+            self.stack.append((parent, True, name in self.defined))
+        elif directive == "ifndef":
+            self.stack.append((parent, True, name not in self.defined))
+        elif directive == "if":
+            self.stack.append((parent, False, True))
+        elif directive == "elif" and self.stack:
+            self.stack[-1] = (self.stack[-1][0], False, True)
+        elif directive == "else" and self.stack:
+            _, known, branch = self.stack[-1]
+            self.stack[-1] = (self.stack[-1][0], known, not branch or not known)
+        elif directive == "endif" and self.stack:
+            self.stack.pop()
+        elif directive == "define" and parent:
+            self.defined.add(name)
+        elif directive == "undef" and parent:
+            self.defined.discard(name)
+
+
 def make_converted_file_content(
         file_name: str,
         stack: list[str],
-        added_file_names: Set[str]) -> str:
+        added_file_names: Set[str],
+        conditions: Conditions) -> str:
     print(file_name, added_file_names)
     content = read_file_content(file_name)
     content_lines = content.split("\n")
@@ -21,8 +62,9 @@ def make_converted_file_content(
     
     for i in range(len(content_lines)):
         line = content_lines[i]
+        conditions.update(line)
         match = re.match(r"^\s*#include\s+\"(.*)\"\s*$", line)
-        if match:
+        if match and conditions.active():
             included_file = os.path.join(base_dir, match.group(1))  # 相対パスを結合
             if included_file not in added_file_names:
                 if included_file in stack:
@@ -31,7 +73,7 @@ def make_converted_file_content(
                     exit(1)
                 stack.append(included_file)
                 content_lines[i] = make_converted_file_content(
-                    included_file, stack, added_file_names)
+                    included_file, stack, added_file_names, conditions)
                 added_file_names.add(included_file)
                 stack.pop()
             else:
@@ -44,7 +86,7 @@ def main(argv: list[str]):
         print("Usage: python3 combiner.py <source_file> <output_file>")
         sys.exit(1)
     converted_main_file_content = make_converted_file_content(
-        argv[1], [argv[1]], set())
+        argv[1], [argv[1]], set(), Conditions())
     with open(argv[2], "w") as f:
         f.write(converted_main_file_content)
 
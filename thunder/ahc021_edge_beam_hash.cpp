@@ -31,7 +31,12 @@ inline int get_pyramid_index(int x, int y)
 
 #include "lib/timer.cpp"
 #include "lib/edge_beam.cpp"
+#include "lib/undo_log.cpp"
+#include "lib/fastio.cpp"
+#include "lib/zobrist.cpp"
 using Hash = uint32_t;
+// 整列済みのボールがある位置ごとの乱数表。下位9bitは狙っているボールの位置に使う
+using SortedZobrist = ZobristTable<Hash, m>;
 
 struct Input
 {
@@ -45,7 +50,7 @@ struct Input
             b[x] = vector<int>(x + 1);
             for (int y = 0; y <= x; ++y)
             {
-                cin >> b[x][y];
+                fin >> b[x][y];
             }
         }
     }
@@ -87,15 +92,14 @@ public:
     int target_ball_;
     int potential_;
     Hash hash_;
-    vector<int> target_ball_history_;
-    vector<Hash> hash_history_;
+    // move_backward で戻す hash_, target_ball_
+    UndoLog<Hash, int> history_;
 
     StateBase() = default;
 
     explicit StateBase(const Input &input)
     {
-        hash_history_.reserve(max_turn);
-        target_ball_history_.reserve(max_turn);
+        history_.reset(max_turn + 1);
         b_ = input.b;
 
         for (int x = 0; x < n; ++x)
@@ -109,6 +113,7 @@ public:
         auto [new_target_ball, new_hash] = update_target_ball(0, 0);
         this->potential_ = 0;
         this->target_ball_ = new_target_ball;
+        this->hash_ = new_hash;
     }
 
     Hash update_target_position(Hash hash, int x, int y) const
@@ -118,10 +123,7 @@ public:
 
     Hash update_sorted_position(Hash hash, int x, int y) const
     {
-        Hash zobrist_hash = get_pyramid_index(x, y);
-        zobrist_hash |= 512U;                        // 10-bit
-        zobrist_hash *= zobrist_hash * zobrist_hash; // 30-bit
-        return hash ^ (zobrist_hash & hash_mask);
+        return hash ^ (SortedZobrist::get(get_pyramid_index(x, y)) & hash_mask);
     }
 
     // CostとHashの初期値を返す
@@ -151,7 +153,6 @@ public:
 
             move_forward(new_action);
             auto new_target_ball = this->target_ball_;
-            auto new_potential = this->potential_;
             auto new_hash = this->hash_;
             auto new_cost = evaluate();
             move_backward(new_action);
@@ -192,8 +193,7 @@ public:
     // actionを実行して次の状態に遷移する
     void move_forward(Action action)
     {
-        hash_history_.emplace_back(hash_);
-        target_ball_history_.emplace_back(target_ball_);
+        history_.push(hash_, target_ball_);
 
         auto [x1, y1, x2, y2] = action.decode();
         potential_ += b_[x1][y1] - b_[x2][y2];
@@ -210,16 +210,7 @@ public:
         auto [x1, y1, x2, y2] = action.decode();
         swap_balls(x1, y1, x2, y2);
         potential_ -= b_[x1][y1] - b_[x2][y2];
-        if (!hash_history_.empty())
-        {
-            hash_ = hash_history_.back();
-            hash_history_.pop_back();
-        }
-        if (!target_ball_history_.empty())
-        {
-            target_ball_ = target_ball_history_.back();
-            target_ball_history_.pop_back();
-        }
+        history_.pop(hash_, target_ball_);
     }
 
     void swap_balls(int x1, int y1, int x2, int y2)
@@ -285,19 +276,17 @@ struct Solver
 
     void print() const
     {
-        cout << output.size() << "\n";
+        fout << output.size() << "\n";
         for (Action action : output)
         {
             auto [x1, y1, x2, y2] = action.decode();
-            cout << x1 << " " << y1 << " " << x2 << " " << y2 << "\n";
+            fout << x1 << " " << y1 << " " << x2 << " " << y2 << "\n";
         }
     }
 };
 
 int main()
 {
-    ios::sync_with_stdio(false);
-    std::cin.tie(nullptr);
     Input input;
     input.input();
 
@@ -31,6 +31,8 @@ inline int get_pyramid_index(int x, int y)
 
 #include "lib/timer.cpp"
 #include "lib/edge_beam.cpp"
+#include "lib/undo_log.cpp"
+#include "lib/fastio.cpp"
 struct Input
 {
     vector<vector<int>> b;
@@ -43,7 +45,7 @@ struct Input
             b[x] = vector<int>(x + 1);
             for (int y = 0; y <= x; ++y)
             {
-                cin >> b[x][y];
+                fin >> b[x][y];
             }
         }
     }
@@ -82,13 +84,14 @@ public:
     array<pair<int, int>, m> positions_;
     int target_ball_;
     int potential_;
-    vector<int> target_ball_history_;
+    // move_backward で戻す target_ball_
+    UndoLog<int> history_;
 
     StateBase() = default;
 
     explicit StateBase(const Input &input)
     {
-        target_ball_history_.reserve(max_turn);
+        history_.reset(max_turn + 1);
         b_ = input.b;
 
         for (int x = 0; x < n; ++x)
@@ -170,7 +173,7 @@ public:
     // actionを実行して次の状態に遷移する
     void move_forward(Action action)
     {
-        target_ball_history_.emplace_back(target_ball_);
+        history_.push(target_ball_);
 
         auto [x1, y1, x2, y2] = action.decode();
         potential_ += b_[x1][y1] - b_[x2][y2];
@@ -185,11 +188,7 @@ public:
         auto [x1, y1, x2, y2] = action.decode();
         swap_balls(x1, y1, x2, y2);
         potential_ -= b_[x1][y1] - b_[x2][y2];
-        if (!target_ball_history_.empty())
-        {
-            target_ball_ = target_ball_history_.back();
-            target_ball_history_.pop_back();
-        }
+        history_.pop(target_ball_);
     }
 
     void swap_balls(int x1, int y1, int x2, int y2)
@@ -252,19 +251,17 @@ struct Solver
 
     void print() const
     {
-        cout << output.size() << "\n";
+        fout << output.size() << "\n";
         for (Action action : output)
         {
             auto [x1, y1, x2, y2] = action.decode();
-            cout << x1 << " " << y1 << " " << x2 << " " << y2 << "\n";
+            fout << x1 << " " << y1 << " " << x2 << " " << y2 << "\n";
         }
     }
 };
 
 int main()
 {
-    ios::sync_with_stdio(false);
-    std::cin.tie(nullptr);
     Input input;
     input.input();
 
@@ -0,0 +1,339 @@
+/**************************************************************/
+// Euler Tour の辺を保持する差分更新ビームサーチライブラリを使うサンプルコード(RollingSearch版)
+// 数ターン先まで探索してから1手ずつ確定し、確定した手を盤面で実行して正しく整列できたかを確かめる
+// 全体行数が長そうに見えるが、ライブラリ部分を除くとそれなりに短い。
+// ライブラリ部分はnamespaceで囲っているので、折りたたんで読むことを推奨。
+/**************************************************************/
+
+#pragma GCC optimize("O3")
+#pragma GCC optimize("unroll-loops")
+#include <bits/stdc++.h>
+#ifdef ONLINE_JUDGE
+// clang-format off
+#define cerr if (false) std::cerr
+// clang-format on
+#define NDEBUG
+#endif
+#include <atcoder/segtree>
+using namespace std;
+
+constexpr int n = 30;
+constexpr int m = n * (n + 1) / 2;
+
+constexpr int max_turn = 10000;
+constexpr size_t beam_width = 2000;
+// 最初のstepで何ターン先まで探索するか
+constexpr int lookahead = 30;
+constexpr size_t tour_capacity = 15 * beam_width;
+constexpr uint32_t hash_map_capacity = 16 * 3 * beam_width;
+constexpr int target_coefficient = 600;
+inline int get_pyramid_index(int x, int y)
+{
+    return x * (x - 1) / 2 + y;
+}
+
+#include "lib/timer.cpp"
+#include "lib/edge_beam.cpp"
+#include "lib/undo_log.cpp"
+#include "lib/fastio.cpp"
+#include "lib/zobrist.cpp"
+using Hash = uint32_t;
+// 整列済みのボールがある位置ごとの乱数表。下位9bitは狙っているボールの位置に使う
+using SortedZobrist = ZobristTable<Hash, m>;
+
+struct Input
+{
+    vector<vector<int>> b;
+
+    void input()
+    {
+        b.resize(n);
+        for (int x = 0; x < n; ++x)
+        {
+            b[x] = vector<int>(x + 1);
+            for (int y = 0; y <= x; ++y)
+            {
+                fin >> b[x][y];
+            }
+        }
+    }
+};
+using Cost = int;
+
+// 状態遷移を行うために必要な情報
+// メモリ使用量をできるだけ小さくしてください
+struct Action
+{
+    int xyxy;
+
+    Action(int x1, int y1, int x2, int y2)
+    {
+        xyxy = x1 | (y1 << 8) | (x2 << 16) | (y2 << 24);
+    }
+
+    tuple<int, int, int, int> decode() const
+    {
+        return {xyxy & 255, (xyxy >> 8) & 255, (xyxy >> 16) & 255, xyxy >> 24};
+    }
+
+    bool operator==(const Action &other) const
+    {
+        return xyxy == other.xyxy;
+    }
+};
+
+// 深さ優先探索に沿って更新する情報をまとめたクラス
+
+template <typename Selector>
+class StateBase
+{
+public:
+    const Hash hash_mask = ((1U << 23) - 1U) << 9; // 10-bit
+
+    vector<vector<int>> b_;
+    array<pair<int, int>, m> positions_;
+    int target_ball_;
+    int potential_;
+    Hash hash_;
+    // move_backward で戻す hash_, target_ball_
+    UndoLog<Hash, int> history_;
+
+    StateBase() = default;
+
+    explicit StateBase(const Input &input)
+    {
+        history_.reset(max_turn + 1);
+        b_ = input.b;
+
+        for (int x = 0; x < n; ++x)
+        {
+            for (int y = 0; y <= x; ++y)
+            {
+                positions_[b_[x][y]] = {x, y};
+            }
+        }
+
+        auto [new_target_ball, new_hash] = update_target_ball(0, 0);
+        this->potential_ = 0;
+        this->target_ball_ = new_target_ball;
+        this->hash_ = new_hash;
+    }
+
+    Hash update_target_position(Hash hash, int x, int y) const
+    {
+        return (hash & hash_mask) | get_pyramid_index(x, y);
+    }
+
+    Hash update_sorted_position(Hash hash, int x, int y) const
+    {
+        return hash ^ (SortedZobrist::get(get_pyramid_index(x, y)) & hash_mask);
+    }
+
+    // CostとHashの初期値を返す
+    pair<Cost, Hash> make_initial_node()
+    {
+        return {0, 0};
+    }
+
+    Cost evaluate() const
+    {
+        return potential_ - target_coefficient * target_ball_;
+    }
+
+    // 次の状態候補を全てselectorに追加する
+    // 引数
+    //   evaluator : 今の評価器
+    //   hash      : 今のハッシュ値
+    //   parent    : 今のノードID（次のノードにとって親となる）
+    void expand(int parent, Selector &selector)
+    {
+        auto push_candidate = [&](int x1, int y1, int x2, int y2)
+        {
+            assert(x1 > x2);
+            assert(b_[x1][y1] < b_[x2][y2]);
+
+            Action new_action(x1, y1, x2, y2);
+
+            move_forward(new_action);
+            auto new_target_ball = this->target_ball_;
+            auto new_hash = this->hash_;
+            auto new_cost = evaluate();
+            move_backward(new_action);
+
+            bool finished = (new_target_ball == m);
+
+            selector.push(new_action, new_cost, new_hash, parent, finished);
+        };
+
+        auto [x, y] = positions_[target_ball_];
+
+        if (can_move_left(x, y))
+        {
+            push_candidate(x, y, x - 1, y - 1);
+            if (can_move_left(x - 1, y - 1))
+            {
+                push_candidate(x - 1, y - 1, x - 2, y - 2);
+            }
+            if (can_move_right(x - 1, y - 1))
+            {
+                push_candidate(x - 1, y - 1, x - 2, y - 1);
+            }
+        }
+        if (can_move_right(x, y))
+        {
+            push_candidate(x, y, x - 1, y);
+            if (can_move_left(x - 1, y))
+            {
+                push_candidate(x - 1, y, x - 2, y - 1);
+            }
+            if (can_move_right(x - 1, y))
+            {
+                push_candidate(x - 1, y, x - 2, y);
+            }
+        }
+    }
+
+    // actionを実行して次の状態に遷移する
+    void move_forward(Action action)
+    {
+        history_.push(hash_, target_ball_);
+
+        auto [x1, y1, x2, y2] = action.decode();
+        potential_ += b_[x1][y1] - b_[x2][y2];
+        swap_balls(x1, y1, x2, y2);
+        auto [new_target_ball, new_hash] = update_target_ball(target_ball_, hash_);
+        target_ball_ = new_target_ball;
+        hash_ = new_hash;
+    }
+
+    // actionを実行する前の状態に遷移する
+    // 今の状態は、親からactionを実行して遷移した状態である
+    void move_backward(Action action)
+    {
+        auto [x1, y1, x2, y2] = action.decode();
+        swap_balls(x1, y1, x2, y2);
+        potential_ -= b_[x1][y1] - b_[x2][y2];
+        history_.pop(hash_, target_ball_);
+    }
+
+    void swap_balls(int x1, int y1, int x2, int y2)
+    {
+        int b1 = b_[x1][y1];
+        int b2 = b_[x2][y2];
+        b_[x1][y1] = b2;
+        b_[x2][y2] = b1;
+        positions_[b2] = {x1, y1};
+        positions_[b1] = {x2, y2};
+    }
+
+    bool can_move_left(int x, int y) const
+    {
+        return y && b_[x - 1][y - 1] > b_[x][y];
+    }
+
+    bool can_move_right(int x, int y) const
+    {
+        return y < x && b_[x - 1][y] > b_[x][y];
+    }
+
+    pair<int, Hash> update_target_ball(int target_ball, Hash hash) const
+    {
+        while (target_ball < m)
+        {
+            auto [x, y] = positions_[target_ball];
+            if (can_move_left(x, y) || can_move_right(x, y))
+            {
+                hash = update_target_position(hash, x, y);
+                break;
+            }
+            else
+            {
+                hash = update_sorted_position(hash, x, y);
+                ++target_ball;
+            }
+        }
+        return {target_ball, hash};
+    }
+};
+using BeamSearchUser = EdgeBeamSearch<Hash, Action, Cost, StateBase>;
+using State = StateBase<BeamSearchUser::Selector>;
+struct Solver
+{
+    const Input input;
+    vector<Action> output;
+
+    Solver(const Input &input) : input(input) {}
+
+    void solve()
+    {
+        BeamSearchUser::Config config = {
+            .max_turn = max_turn,
+            .beam_width = beam_width,
+            .tour_capacity = tour_capacity,
+            .hash_map_capacity = hash_map_capacity,
+            .return_finished_immediately = true};
+        State state(input);
+        BeamSearchUser::RollingSearch rolling_search(config, state);
+        // 初回はlookaheadターン先まで、以降は1ターンずつ深くしながら1手ずつ確定する
+        optional<Action> action = rolling_search.step(lookahead);
+        while (action && (int)output.size() < max_turn)
+        {
+            output.push_back(*action);
+            action = rolling_search.step(1);
+        }
+    }
+
+    // 確定した手を初期盤面から順に実行し、全てのボールが整列したかを確かめる
+    bool validate() const
+    {
+        vector<vector<int>> b = input.b;
+        for (Action action : output)
+        {
+            auto [x1, y1, x2, y2] = action.decode();
+            if (x1 != x2 + 1 || (y1 != y2 && y1 != y2 + 1))
+            {
+                return false;
+            }
+            swap(b[x1][y1], b[x2][y2]);
+        }
+        for (int x = 0; x + 1 < n; ++x)
+        {
+            for (int y = 0; y <= x; ++y)
+            {
+                if (b[x][y] > b[x + 1][y] || b[x][y] > b[x + 1][y + 1])
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void print() const
+    {
+        fout << output.size() << "\n";
+        for (Action action : output)
+        {
+            auto [x1, y1, x2, y2] = action.decode();
+            fout << x1 << " " << y1 << " " << x2 << " " << y2 << "\n";
+        }
+    }
+};
+
+int main()
+{
+    Input input;
+    input.input();
+
+    Solver solver(input);
+    solver.solve();
+    if (!solver.validate())
+    {
+        cerr << "invalid output" << endl;
+        return 1;
+    }
+    solver.print();
+    cerr << timer_library::timer.getTime() << " sec" << endl;
+
+    return 0;
+}
@@ -21,6 +21,9 @@ constexpr uint32_t hash_map_capacity = 16 * beam_width;
 
 #include "lib/timer.cpp"
 #include "lib/skip_beam.cpp"
+#include "lib/undo_log.cpp"
+#include "lib/fastio.cpp"
+#include "lib/zobrist.cpp"
 using namespace std;
 
 constexpr int n = 30;
@@ -38,7 +41,7 @@ struct Input
             b[x] = vector<int>(x + 1);
             for (int y = 0; y <= x; ++y)
             {
-                cin >> b[x][y];
+                fin >> b[x][y];
             }
         }
     }
@@ -52,6 +55,8 @@ constexpr int target_coefficient = 600;
 
 /// @brief TODO: Hashを表す型を非負整数型で指定(e.g. uint32_t, uint64_t)
 using Hash = uint32_t;
+// 整列済みのボールがある位置ごとの乱数表。下位9bitは狙っているボールの位置に使う
+using SortedZobrist = ZobristTable<Hash, m>;
 
 static constexpr Hash hash_mask = ((1U << 23) - 1U) << 9;
 
@@ -62,10 +67,7 @@ inline Hash update_target_position(Hash hash, int x, int y)
 
 inline Hash update_sorted_position(Hash hash, int x, int y)
 {
-    Hash zobrist_hash = get_pyramid_index(x, y);
-    zobrist_hash |= 512U;                        // 10-bit
-    zobrist_hash *= zobrist_hash * zobrist_hash; // 30-bit
-    return hash ^ (zobrist_hash & hash_mask);
+    return hash ^ (SortedZobrist::get(get_pyramid_index(x, y)) & hash_mask);
 }
 
 /// @brief TODO: 状態遷移を行うために必要な情報
@@ -103,8 +105,8 @@ private:
     Hash hash_;
     vector<vector<int>> b_;
     array<pair<int, int>, m> positions_;
-    vector<int> target_ball_history_;
-    vector<Hash> hash_history_;
+    // move_backward で戻す hash_, target_ball_
+    UndoLog<Hash, int> history_;
 
 public:
     /// @brief TODO: 次の状態候補を全てselectorに追加する
@@ -178,8 +180,7 @@ public:
     /// @brief TODO: actionを実行して次の状態に遷移する
     void move_forward(const Action action)
     {
-        hash_history_.emplace_back(hash_);
-        target_ball_history_.emplace_back(target_ball_);
+        history_.push(hash_, target_ball_);
 
         auto [x1, y1, x2, y2, x3, y3] = action.decode();
         potential_ += b_[x1][y1] - b_[x2][y2];
@@ -206,16 +207,7 @@ public:
         }
         swap_balls(x1, y1, x2, y2);
         potential_ -= b_[x1][y1] - b_[x2][y2];
-        if (!hash_history_.empty())
-        {
-            hash_ = hash_history_.back();
-            hash_history_.pop_back();
-        }
-        if (!target_ball_history_.empty())
-        {
-            target_ball_ = target_ball_history_.back();
-            target_ball_history_.pop_back();
-        }
+        history_.pop(hash_, target_ball_);
     }
 
     Cost evaluate() const
@@ -225,8 +217,7 @@ public:
 
     explicit StateBase(const Input &input)
     {
-        hash_history_.reserve(max_turn);
-        target_ball_history_.reserve(max_turn);
+        history_.reset(max_turn + 1);
         b_ = input.b;
 
         for (int x = 0; x < n; ++x)
@@ -318,14 +309,14 @@ struct Solver
                 ++output_size;
             }
         }
-        cout << output_size << "\n";
+        fout << output_size << "\n";
         for (Action action : output)
         {
             auto [x1, y1, x2, y2, x3, y3] = action.decode();
-            cout << x1 << " " << y1 << " " << x2 << " " << y2 << "\n";
+            fout << x1 << " " << y1 << " " << x2 << " " << y2 << "\n";
             if (x3)
             {
-                cout << x1 << " " << y1 << " " << x3 << " " << y3 << "\n";
+                fout << x1 << " " << y1 << " " << x3 << " " << y3 << "\n";
             }
         }
     }
@@ -333,9 +324,6 @@ struct Solver
 
 int main()
 {
-    ios::sync_with_stdio(false);
-    std::cin.tie(nullptr);
-
     Input input;
     input.input();
 
@@ -21,6 +21,8 @@ constexpr uint32_t hash_map_capacity = 16 * beam_width;
 
 #include "lib/timer.cpp"
 #include "lib/skip_beam.cpp"
+#include "lib/undo_log.cpp"
+#include "lib/fastio.cpp"
 using namespace std;
 
 constexpr int n = 30;
@@ -38,7 +40,7 @@ struct Input
             b[x] = vector<int>(x + 1);
             for (int y = 0; y <= x; ++y)
             {
-                cin >> b[x][y];
+                fin >> b[x][y];
             }
         }
     }
@@ -84,7 +86,8 @@ private:
     int potential_;
     vector<vector<int>> b_;
     array<pair<int, int>, m> positions_;
-    vector<int> target_ball_history_;
+    // move_backward で戻す target_ball_
+    UndoLog<int> history_;
 
 public:
     /// @brief TODO: 次の状態候補を全てselectorに追加する
@@ -156,7 +159,7 @@ public:
     /// @brief TODO: actionを実行して次の状態に遷移する
     void move_forward(const Action action)
     {
-        target_ball_history_.emplace_back(target_ball_);
+        history_.push(target_ball_);
 
         auto [x1, y1, x2, y2, x3, y3] = action.decode();
         potential_ += b_[x1][y1] - b_[x2][y2];
@@ -181,11 +184,7 @@ public:
         }
         swap_balls(x1, y1, x2, y2);
         potential_ -= b_[x1][y1] - b_[x2][y2];
-        if (!target_ball_history_.empty())
-        {
-            target_ball_ = target_ball_history_.back();
-            target_ball_history_.pop_back();
-        }
+        history_.pop(target_ball_);
     }
 
     Cost evaluate() const
@@ -195,7 +194,7 @@ public:
 
     explicit StateBase(const Input &input)
     {
-        target_ball_history_.reserve(max_turn);
+        history_.reset(max_turn + 1);
         b_ = input.b;
 
         for (int x = 0; x < n; ++x)
@@ -284,14 +283,14 @@ struct Solver
                 ++output_size;
             }
         }
-        cout << output_size << "\n";
+        fout << output_size << "\n";
         for (Action action : output)
         {
             auto [x1, y1, x2, y2, x3, y3] = action.decode();
-            cout << x1 << " " << y1 << " " << x2 << " " << y2 << "\n";
+            fout << x1 << " " << y1 << " " << x2 << " " << y2 << "\n";
             if (x3)
             {
-                cout << x1 << " " << y1 << " " << x3 << " " << y3 << "\n";
+                fout << x1 << " " << y1 << " " << x3 << " " << y3 << "\n";
             }
         }
     }
@@ -299,9 +298,6 @@ struct Solver
 
 int main()
 {
-    ios::sync_with_stdio(false);
-    std::cin.tie(nullptr);
-
     Input input;
     input.input();
 
@@ -0,0 +1,75 @@
+/**************************************************************/
+// edge_beam.cpp の filter_by_threshold の動作確認用コード
+// 乱数で作ったコストの列を、1つずつ比較する素朴な実装の結果と突き合わせる
+// AVX2, SSE2 のどちらを使うかはコンパイルオプションで変わるので、
+// check.sh で -mavx2, -mno-sse2 などを付けてそれぞれビルドして実行する
+/**************************************************************/
+
+#include "lib/edge_beam.cpp"
+using namespace std;
+using edge_beam_library::filter_by_threshold;
+
+// costs[i] <= threshold または finished[i] である添字 i を昇順に返す
+template <typename Cost>
+vector<int> naive_filter(const vector<Cost> &costs, const vector<uint8_t> &finished, Cost threshold)
+{
+    vector<int> survivors;
+    for (size_t i = 0; i < costs.size(); ++i)
+    {
+        if (finished[i] || costs[i] <= threshold)
+        {
+            survivors.push_back(i);
+        }
+    }
+    return survivors;
+}
+
+// 長さや値の範囲を変えながら、filter_by_threshold と naive_filter が一致するかを確かめる
+// 一致しなければ型の名前を表示して false を返す
+template <typename Cost>
+bool check(const char *name, mt19937_64 &rng)
+{
+    for (int iteration = 0; iteration < 2000; ++iteration)
+    {
+        // 8個ずつまとめて比較する部分と端数の両方を通るように、長さは0から40まで
+        size_t n = rng() % 41;
+        // 値の範囲を狭くして、閾値と等しいコストが出やすくする
+        int range = iteration % 2 == 0 ? 8 : 1000;
+        vector<Cost> costs(n);
+        vector<uint8_t> finished(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            costs[i] = (Cost)((int)(rng() % range) - (is_signed_v<Cost> ? range / 2 : 0));
+            finished[i] = rng() % 10 == 0;
+        }
+        Cost threshold = (Cost)((int)(rng() % range) - (is_signed_v<Cost> ? range / 2 : 0));
+
+        vector<int> survivors(n);
+        size_t num_survivors = filter_by_threshold(costs.data(), finished.data(), n, threshold, survivors.data());
+        survivors.resize(num_survivors);
+        if (survivors != naive_filter(costs, finished, threshold))
+        {
+            cerr << "filter_by_threshold<" << name << "> differs from naive_filter (n = " << n << ")" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    mt19937_64 rng(0);
+    bool ok = true;
+    ok &= check<int>("int", rng);
+    ok &= check<long long>("long long", rng);
+    ok &= check<float>("float", rng);
+    ok &= check<double>("double", rng);
+    ok &= check<short>("short", rng);
+    ok &= check<unsigned>("unsigned", rng);
+    if (!ok)
+    {
+        return 1;
+    }
+    cerr << "ok" << endl;
+    return 0;
+}
@@ -0,0 +1,365 @@
+/**************************************************************/
+// 焼きなまし法のライブラリ
+// Neighbor, Cost, State を自分で定義、実装して
+// using AnnealingUser = SimulatedAnnealing<Neighbor, Cost, StateBase>;
+// と記述し、
+// AnnealingUser annealing;
+// auto result = annealing.anneal(config, state);
+// で焼きなましを実行する。result.state が最もよかった状態になる。
+// ビームサーチで作った解を State にしてから局所改善する、という使い方を想定している。
+// State について
+// ビームサーチの move_forward, move_backward と同じように、
+// void propose(Neighbor &neighbor, Random &random)  近傍を1つ乱択して neighbor に書く(状態は変えない)
+// void apply(const Neighbor &neighbor)             neighbor に遷移する
+// void revert(const Neighbor &neighbor)            apply する前の状態に戻す
+// Cost evaluate() const                            今のコスト(小さいほどよい)
+// を実装する。さらに
+// Cost delta(const Neighbor &neighbor) const       neighbor に遷移したときのコストの変化量
+// を実装すると、apply せずに変化量だけで受理するかを決めるので、却下したときに revert しなくて済む。
+// delta を実装したうえで Config の batch_size を2以上にすると、近傍を batch_size 個まとめて作り、
+// 最初に受理されたものに遷移する(残りは捨てる)。低温で受理率が低いときに、
+// void propose_batch(Neighbor *neighbors, Cost *deltas, int n, Random &random)
+// を実装して変化量をまとめて(ベクトル化して)計算すると速くなる。
+// 温度
+// timer_library::timer の経過時間から、開始時から time_limit までの進み具合に応じて温度を決める。
+// 受理の判定は delta <= -温度 * log(一様乱数) で、log は表を引くので exp も log も呼ばない。
+// 並列
+// Config の num_replicas を2以上にすると、その数のスレッドで独立に焼きなまし、
+// exchange_interval 秒ごとに全体で最もよい状態を共有する(悪いレプリカはその状態から続ける)。
+// 探索中はメモリ確保をしない(State のコピー代入が確保しなければ、最良状態の保存でも確保しない)。
+/**************************************************************/
+#pragma once
+#ifndef ANNEALING_HPP
+#define ANNEALING_HPP
+#include <bits/stdc++.h>
+#include "timer.cpp"
+#include "random.cpp"
+// 内部のusing namespace std;が他のプログラムを破壊する可能性があるため、
+// ライブラリ全体をnamespaceで囲っている。
+namespace annealing_library
+{
+    using namespace std;
+
+    // 受理判定に使う -log(u) の表
+    // u は (0, 1) を LOG_TABLE_SIZE 等分した区間の中点
+    // 判定の粒度は 1/LOG_TABLE_SIZE になるが、焼きなましの結果にはほとんど影響しない
+    class NegativeLogTable
+    {
+    public:
+        static constexpr int LOG_TABLE_BITS = 16;
+        static constexpr int LOG_TABLE_SIZE = 1 << LOG_TABLE_BITS;
+
+        static const NegativeLogTable &get()
+        {
+            static const NegativeLogTable table;
+            return table;
+        }
+
+        // 乱数の上位 LOG_TABLE_BITS ビットで表を引く
+        double operator()(uint64_t random) const
+        {
+            return table_[random >> (64 - LOG_TABLE_BITS)];
+        }
+
+    private:
+        array<double, LOG_TABLE_SIZE> table_;
+
+        NegativeLogTable()
+        {
+            for (int i = 0; i < LOG_TABLE_SIZE; ++i)
+            {
+                table_[i] = -log((i + 0.5) / LOG_TABLE_SIZE);
+            }
+        }
+    };
+
+    template <typename CostType>
+    concept CostConcept = requires(CostType cost) {
+        { std::is_arithmetic_v<CostType> };
+    };
+
+    template <typename StateType, typename NeighborType, typename CostType, typename RandomType>
+    concept AnnealingStateConcept = CostConcept<CostType> &&
+                                    requires(StateType state, const StateType const_state, NeighborType neighbor, RandomType random) {
+                                        { state.propose(neighbor, random) } -> same_as<void>;
+                                        { state.apply(std::as_const(neighbor)) } -> same_as<void>;
+                                        { state.revert(std::as_const(neighbor)) } -> same_as<void>;
+                                        { const_state.evaluate() } -> same_as<CostType>;
+                                    };
+
+    // apply せずにコストの変化量を計算できるか
+    template <typename StateType, typename NeighborType, typename CostType>
+    concept DeltaConcept = requires(const StateType state, const NeighborType neighbor) {
+        { state.delta(neighbor) } -> same_as<CostType>;
+    };
+
+    // 近傍をまとめて作れるか
+    template <typename StateType, typename NeighborType, typename CostType, typename RandomType>
+    concept ProposeBatchConcept = requires(StateType state, NeighborType *neighbors, CostType *deltas, RandomType random) {
+        { state.propose_batch(neighbors, deltas, std::declval<int>(), random) } -> same_as<void>;
+    };
+
+    template <typename Neighbor, CostConcept Cost, template <typename> class State>
+    struct SimulatedAnnealing
+    {
+        // 近傍の乱択と受理判定で1反復に何度も呼ぶので、mt19937 より軽いものを使う(random.cpp参照)
+        using Random = Xoshiro256PlusPlus;
+
+        // 温度の決め方
+        enum class Schedule
+        {
+            // start_temperature から end_temperature まで指数的に下げる
+            Exponential,
+            // start_temperature から end_temperature まで線形に下げる
+            Linear,
+        };
+
+        // 焼きなましの設定
+        struct Config
+        {
+            // 終了する時刻(timer_library::timer の経過秒数)
+            double time_limit;
+            double start_temperature;
+            double end_temperature;
+            Schedule schedule = Schedule::Exponential;
+            // 進み具合(0以上1以下)から温度を返す関数。指定すると schedule の代わりに使う
+            function<double(double)> temperature_schedule = nullptr;
+            // 何反復ごとに時刻を確認して温度を更新するか
+            uint32_t time_check_interval = 256;
+            // 1回にまとめて作る近傍の数。State が delta を実装しているときだけ使う
+            int batch_size = 1;
+            uint64_t seed = 1;
+            // 並列に焼きなますスレッドの数
+            int num_replicas = 1;
+            // レプリカ間で最もよい状態を共有する間隔(秒)
+            double exchange_interval = 0.05;
+
+            // 進み具合 progress での温度
+            double get_temperature(double progress) const
+            {
+                if (temperature_schedule)
+                {
+                    return temperature_schedule(progress);
+                }
+                if (schedule == Schedule::Linear)
+                {
+                    return start_temperature + (end_temperature - start_temperature) * progress;
+                }
+                return start_temperature * pow(end_temperature / start_temperature, progress);
+            }
+        };
+
+        // 焼きなましの結果
+        struct Result
+        {
+            // 最もよかった状態とそのコスト
+            State<Random> state;
+            Cost cost;
+            // 全レプリカの合計の反復回数と受理回数
+            uint64_t iterations = 0;
+            uint64_t accepted = 0;
+        };
+
+        // 焼きなましを行う関数
+        Result anneal(const Config &config, const State<Random> &state)
+        {
+            assert(config.num_replicas >= 1 && config.batch_size >= 1);
+            Shared shared(state);
+            if (config.num_replicas == 1)
+            {
+                Replica replica(config, state, make_thread_seed(config.seed, 0), shared);
+                replica.run();
+            }
+            else
+            {
+                vector<thread> threads;
+                threads.reserve(config.num_replicas);
+                for (int i = 0; i < config.num_replicas; ++i)
+                {
+                    threads.emplace_back([&, i]()
+                                         {
+                                             Replica replica(config, state, make_thread_seed(config.seed, i), shared);
+                                             replica.run(); });
+                }
+                for (thread &th : threads)
+                {
+                    th.join();
+                }
+            }
+            return Result{move(shared.best_state), shared.best_cost, shared.iterations, shared.accepted};
+        }
+
+    private:
+        // レプリカ間で共有する最良の状態
+        struct Shared
+        {
+            mutex mtx;
+            State<Random> best_state;
+            Cost best_cost;
+            // 読むだけならロックしなくてよいように、best_cost を別に持つ
+            atomic<Cost> best_cost_hint;
+            uint64_t iterations = 0;
+            uint64_t accepted = 0;
+
+            explicit Shared(const State<Random> &state) : best_state(state),
+                                                          best_cost(state.evaluate()),
+                                                          best_cost_hint(best_cost) {}
+        };
+
+        // 1つのスレッドで焼きなます
+        class Replica
+        {
+        public:
+            Replica(const Config &config, const State<Random> &state, uint64_t seed, Shared &shared) : config_(config),
+                                                                                                       state_(state),
+                                                                                                       best_state_(state),
+                                                                                                       random_(seed),
+                                                                                                       shared_(shared),
+                                                                                                       log_table_(NegativeLogTable::get())
+            {
+                cost_ = state_.evaluate();
+                best_cost_ = cost_;
+                neighbors_.resize(config_.batch_size);
+                deltas_.resize(config_.batch_size);
+            }
+
+            void run()
+            {
+                double start_time = timer_library::timer.getTime();
+                double duration = config_.time_limit - start_time;
+                double next_exchange = start_time + config_.exchange_interval;
+                while (true)
+                {
+                    double now = timer_library::timer.getTime();
+                    if (now >= config_.time_limit)
+                    {
+                        break;
+                    }
+                    if (config_.num_replicas > 1 && now >= next_exchange)
+                    {
+                        exchange();
+                        next_exchange = now + config_.exchange_interval;
+                    }
+                    double progress = duration > 0 ? (now - start_time) / duration : 1.0;
+                    double temperature = config_.get_temperature(progress);
+
+                    for (uint32_t k = 0; k < config_.time_check_interval; ++k)
+                    {
+                        if (step(temperature) && cost_ < best_cost_)
+                        {
+                            best_cost_ = cost_;
+                            best_state_ = state_;
+                        }
+                    }
+                }
+                exchange();
+
+                lock_guard<mutex> lock(shared_.mtx);
+                shared_.iterations += iterations_;
+                shared_.accepted += accepted_;
+            }
+
+        private:
+            const Config &config_;
+            State<Random> state_;
+            Cost cost_;
+            State<Random> best_state_;
+            Cost best_cost_;
+            Random random_;
+            Shared &shared_;
+            const NegativeLogTable &log_table_;
+            // 近傍をまとめて作るときのバッファ。探索中にメモリ確保をしないように先に確保する
+            vector<Neighbor> neighbors_;
+            vector<Cost> deltas_;
+            uint64_t iterations_ = 0;
+            uint64_t accepted_ = 0;
+
+            // 温度 temperature で近傍を受理するか
+            bool accept(Cost delta, double temperature)
+            {
+                return delta <= 0 || (double)delta <= temperature * log_table_(random_());
+            }
+
+            // 近傍を作って受理するか決める。受理したらtrueを返す
+            bool step(double temperature)
+            {
+                if constexpr (DeltaConcept<State<Random>, Neighbor, Cost>)
+                {
+                    int n = config_.batch_size;
+                    iterations_ += n;
+                    if constexpr (ProposeBatchConcept<State<Random>, Neighbor, Cost, Random>)
+                    {
+                        state_.propose_batch(neighbors_.data(), deltas_.data(), n, random_);
+                    }
+                    else
+                    {
+                        for (int i = 0; i < n; ++i)
+                        {
+                            state_.propose(neighbors_[i], random_);
+                            deltas_[i] = state_.delta(neighbors_[i]);
+                        }
+                    }
+                    for (int i = 0; i < n; ++i)
+                    {
+                        if (accept(deltas_[i], temperature))
+                        {
+                            state_.apply(neighbors_[i]);
+                            cost_ += deltas_[i];
+                            ++accepted_;
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+                else
+                {
+                    ++iterations_;
+                    Neighbor &neighbor = neighbors_[0];
+                    state_.propose(neighbor, random_);
+                    state_.apply(neighbor);
+                    Cost new_cost = state_.evaluate();
+                    if (accept(new_cost - cost_, temperature))
+                    {
+                        cost_ = new_cost;
+                        ++accepted_;
+                        return true;
+                    }
+                    state_.revert(neighbor);
+                    return false;
+                }
+            }
+
+            // 最もよい状態を共有する
+            // 自分の最良が全体の最良より良ければ全体の最良を更新し、
+            // 全体の最良のほうが良ければ、今の状態をそれに置き換えて続ける
+            void exchange()
+            {
+                if (shared_.best_cost_hint.load(memory_order_relaxed) == best_cost_)
+                {
+                    // 共有するものも受け取るものもない
+                    return;
+                }
+                lock_guard<mutex> lock(shared_.mtx);
+                if (best_cost_ < shared_.best_cost)
+                {
+                    shared_.best_cost = best_cost_;
+                    shared_.best_state = best_state_;
+                    shared_.best_cost_hint.store(best_cost_, memory_order_relaxed);
+                }
+                else if (shared_.best_cost < best_cost_)
+                {
+                    best_cost_ = shared_.best_cost;
+                    best_state_ = shared_.best_state;
+                    state_ = shared_.best_state;
+                    cost_ = best_cost_;
+                }
+            }
+        };
+
+        // AnnealingStateConcept のチェックを構造体内で実施
+        static_assert(AnnealingStateConcept<State<Random>, Neighbor, Cost, Random>,
+                      "State template must satisfy AnnealingStateConcept with SimulatedAnnealing::Random");
+    }; // SimulatedAnnealing
+} // namespace annealing_library
+using namespace annealing_library;
+#endif
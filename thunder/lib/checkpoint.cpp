@@ -0,0 +1,348 @@
+/**************************************************************/
+// ビームサーチの途中経過をファイルに保存し、そこから再開するためのライブラリ
+// 数分以上かかる事前計算などで、途中でプロセスが落ちても最初からやり直さずに済む。
+// THUNDER_CHECKPOINT を define し、ビームサーチライブラリの Config に
+// checkpoint_path, checkpoint_interval, resume_from_checkpoint を指定すると、
+// checkpoint_interval ターンごとに Euler Tour(またはノード)や Selector などをまとめて書き出し、
+// 次に実行したときにファイルがあればそのターンから再開する。
+// ファイルは path.tmp に書いてから rename するので、書き込み中に落ちても前のファイルは壊れない。
+// 配列は要素数の後に64バイト境界から生のバイト列として並べるので、
+// 読み込みは mmap したファイルからのコピー1回で済み、大きな Euler Tour でもすぐに再開できる。
+// 同じマシン、同じプログラムで保存と再開をすることを前提にしている(エンディアンなどは揃えない)。
+// State について
+// State に
+// void save(CheckpointWriter &writer) const
+// void load(CheckpointReader &reader)
+// を実装すると、再開時に load で State を復元する。
+// 実装しなければ、ビームサーチに渡した初期状態から確定済みのactionを move_forward でたどり直して復元する。
+// move_forward でたどれない情報(乱数の状態など)を持つときだけ実装すればよい。
+/**************************************************************/
+#pragma once
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+#include <bits/stdc++.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+// 内部のusing namespace std;が他のプログラムを破壊する可能性があるため、
+// ライブラリ全体をnamespaceで囲っている。
+namespace checkpoint_library
+{
+    using namespace std;
+
+    // ファイルの先頭に書く値("THNDCKPT")
+    constexpr uint64_t CHECKPOINT_MAGIC = 0x54504b43444e4854ULL;
+    // 形式を変えたら増やす
+    constexpr uint64_t CHECKPOINT_VERSION = 1;
+    // 配列の先頭を揃える境界
+    constexpr size_t CHECKPOINT_ALIGNMENT = 64;
+
+    //@brief バイト列としてそのまま書き出せる型か
+    //@note pair と tuple はコピー代入が自前定義なので trivially copyable にならないが、
+    //      要素がそうであればバイト列としてコピーしても問題ないので含める
+    template <class T>
+    struct is_raw_serializable : bool_constant<is_trivially_copyable_v<T>>
+    {
+    };
+    template <class T, class U>
+    struct is_raw_serializable<pair<T, U>> : bool_constant<is_raw_serializable<T>::value && is_raw_serializable<U>::value>
+    {
+    };
+    template <class... Ts>
+    struct is_raw_serializable<tuple<Ts...>> : bool_constant<(is_raw_serializable<Ts>::value && ...)>
+    {
+    };
+    template <class T, size_t N>
+    struct is_raw_serializable<array<T, N>> : is_raw_serializable<T>
+    {
+    };
+    template <class T>
+    constexpr bool is_raw_serializable_v = is_raw_serializable<T>::value;
+
+    //@brief チェックポイントの読み書きに失敗したときは、続けても意味がないので終了する
+    [[noreturn]] inline void checkpoint_error(const string &message)
+    {
+        cerr << "ERROR: checkpoint: " << message << endl;
+        exit(-1);
+    }
+
+    //@brief チェックポイントを書き出すクラス
+    //@note commit を呼ぶまでは path.tmp に書くだけで、path は変更しない
+    class CheckpointWriter
+    {
+    public:
+        explicit CheckpointWriter(const string &path) : path_(path), tmp_path_(path + ".tmp")
+        {
+            fd_ = open(tmp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd_ == -1)
+            {
+                checkpoint_error("cannot open " + tmp_path_);
+            }
+            buffer_.reserve(BUFFER_SIZE);
+            write(CHECKPOINT_MAGIC);
+            write(CHECKPOINT_VERSION);
+        }
+
+        CheckpointWriter(const CheckpointWriter &) = delete;
+        CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+        // commit せずに破棄したときは書きかけのファイルを消す
+        ~CheckpointWriter()
+        {
+            if (fd_ != -1)
+            {
+                close(fd_);
+                unlink(tmp_path_.c_str());
+            }
+        }
+
+        //@brief 値を1つ書き出す
+        template <class T>
+        void write(const T &value)
+        {
+            static_assert(is_raw_serializable_v<T>, "T must be trivially copyable");
+            write_bytes(&value, sizeof(T));
+        }
+
+        //@brief 配列を、要素数と64バイト境界から始まるバイト列として書き出す
+        template <class T>
+        void write_vector(const vector<T> &values)
+        {
+            write_array(values.data(), values.size());
+        }
+
+        //@brief data から n 個の要素を write_vector と同じ形式で書き出す
+        //@note vector 以外の連続した領域を書き出すときに使う。read_vector, view_vector で読める
+        template <class T>
+        void write_array(const T *data, size_t n)
+        {
+            static_assert(is_raw_serializable_v<T>, "T must be trivially copyable");
+            write<uint64_t>(n);
+            pad();
+            write_bytes(data, n * sizeof(T));
+        }
+
+        //@brief 書き出した内容をディスクに反映し、path に置き換える
+        void commit()
+        {
+            flush();
+            if (fsync(fd_) == -1 || close(fd_) == -1)
+            {
+                fd_ = -1;
+                checkpoint_error("cannot write " + tmp_path_);
+            }
+            fd_ = -1;
+            if (rename(tmp_path_.c_str(), path_.c_str()) == -1)
+            {
+                checkpoint_error("cannot rename " + tmp_path_ + " to " + path_);
+            }
+        }
+
+    private:
+        static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+        string path_;
+        string tmp_path_;
+        int fd_;
+        // 小さな値をまとめて書くためのバッファ
+        vector<char> buffer_;
+        // ファイルの先頭から何バイト書いたか(バッファ内の分も含む)
+        size_t offset_ = 0;
+
+        void write_bytes(const void *data, size_t size)
+        {
+            offset_ += size;
+            if (buffer_.size() + size <= BUFFER_SIZE)
+            {
+                const char *bytes = static_cast<const char *>(data);
+                buffer_.insert(buffer_.end(), bytes, bytes + size);
+                return;
+            }
+            // 大きな配列はバッファを通さずに書く
+            flush();
+            write_all(data, size);
+        }
+
+        // 次の書き込み位置を CHECKPOINT_ALIGNMENT の倍数にする
+        void pad()
+        {
+            static constexpr char zeros[CHECKPOINT_ALIGNMENT] = {};
+            size_t padding = (CHECKPOINT_ALIGNMENT - offset_ % CHECKPOINT_ALIGNMENT) % CHECKPOINT_ALIGNMENT;
+            write_bytes(zeros, padding);
+        }
+
+        void flush()
+        {
+            write_all(buffer_.data(), buffer_.size());
+            buffer_.clear();
+        }
+
+        void write_all(const void *data, size_t size)
+        {
+            const char *bytes = static_cast<const char *>(data);
+            while (size > 0)
+            {
+                ssize_t written = ::write(fd_, bytes, size);
+                if (written == -1)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    checkpoint_error("cannot write " + tmp_path_);
+                }
+                bytes += written;
+                size -= written;
+            }
+        }
+    };
+
+    //@brief CheckpointWriter で書き出したファイルを mmap して読み込むクラス
+    //@note 書き出したときと同じ順番、同じ型で読む
+    class CheckpointReader
+    {
+    public:
+        explicit CheckpointReader(const string &path) : path_(path)
+        {
+            int fd = open(path_.c_str(), O_RDONLY);
+            if (fd == -1)
+            {
+                checkpoint_error("cannot open " + path_);
+            }
+            struct stat st;
+            if (fstat(fd, &st) == -1)
+            {
+                close(fd);
+                checkpoint_error("cannot stat " + path_);
+            }
+            size_ = st.st_size;
+            if (size_ > 0)
+            {
+                void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (data == MAP_FAILED)
+                {
+                    close(fd);
+                    checkpoint_error("cannot mmap " + path_);
+                }
+                data_ = static_cast<const char *>(data);
+                // 先頭から順に読むので、先読みを多めにしてもらう
+                madvise(const_cast<char *>(data_), size_, MADV_SEQUENTIAL);
+            }
+            // mmap した領域はファイルを閉じても読める
+            close(fd);
+            if (read<uint64_t>() != CHECKPOINT_MAGIC)
+            {
+                checkpoint_error(path_ + " is not a checkpoint file");
+            }
+            if (read<uint64_t>() != CHECKPOINT_VERSION)
+            {
+                checkpoint_error(path_ + " was written by another version");
+            }
+        }
+
+        CheckpointReader(const CheckpointReader &) = delete;
+        CheckpointReader &operator=(const CheckpointReader &) = delete;
+
+        ~CheckpointReader()
+        {
+            if (data_ != nullptr)
+            {
+                munmap(const_cast<char *>(data_), size_);
+            }
+        }
+
+        //@brief チェックポイントのファイルがあるか
+        static bool exists(const string &path)
+        {
+            return access(path.c_str(), R_OK) == 0;
+        }
+
+        //@brief 値を1つ読む
+        template <class T>
+        T read()
+        {
+            static_assert(is_raw_serializable_v<T>, "T must be trivially copyable");
+            // デフォルトコンストラクタがない型(Actionなど)も読めるように、バイト列を経由する
+            alignas(T) unsigned char bytes[sizeof(T)];
+            memcpy(bytes, take(sizeof(T)), sizeof(T));
+            return *reinterpret_cast<const T *>(bytes);
+        }
+
+        //@brief 値を1つ読んで value に書き込む
+        template <class T>
+        void read(T &value)
+        {
+            value = read<T>();
+        }
+
+        //@brief 値を1つ読み、expected と一致しなければ終了する
+        //@note 保存したときと設定や型が変わっていないかの確認に使う
+        template <class T>
+        void expect(const T &expected, const char *name)
+        {
+            if (read<T>() != expected)
+            {
+                checkpoint_error(string(name) + " differs from " + path_);
+            }
+        }
+
+        //@brief write_vector で書き出した配列を、コピーせずにファイル上の領域として返す
+        //@note 戻り値は CheckpointReader を破棄するまで使える
+        template <class T>
+        span<const T> view_vector()
+        {
+            static_assert(is_raw_serializable_v<T>, "T must be trivially copyable");
+            static_assert(alignof(T) <= CHECKPOINT_ALIGNMENT);
+            size_t n = read<uint64_t>();
+            skip_padding();
+            if (n > (size_ - offset_) / max<size_t>(sizeof(T), 1))
+            {
+                checkpoint_error(path_ + " is truncated");
+            }
+            const T *data = reinterpret_cast<const T *>(take(n * sizeof(T)));
+            return span<const T>(data, n);
+        }
+
+        //@brief write_vector で書き出した配列を values に読み込む
+        template <class T>
+        void read_vector(vector<T> &values)
+        {
+            span<const T> view = view_vector<T>();
+            values.assign(view.begin(), view.end());
+        }
+
+    private:
+        string path_;
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+        // 次に読む位置
+        size_t offset_ = 0;
+
+        const char *take(size_t size)
+        {
+            if (size > size_ - offset_)
+            {
+                checkpoint_error(path_ + " is truncated");
+            }
+            const char *ret = data_ + offset_;
+            offset_ += size;
+            return ret;
+        }
+
+        void skip_padding()
+        {
+            take((CHECKPOINT_ALIGNMENT - offset_ % CHECKPOINT_ALIGNMENT) % CHECKPOINT_ALIGNMENT);
+        }
+    };
+
+    //@brief State が save, load を実装しているか
+    template <typename StateType>
+    concept CheckpointableState = requires(const StateType &const_state, StateType &state,
+                                           CheckpointWriter &writer, CheckpointReader &reader) {
+        { const_state.save(writer) } -> same_as<void>;
+        { state.load(reader) } -> same_as<void>;
+    };
+} // namespace checkpoint_library
+using namespace checkpoint_library;
+#endif
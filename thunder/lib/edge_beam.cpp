@@ -15,18 +15,57 @@
 // eijirouさんの記事を参考にしているが、
 // Evaluatorを使っていないのでどこを変えるべきかがやや明確な気がする。
 // 参考: https://eijirou-kyopro.hatenablog.com/entry/2024/02/01/115639
+// 子のコストやハッシュをまとめて計算したい場合は、expand の代わりに
+// void expand_batch(int parent, typename Selector::Batch &batch)
+// を実装すると、batch.push(action, コストの差分, ハッシュの差分(XOR), finished) で子を書き込める。
+// エンジン側で子のコストとハッシュを配列のまままとめて計算し、閾値で絞ってからselectorに追加する。
 // 要件
 // ac-liblrary: https://github.com/atcoder/ac-library
 // 推奨
 // 単にコピペしただけでも使えるが、ymatsuxさんの分割コンパイルツールと合わせると
 // ローカルのコードがすっきりしてオススメ
 // https://github.com/ymatsux/competitive-programming/tree/main/combiner
+// プロファイル
+// THUNDER_PROFILE を define すると、dfs, expand, select, update の区間ごとの時間を集計して終了時に表示する(timer.cpp参照)
+// THUNDER_TRACE を define すると、ターンごとの dfs, update の区間と Euler Tour の長さ、葉の数を記録する(trace.cpp参照)
+// THUNDER_PERF を define すると、dfs, update, commit のハードウェアカウンタ(サイクル数、キャッシュミス、分岐予測ミスなど)をターンごとに表示する(perf_counter.cpp参照)
+// チェックポイント
+// THUNDER_CHECKPOINT を define して Config の checkpoint_path, checkpoint_interval を指定すると、beam_search の途中経過を定期的にファイルに保存し、
+// resume_from_checkpoint を true にして実行し直すと、保存したターンから再開する(checkpoint.cpp参照)
+// 探索のやり直し(beam stack search)
+// Config の backtrack_width を指定すると、ビームに入らなかった候補をターンごとに覚えておき、
+// 実行可能解が見つかる前にビームが途絶えたら、覚えている中で最も深いターンの候補から beam_search を続ける
+// 複数の初期状態
+// beam_search に roots を渡すと、渡した状態を仮想的な根とし、roots[k].action で移る複数の初期状態から1回で探索する
 /**************************************************************/
 #pragma once
 #ifndef EDGE_BEAM_HPP
 #define EDGE_BEAM_HPP
 #include <bits/stdc++.h>
 #include <atcoder/segtree>
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "timer.cpp"
+// trace.cpp, perf_counter.cpp, checkpoint.cpp は有効にしたときだけ読み込む。無効なら計測用のマクロは何もしない
+#ifdef THUNDER_TRACE
+#include "trace.cpp"
+#else
+#define THUNDER_TRACE_SCOPE(label)
+#define THUNDER_TRACE_COUNTER(name, value)
+#endif
+#ifdef THUNDER_PERF
+#include "perf_counter.cpp"
+#else
+#define THUNDER_PERF_SCOPE(label)
+#define THUNDER_PERF_TURN_END()
+#endif
+#ifdef THUNDER_CHECKPOINT
+#include "checkpoint.cpp"
+#endif
+#include "random.cpp"
 
 namespace edge_beam_library
 {
@@ -72,6 +111,12 @@ namespace edge_beam_library
             return {false, i};
         }
 
+        // keyを探すときに最初に見る位置をキャッシュに読み込んでおく
+        void prefetch(Key key) const
+        {
+            __builtin_prefetch(&data_[key % n_]);
+        }
+
         // 指定したindexにkeyとvalueを格納する
         void set(int i, Key key, T value)
         {
@@ -97,251 +142,3429 @@ namespace edge_beam_library
         vector<pair<Key, T>> data_;
     };
 
-    template <typename HashType>
-    concept HashConcept = requires(HashType hash) {
-        { std::is_unsigned_v<HashType> };
-    };
-    template <typename CostType>
-    concept CostConcept = requires(CostType cost) {
-        { std::is_arithmetic_v<CostType> };
-    };
-
-    template <typename StateType, typename HashType, typename CostType, typename ActionType, typename SelectorType>
-    concept StateConcept = HashConcept<HashType> &&
-                           CostConcept<CostType> &&
-                           requires(StateType state, SelectorType selector) {
-                               { state.expand(std::declval<int>(), selector) } -> same_as<void>;
-                               { state.move_forward(std::declval<ActionType>()) } -> same_as<void>;
-                               { state.move_backward(std::declval<ActionType>()) } -> same_as<void>;
-                               { state.make_initial_node() } -> same_as<pair<CostType, HashType>>;
-                           };
+    // 64bitの値をよく混ぜる
+    // ユーザのハッシュ値は下位ビットに偏りがあることがあるので、Bloom filterなどの位置を決める前に通す
+    inline uint64_t mix_hash(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
 
-    template <HashConcept Hash, typename Action, CostConcept Cost, template <typename> class State>
-    struct EdgeBeamSearch
+    // ブロック化したBloom filter
+    // 1つの要素のビットは全て同じ64バイトのブロックに立てるので、1回の確認でキャッシュミスは高々1回
+    // 偽陽性(追加していない要素を追加済みと判定すること)はあるが、偽陰性はない
+    class BlockedBloomFilter
     {
-        // ビームサーチの設定
-        struct Config
-        {
-            int max_turn;
-            size_t beam_width;
-            size_t tour_capacity;
-            uint32_t hash_map_capacity;
-            // 実行可能解が見つかったらすぐに返すかどうか
-            // ビーム内のターンと問題文のターンが同じレイヤーで、
-            // かつターン数最小化問題であればtrueにする。
-            // そうでなければfalse
-            bool return_finished_immediately;
-        };
+    public:
+        BlockedBloomFilter() = default;
 
-        // 展開するノードの候補を表す構造体
-        struct Candidate
+        //@param expected_insertions 1ターンに追加する要素数の見込み
+        //@param false_positive_rate 見込み通りの要素数を追加したときの偽陽性率
+        BlockedBloomFilter(size_t expected_insertions, double false_positive_rate)
         {
-            Action action;
-            Cost cost;
-            Hash hash;
-            int parent;
-
-            Candidate(Action action, Cost cost, Hash hash, int parent) : action(action),
-                                                                         cost(cost),
-                                                                         hash(hash),
-                                                                         parent(parent) {}
-        };
+            expected_insertions = max<size_t>(expected_insertions, 1);
+            // ビット数 m = -n ln p / (ln 2)^2、ビットを立てる個数 k = m / n ln 2
+            double bits = -(double)expected_insertions * log(false_positive_rate) / (log(2.0) * log(2.0));
+            num_bits_per_insertion_ = clamp((int)round(bits / expected_insertions * log(2.0)), 1, 16);
+            size_t num_blocks = 1;
+            while (num_blocks * BLOCK_BITS < bits)
+            {
+                num_blocks *= 2;
+            }
+            block_mask_ = num_blocks - 1;
+            blocks_.assign(num_blocks, {});
+        }
 
-        // ノードの候補から実際に追加するものを選ぶクラス
-        // ビーム幅の個数だけ、評価がよいものを選ぶ
-        // ハッシュ値が一致したものについては、評価がよいほうのみを残す
-        class Selector
+        //@brief keyを追加する
+        //@return 追加する前から含まれていた(と判定された)か
+        bool insert(uint64_t key)
         {
-        public:
-            explicit Selector(const Config &config) : hash_to_index_(config.hash_map_capacity)
+            uint64_t h = mix_hash(key);
+            Block &block = blocks_[h & block_mask_];
+            // 上位ビットで位置を決めるので、増分も64bit全体に散らばるようにする
+            uint64_t step = ((h << 32) | (h >> 32)) | 1;
+            bool contained = true;
+            for (int i = 0; i < num_bits_per_insertion_; ++i)
             {
-                beam_width = config.beam_width;
-                candidates_.reserve(beam_width);
-                full_ = false;
+                h += step;
+                uint32_t bit = h >> (64 - 9);
+                uint64_t mask = 1ULL << (bit & 63);
+                contained &= (block[bit >> 6] & mask) != 0;
+                block[bit >> 6] |= mask;
+            }
+            return contained;
+        }
 
-                costs_.resize(beam_width);
-                for (size_t i = 0; i < beam_width; ++i)
+        //@brief keyが含まれている(と判定される)か
+        bool contains(uint64_t key) const
+        {
+            uint64_t h = mix_hash(key);
+            const Block &block = blocks_[h & block_mask_];
+            // 上位ビットで位置を決めるので、増分も64bit全体に散らばるようにする
+            uint64_t step = ((h << 32) | (h >> 32)) | 1;
+            for (int i = 0; i < num_bits_per_insertion_; ++i)
+            {
+                h += step;
+                uint32_t bit = h >> (64 - 9);
+                if ((block[bit >> 6] >> (bit & 63) & 1) == 0)
                 {
-                    costs_[i] = {0, i};
+                    return false;
                 }
             }
+            return true;
+        }
 
-            // 候補を追加する
-            // ターン数最小化型の問題で、candidateによって実行可能解が得られる場合にのみ finished = true とする
-            // ビーム幅分の候補をCandidateを追加したときにsegment treeを構築する
-            void push(const Action &action, const Cost &cost, const Hash &hash, int parent, bool finished)
+        void clear()
+        {
+            fill(blocks_.begin(), blocks_.end(), Block{});
+        }
+
+    private:
+        static constexpr size_t BLOCK_BITS = 512;
+        using Block = array<uint64_t, BLOCK_BITS / 64>;
+
+        vector<Block> blocks_;
+        size_t block_mask_ = 0;
+        int num_bits_per_insertion_ = 1;
+    };
+
+    // 削除ができる小さなハッシュ表
+    // ビームに残っている候補のハッシュ値だけを持つので、容量はビーム幅の2倍程度で済む
+    // open addressing with linear probing
+    // 削除したときは後ろの要素を詰めるので、墓石は残らない
+    template <class Key>
+    class CompactHashTable
+    {
+    public:
+        CompactHashTable() = default;
+
+        explicit CompactHashTable(size_t max_size)
+        {
+            size_t n = 1;
+            while (n < 2 * max_size)
             {
-                Candidate candidate(action, cost, hash, parent);
-                if (finished)
+                n *= 2;
+            }
+            mask_ = n - 1;
+            keys_.resize(n);
+            values_.assign(n, -1);
+        }
+
+        // keyに対応する値を返す。存在しなければ-1
+        int find(Key key) const
+        {
+            for (size_t i = home(key);; i = (i + 1) & mask_)
+            {
+                if (values_[i] == -1)
                 {
-                    finished_candidates_.emplace_back(candidate);
-                    return;
+                    return -1;
                 }
-                if (full_ && cost >= st_.all_prod().first)
+                if (keys_[i] == key)
                 {
-                    // 保持しているどの候補よりもコストが小さくないとき
-                    return;
+                    return values_[i];
                 }
-                auto [valid, i] = hash_to_index_.get_index(candidate.hash);
+            }
+        }
 
-                if (valid)
-                {
-                    int j = hash_to_index_.get(i);
-                    if (candidate.hash == candidates_[j].hash)
-                    {
-                        // ハッシュ値が等しいものが存在しているとき
-                        if (full_)
-                        {
-                            // segment treeが構築されている場合
-                            if (cost < st_.get(j).first)
-                            {
-                                candidates_[j] = candidate;
-                                st_.set(j, {cost, j});
-                            }
-                        }
-                        else
-                        {
-                            // segment treeが構築されていない場合
-                            if (cost < costs_[j].first)
-                            {
-                                candidates_[j] = candidate;
-                                costs_[j].first = cost;
-                            }
-                        }
-                        return;
-                    }
-                }
-                if (full_)
+        // keyとvalueを格納する。keyは存在しないものとする
+        void insert(Key key, int value)
+        {
+            size_t i = home(key);
+            while (values_[i] != -1)
+            {
+                i = (i + 1) & mask_;
+            }
+            keys_[i] = key;
+            values_[i] = value;
+        }
+
+        // keyを削除する。keyは存在するものとする
+        void erase(Key key)
+        {
+            size_t i = home(key);
+            while (keys_[i] != key || values_[i] == -1)
+            {
+                i = (i + 1) & mask_;
+            }
+            // 後ろにある要素のうち、iより前に本来の位置があるものを詰める
+            size_t j = i;
+            while (true)
+            {
+                j = (j + 1) & mask_;
+                if (values_[j] == -1)
                 {
-                    // segment treeが構築されている場合
-                    int j = st_.all_prod().second;
-                    hash_to_index_.set(i, candidate.hash, j);
-                    candidates_[j] = candidate;
-                    st_.set(j, {cost, j});
+                    break;
                 }
-                else
+                size_t k = home(keys_[j]);
+                // kが(i, j]の範囲になければ、jの要素はiに移せる
+                if ((i < j) ? (k <= i || j < k) : (k <= i && j < k))
                 {
-                    // segment treeが構築されていない場合
-                    int j = candidates_.size();
-                    hash_to_index_.set(i, candidate.hash, j);
-                    candidates_.emplace_back(candidate);
-                    costs_[j].first = cost;
-
-                    if (candidates_.size() == beam_width)
-                    {
-                        // 保持している候補がビーム幅分になったときにsegment treeを構築する
-                        full_ = true;
-                        st_ = MaxSegtree(costs_);
-                    }
+                    keys_[i] = keys_[j];
+                    values_[i] = values_[j];
+                    i = j;
                 }
             }
+            values_[i] = -1;
+        }
 
-            // 選んだ候補を返す
-            const vector<Candidate> &select() const
+        void clear()
+        {
+            fill(values_.begin(), values_.end(), -1);
+        }
+
+    private:
+        vector<Key> keys_;
+        vector<int> values_;
+        size_t mask_ = 0;
+
+        size_t home(Key key) const
+        {
+            return mix_hash(key) & mask_;
+        }
+    };
+
+    // ビームに残す候補の個数を、親ごと、ユーザが指定したグループごとに制限する
+    // 各グループの候補をコストの最大ヒープで持ち、上限に達したグループではコスト最大のものを追い出す
+    // ビームから取り除かれた候補はヒープから遅延削除するので、どの操作も償却O(log)
+    template <typename Cost>
+    class DiversityLimiter
+    {
+    public:
+        // グループを指定しない候補
+        static constexpr uint64_t NO_GROUP = numeric_limits<uint64_t>::max();
+
+        //@param max_per_parent 同じ親から選ぶ子の上限(0なら制限しない)
+        //@param max_per_group 同じグループから選ぶ候補の上限(0なら制限しない)
+        DiversityLimiter(size_t max_per_parent, size_t max_per_group, size_t beam_width, uint32_t hash_map_capacity)
+            : max_per_parent_(max_per_parent),
+              max_per_group_(max_per_group),
+              group_to_index_(max_per_group == 0 ? 1 : hash_map_capacity)
+        {
+            if (enabled())
             {
-                return candidates_;
+                parent_groups_.resize(beam_width);
+                slots_.resize(beam_width);
             }
+        }
 
-            // 実行可能解が見つかったか
-            bool have_finished() const
+        bool enabled() const
+        {
+            return max_per_parent_ != 0 || max_per_group_ != 0;
+        }
+
+        // (parent, group) の候補を新しく入れるときに、代わりに追い出す候補の添字
+        // 追い出す必要がなければ-1、どちらのグループも上限に達していて1つの候補を追い出すだけでは足りなければ-2
+        int find_victim(int parent, uint64_t group)
+        {
+            int parent_victim = -1;
+            if (max_per_parent_ != 0 && parent_groups_[parent].count >= max_per_parent_)
             {
-                return !finished_candidates_.empty();
+                parent_victim = worst(parent_groups_[parent]);
+            }
+            int group_victim = -1;
+            int g = find_group(group);
+            if (g != -1 && groups_[g].count >= max_per_group_)
+            {
+                group_victim = worst(groups_[g]);
+            }
+            if (parent_victim != -1 && group_victim != -1 && parent_victim != group_victim)
+            {
+                return -2;
             }
+            return parent_victim != -1 ? parent_victim : group_victim;
+        }
 
-            // 実行可能解に到達するCandidateを返す
-            vector<Candidate> get_finished_candidates() const
+        // slot の候補を (parent, group) の候補に置き換えても上限を超えないか
+        bool can_replace(int slot, int parent, uint64_t group)
+        {
+            if (max_per_parent_ != 0 && slots_[slot].parent != parent && parent_groups_[parent].count >= max_per_parent_)
             {
-                return finished_candidates_;
+                return false;
+            }
+            int g = find_group(group);
+            if (g != -1 && slots_[slot].group != g && groups_[g].count >= max_per_group_)
+            {
+                return false;
             }
+            return true;
+        }
 
-            // 最もよいCandidateを返す
-            Candidate calculate_best_candidate() const
+        // slot に (cost, parent, group) の候補を入れる
+        void add(int slot, Cost cost, int parent, uint64_t group)
+        {
+            Slot &s = slots_[slot];
+            s.parent = parent;
+            s.group = max_per_group_ == 0 ? -1 : get_or_create_group(group);
+            if (max_per_parent_ != 0)
             {
-                if (full_)
-                {
-                    size_t best = 0;
-                    for (size_t i = 0; i < beam_width; ++i)
-                    {
-                        if (st_.get(i).first < st_.get(best).first)
-                        {
-                            best = i;
-                        }
-                    }
-                    return candidates_[best];
-                }
-                else
+                if (parent_groups_[parent].count == 0 && parent_groups_[parent].heap.empty())
                 {
-                    size_t best = 0;
-                    for (size_t i = 0; i < candidates_.size(); ++i)
-                    {
-                        if (costs_[i].first < costs_[best].first)
-                        {
-                            best = i;
-                        }
-                    }
-                    return candidates_[best];
+                    used_parents_.push_back(parent);
                 }
+                add_to_group(parent_groups_[parent], cost, slot, s.version);
             }
-
-            void clear()
+            if (s.group != -1)
             {
-                candidates_.clear();
-                hash_to_index_.clear();
-                full_ = false;
+                add_to_group(groups_[s.group], cost, slot, s.version);
             }
+        }
 
-            void clear_finished_candidates()
+        // slot の候補をビームから取り除く
+        void remove(int slot)
+        {
+            Slot &s = slots_[slot];
+            if (max_per_parent_ != 0)
             {
-                finished_candidates_.clear();
+                --parent_groups_[s.parent].count;
             }
+            if (s.group != -1)
+            {
+                --groups_[s.group].count;
+            }
+            // ヒープに残っている古い要素を無効にする
+            ++s.version;
+        }
 
-        private:
-            // 削除可能な優先度付きキュー
-            using MaxSegtree = atcoder::segtree<
-                pair<Cost, int>,
-                [](pair<Cost, int> a, pair<Cost, int> b)
-                {
-                    if (a.first >= b.first)
-                    {
-                        return a;
-                    }
-                    else
-                    {
-                        return b;
-                    }
-                },
-                []()
-                { return make_pair(numeric_limits<Cost>::min(), -1); }>;
-
-            size_t beam_width;
-            vector<Candidate> candidates_;
-            HashMap<Hash, int> hash_to_index_;
-            bool full_;
-            vector<pair<Cost, int>> costs_;
-            MaxSegtree st_;
-            vector<Candidate> finished_candidates_;
-        };
-
-        // Euler Tourを管理するためのクラス
-        class Tree
+        // 親の添字が num_parents 未満なら、親ごとの上限を数えられるようにする
+        // 最初のターンの親は beam_search に渡した roots なので、ビーム幅より多いことがある
+        void reserve_parents(size_t num_parents)
         {
-        public:
-            explicit Tree(const State<Selector> &state, const Config &config) : state_(state)
+            if (max_per_parent_ != 0 && parent_groups_.size() < num_parents)
             {
-                curr_tour_.reserve(config.tour_capacity);
-                next_tour_.reserve(config.tour_capacity);
-                leaves_.reserve(config.beam_width);
-                buckets_.assign(config.beam_width, {});
+                parent_groups_.resize(num_parents);
             }
+        }
 
-            // 状態を更新しながら深さ優先探索を行い、次のノードの候補を全てselectorに追加する
-            void dfs(Selector &selector)
+        void clear()
+        {
+            for (int parent : used_parents_)
             {
-                if (curr_tour_.empty())
-                {
-                    // 最初のターン
-                    auto [cost, hash] = state_.make_initial_node();
-                    state_.expand(0, selector);
+                parent_groups_[parent].count = 0;
+                parent_groups_[parent].heap.clear();
+            }
+            used_parents_.clear();
+            for (size_t g = 0; g < num_groups_; ++g)
+            {
+                groups_[g].count = 0;
+                groups_[g].heap.clear();
+            }
+            num_groups_ = 0;
+            if (max_per_group_ != 0)
+            {
+                group_to_index_.clear();
+            }
+        }
+
+    private:
+        // (コスト, 添字, 追加したときのversion)
+        using HeapEntry = tuple<Cost, int, uint32_t>;
+
+        struct Group
+        {
+            size_t count = 0;
+            vector<HeapEntry> heap;
+        };
+
+        // ビームの各位置にいる候補の所属
+        struct Slot
+        {
+            int parent = -1;
+            int group = -1;
+            uint32_t version = 0;
+        };
+
+        size_t max_per_parent_;
+        size_t max_per_group_;
+        vector<Group> parent_groups_;
+        vector<int> used_parents_;
+        // グループのキーから groups_ の添字への対応
+        HashMap<uint64_t, int> group_to_index_;
+        vector<Group> groups_;
+        size_t num_groups_ = 0;
+        vector<Slot> slots_;
+
+        void add_to_group(Group &group, Cost cost, int slot, uint32_t version)
+        {
+            ++group.count;
+            group.heap.emplace_back(cost, slot, version);
+            push_heap(group.heap.begin(), group.heap.end());
+        }
+
+        // グループの中でコストが最大の候補の添字
+        int worst(Group &group)
+        {
+            while (true)
+            {
+                auto [cost, slot, version] = group.heap.front();
+                if (slots_[slot].version == version)
+                {
+                    return slot;
+                }
+                pop_heap(group.heap.begin(), group.heap.end());
+                group.heap.pop_back();
+            }
+        }
+
+        // グループの添字。まだ候補がいなければ-1
+        int find_group(uint64_t group) const
+        {
+            if (max_per_group_ == 0 || group == NO_GROUP)
+            {
+                return -1;
+            }
+            auto [valid, i] = group_to_index_.get_index(group);
+            return valid ? group_to_index_.get(i) : -1;
+        }
+
+        int get_or_create_group(uint64_t group)
+        {
+            if (group == NO_GROUP)
+            {
+                return -1;
+            }
+            auto [valid, i] = group_to_index_.get_index(group);
+            if (valid)
+            {
+                return group_to_index_.get(i);
+            }
+            if (num_groups_ == groups_.size())
+            {
+                groups_.emplace_back();
+            }
+            group_to_index_.set(i, group, num_groups_);
+            return num_groups_++;
+        }
+    };
+
+    // 複数のパスを、共通の接頭辞を共有したまま保持するトライ木
+    // nodes[v] = {親のノード(根の直下なら-1), action}
+    // k番目のパスは ends[k] から親をたどったactionを逆順に並べたもの
+    // k本のパスをそれぞれvectorで持つ場合と違い、共通部分をコピーしない
+    template <typename Action, typename Cost>
+    struct PathTrie
+    {
+        vector<pair<int, Action>> nodes;
+        vector<int> ends;
+        vector<Cost> costs;
+
+        // 保持しているパスの本数
+        size_t size() const
+        {
+            return ends.size();
+        }
+
+        // k番目のパスを復元する
+        vector<Action> get_path(size_t k) const
+        {
+            vector<Action> path;
+            for (int v = ends[k]; v != -1; v = nodes[v].first)
+            {
+                path.push_back(nodes[v].second);
+            }
+            reverse(path.begin(), path.end());
+            return path;
+        }
+
+        // parentを親とするノードを追加し、そのインデックスを返す
+        int add_node(int parent, const Action &action)
+        {
+            nodes.push_back({parent, action});
+            return nodes.size() - 1;
+        }
+
+        // 2つのトライ木に含まれるパスのうち、コストがよい順にk本を残したトライ木を返す
+        // 使われなくなったノードはコピーしない
+        static PathTrie merge_top_k(const PathTrie &a, const PathTrie &b, size_t k)
+        {
+            vector<tuple<Cost, int, int>> order;
+            for (size_t i = 0; i < a.size(); ++i)
+            {
+                order.emplace_back(a.costs[i], 0, i);
+            }
+            for (size_t i = 0; i < b.size(); ++i)
+            {
+                order.emplace_back(b.costs[i], 1, i);
+            }
+            k = min(k, order.size());
+            partial_sort(order.begin(), order.begin() + k, order.end());
+
+            PathTrie ret;
+            vector<int> remap_a(a.nodes.size(), -1);
+            vector<int> remap_b(b.nodes.size(), -1);
+            vector<int> stack;
+            for (size_t i = 0; i < k; ++i)
+            {
+                auto [cost, source, index] = order[i];
+                const PathTrie &trie = source == 0 ? a : b;
+                vector<int> &remap = source == 0 ? remap_a : remap_b;
+
+                // まだコピーしていない祖先を集めてから、根に近い順にコピーする
+                int v = trie.ends[index];
+                while (v != -1 && remap[v] == -1)
+                {
+                    stack.push_back(v);
+                    v = trie.nodes[v].first;
+                }
+                int parent = v == -1 ? -1 : remap[v];
+                while (!stack.empty())
+                {
+                    int u = stack.back();
+                    stack.pop_back();
+                    parent = remap[u] = ret.add_node(parent, trie.nodes[u].second);
+                }
+                ret.ends.push_back(parent);
+                ret.costs.push_back(cost);
+            }
+            return ret;
+        }
+    };
+
+    // ビームに入らなかった候補を、ターンごとに覚えておくクラス(beam stack search)
+    // layers_[t] は t ターン目の候補のうち、ビームに入らなかったものの中でよいもの最大 width 個
+    // 候補は根からのパスをトライ木で持つので、探索木から消えた後でもそこから探索をやり直せる
+    // Leaf は葉に持たせる値(コスト、またはコストとハッシュ値の組)で、小さいほどよい
+    template <typename Action, typename Leaf>
+    class PrunedFrontier
+    {
+    public:
+        using Layer = PathTrie<Action, Leaf>;
+
+        explicit PrunedFrontier(size_t width) : width_(width) {}
+
+        bool enabled() const
+        {
+            return width_ > 0;
+        }
+
+        // turn ターン目にビームに入らなかった候補のパスと、葉に持たせる値を追加する
+        // leaves[k] は paths の k 番目のパスに対応する
+        // 同じターンに既に覚えている候補があれば、合わせてよいもの width 個を残す
+        template <typename Cost>
+        void record(int turn, PathTrie<Action, Cost> &&paths, vector<Leaf> &&leaves)
+        {
+            if ((int)layers_.size() <= turn)
+            {
+                layers_.resize(turn + 1);
+            }
+            Layer layer;
+            layer.nodes = move(paths.nodes);
+            layer.ends = move(paths.ends);
+            layer.costs = move(leaves);
+            if (layers_[turn].size() == 0 && layer.size() <= width_)
+            {
+                layers_[turn] = move(layer);
+            }
+            else
+            {
+                layers_[turn] = Layer::merge_top_k(layers_[turn], layer, width_);
+            }
+        }
+
+        // turn ターン目以前で候補が残っている最も深いターンを探し、その候補を全て取り出してlayerに書く
+        // 取り出したターンを返す。候補が残っていなければ-1を返す
+        int pop(int turn, Layer &layer)
+        {
+            for (int t = min(turn, (int)layers_.size() - 1); t >= 0; --t)
+            {
+                if (layers_[t].size() > 0)
+                {
+                    layer = move(layers_[t]);
+                    layers_[t] = Layer();
+                    return t;
+                }
+            }
+            return -1;
+        }
+
+#ifdef THUNDER_CHECKPOINT
+        // チェックポイントに保存する
+        void save(CheckpointWriter &writer) const
+        {
+            writer.write(layers_.size());
+            for (const Layer &layer : layers_)
+            {
+                writer.write_vector(layer.nodes);
+                writer.write_vector(layer.ends);
+                writer.write_vector(layer.costs);
+            }
+        }
+
+        // save で保存した状態を読み込む
+        void load(CheckpointReader &reader)
+        {
+            layers_.resize(reader.read<size_t>());
+            for (Layer &layer : layers_)
+            {
+                reader.read_vector(layer.nodes);
+                reader.read_vector(layer.ends);
+                reader.read_vector(layer.costs);
+            }
+        }
+#endif
+
+    private:
+        size_t width_;
+        vector<Layer> layers_;
+    };
+
+    // 整数のコストの列から、小さい順に k 個を選ぶときの境目を求める基数選択
+    // 最小値との差を上の桁から11bitずつヒストグラムにして、k 個目が入る桶だけを次の桁で数え直す
+    // 比較による並べ替えをせずに配列を先頭から順に読むだけなので、要素数に対して線形時間
+    // コストの幅が狭ければ桁数が少なく済み、ほとんどの場合は数回読むだけで終わる
+    template <class Cost>
+    class RadixSelect
+    {
+    public:
+        // 戻り値の threshold より小さいものは全て選び、threshold と等しい num_ties 個のうち num_taken 個を選ぶと k 個になる
+        struct Result
+        {
+            Cost threshold;
+            size_t num_taken;
+            size_t num_ties;
+        };
+
+        RadixSelect() : histogram_(1 << DIGIT_BITS) {}
+
+        // 1 <= k <= n とする
+        Result select(const Cost *costs, size_t n, size_t k)
+        {
+            using Key = make_unsigned_t<Cost>;
+            Cost lo = costs[0];
+            Cost hi = costs[0];
+            for (size_t i = 1; i < n; ++i)
+            {
+                lo = min(lo, costs[i]);
+                hi = max(hi, costs[i]);
+            }
+            // 符号付きでも、符号なしに直してから引けば最小値との差になる
+            Key range = (Key)((Key)hi - (Key)lo);
+            if (range == 0)
+            {
+                return {lo, k, n};
+            }
+            int shift = (bit_width(range) - 1) / DIGIT_BITS * DIGIT_BITS;
+            // 上の桁から決めていった、k 個目の最小値との差
+            Key prefix = 0;
+            while (true)
+            {
+                fill(histogram_.begin(), histogram_.end(), 0);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    Key key = (Key)((Key)costs[i] - (Key)lo) >> shift;
+                    // 決めた上の桁が一致するものだけを数える
+                    if ((key >> DIGIT_BITS) == prefix)
+                    {
+                        ++histogram_[key & DIGIT_MASK];
+                    }
+                }
+                size_t digit = 0;
+                while (histogram_[digit] < k)
+                {
+                    k -= histogram_[digit++];
+                }
+                prefix = (prefix << DIGIT_BITS) | digit;
+                if (shift == 0)
+                {
+                    return {(Cost)((Key)lo + prefix), k, histogram_[digit]};
+                }
+                shift -= DIGIT_BITS;
+            }
+        }
+
+    private:
+        static constexpr int DIGIT_BITS = 11;
+        static constexpr size_t DIGIT_MASK = (1 << DIGIT_BITS) - 1;
+        vector<size_t> histogram_;
+    };
+
+    // mask の立っているビットの位置に base を足して survivors に詰めて書き込む
+    inline void append_survivors(uint32_t mask, size_t base, int *survivors, size_t &num_survivors)
+    {
+        while (mask)
+        {
+            survivors[num_survivors++] = base + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+
+    // finished[base], ..., finished[base + width - 1] のうち0でないもののビット集合
+    // ほとんどが0なので、8バイトずつまとめて確認する
+    inline uint32_t finished_mask(const uint8_t *finished, size_t width)
+    {
+        uint32_t mask = 0;
+        for (size_t j = 0; j < width; j += 8)
+        {
+            uint64_t x;
+            memcpy(&x, finished + j, sizeof(x));
+            if (x != 0)
+            {
+                for (size_t k = 0; k < 8; ++k)
+                {
+                    mask |= (uint32_t)(finished[j + k] != 0) << (j + k);
+                }
+            }
+        }
+        return mask;
+    }
+
+    // costs[i] <= threshold または finished[i] である添字 i を survivors に昇順に詰めて書き込み、その個数を返す
+    // AVX2 または SSE2 が使えて、Cost が符号付き整数か浮動小数点数ならまとめて比較する
+    // それ以外の場合と、端数はスカラーで比較する
+    template <typename Cost>
+    size_t filter_by_threshold(const Cost *costs, const uint8_t *finished, size_t n, Cost threshold, int *survivors)
+    {
+        size_t num_survivors = 0;
+        size_t i = 0;
+#if defined(__AVX2__)
+        if constexpr (is_integral_v<Cost> && is_signed_v<Cost> && sizeof(Cost) == 4)
+        {
+            const __m256i t = _mm256_set1_epi32(threshold);
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256i c = _mm256_loadu_si256((const __m256i *)(costs + i));
+                uint32_t over = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(c, t)));
+                append_survivors((~over & 0xff) | finished_mask(finished + i, 8), i, survivors, num_survivors);
+            }
+        }
+        else if constexpr (is_integral_v<Cost> && is_signed_v<Cost> && sizeof(Cost) == 8)
+        {
+            const __m256i t = _mm256_set1_epi64x(threshold);
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256i c0 = _mm256_loadu_si256((const __m256i *)(costs + i));
+                __m256i c1 = _mm256_loadu_si256((const __m256i *)(costs + i + 4));
+                uint32_t over = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(c0, t))) |
+                                _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(c1, t))) << 4;
+                append_survivors((~over & 0xff) | finished_mask(finished + i, 8), i, survivors, num_survivors);
+            }
+        }
+        else if constexpr (is_same_v<Cost, float>)
+        {
+            const __m256 t = _mm256_set1_ps(threshold);
+            for (; i + 8 <= n; i += 8)
+            {
+                uint32_t keep = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(costs + i), t, _CMP_LE_OQ));
+                append_survivors(keep | finished_mask(finished + i, 8), i, survivors, num_survivors);
+            }
+        }
+        else if constexpr (is_same_v<Cost, double>)
+        {
+            const __m256d t = _mm256_set1_pd(threshold);
+            for (; i + 8 <= n; i += 8)
+            {
+                uint32_t keep = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(costs + i), t, _CMP_LE_OQ)) |
+                                _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(costs + i + 4), t, _CMP_LE_OQ)) << 4;
+                append_survivors(keep | finished_mask(finished + i, 8), i, survivors, num_survivors);
+            }
+        }
+#elif defined(__SSE2__)
+        if constexpr (is_integral_v<Cost> && is_signed_v<Cost> && sizeof(Cost) == 4)
+        {
+            const __m128i t = _mm_set1_epi32(threshold);
+            for (; i + 8 <= n; i += 8)
+            {
+                __m128i c0 = _mm_loadu_si128((const __m128i *)(costs + i));
+                __m128i c1 = _mm_loadu_si128((const __m128i *)(costs + i + 4));
+                uint32_t over = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(c0, t))) |
+                                _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(c1, t))) << 4;
+                append_survivors((~over & 0xff) | finished_mask(finished + i, 8), i, survivors, num_survivors);
+            }
+        }
+        else if constexpr (is_same_v<Cost, float>)
+        {
+            const __m128 t = _mm_set1_ps(threshold);
+            for (; i + 8 <= n; i += 8)
+            {
+                uint32_t keep = _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(costs + i), t)) |
+                                _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(costs + i + 4), t)) << 4;
+                append_survivors(keep | finished_mask(finished + i, 8), i, survivors, num_survivors);
+            }
+        }
+        else if constexpr (is_same_v<Cost, double>)
+        {
+            const __m128d t = _mm_set1_pd(threshold);
+            for (; i + 8 <= n; i += 8)
+            {
+                uint32_t keep = 0;
+                for (size_t j = 0; j < 8; j += 2)
+                {
+                    keep |= _mm_movemask_pd(_mm_cmple_pd(_mm_loadu_pd(costs + i + j), t)) << j;
+                }
+                append_survivors(keep | finished_mask(finished + i, 8), i, survivors, num_survivors);
+            }
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            survivors[num_survivors] = i;
+            num_survivors += finished[i] | (costs[i] <= threshold);
+        }
+        return num_survivors;
+    }
+
+    // 要素をバイト列のままファイルに置けるか
+    // pair は要素がそうであればよい(Euler Tour の要素は pair<int, Action>)
+    template <class T>
+    struct is_spillable : bool_constant<is_trivially_copyable_v<T>>
+    {
+    };
+    template <class T, class U>
+    struct is_spillable<pair<T, U>> : bool_constant<is_spillable<T>::value && is_spillable<U>::value>
+    {
+    };
+
+    // Euler Tour を格納する配列
+    // vector と同じように末尾への追加と先頭からの走査をする
+    // spill_dir を指定すると、そのディレクトリに作った一時ファイルを mmap して要素を置く
+    // ファイルに置いたページはOSが必要に応じてディスクに書き出して手放せるので、
+    // 物理メモリより大きなEuler Tourでも、先頭から順に読み書きする限りはディスクの帯域で動く
+    // 一時ファイルは作った直後に削除するので、プロセスが落ちても残らない
+    template <class T>
+    class TourBuffer
+    {
+    public:
+        TourBuffer() = default;
+
+        TourBuffer(const TourBuffer &) = delete;
+        TourBuffer &operator=(const TourBuffer &) = delete;
+
+        TourBuffer(TourBuffer &&other) noexcept
+        {
+            swap(other);
+        }
+
+        TourBuffer &operator=(TourBuffer &&other) noexcept
+        {
+            swap(other);
+            return *this;
+        }
+
+        ~TourBuffer()
+        {
+            clear();
+            if (fd_ == -1)
+            {
+                ::operator delete(data_, align_val_t(alignof(T)));
+            }
+            else
+            {
+                munmap(data_, capacity_ * sizeof(T));
+                close(fd_);
+            }
+        }
+
+        //@brief 容量を確保する
+        //@param capacity 最初に確保する要素数。足りなくなったら倍々に増やすので、目安でよい
+        //@param spill_dir 空でなければ、このディレクトリの一時ファイルに要素を置く
+        void init(size_t capacity, const string &spill_dir)
+        {
+            assert(data_ == nullptr);
+            if (!spill_dir.empty())
+            {
+                if constexpr (!is_spillable<T>::value)
+                {
+                    cerr << "ERROR: tour_spill_dir requires a trivially copyable Action" << endl;
+                    exit(-1);
+                }
+                string path = spill_dir + "/thunder_tour_XXXXXX";
+                fd_ = mkstemp(path.data());
+                if (fd_ == -1)
+                {
+                    cerr << "ERROR: cannot create a file in " << spill_dir << endl;
+                    exit(-1);
+                }
+                unlink(path.c_str());
+            }
+            reserve(max<size_t>(capacity, 1));
+        }
+
+        void push_back(const T &x)
+        {
+            if (size_ == capacity_)
+            {
+                reserve(2 * capacity_);
+            }
+            new (data_ + size_) T(x);
+            ++size_;
+        }
+
+        void pop_back()
+        {
+            assert(size_ > 0);
+            data_[--size_].~T();
+        }
+
+        T &back()
+        {
+            return data_[size_ - 1];
+        }
+
+        const T &back() const
+        {
+            return data_[size_ - 1];
+        }
+
+        T &operator[](size_t i)
+        {
+            return data_[i];
+        }
+
+        const T &operator[](size_t i) const
+        {
+            return data_[i];
+        }
+
+        T *begin()
+        {
+            return data_;
+        }
+
+        T *end()
+        {
+            return data_ + size_;
+        }
+
+        const T *begin() const
+        {
+            return data_;
+        }
+
+        const T *end() const
+        {
+            return data_ + size_;
+        }
+
+        const T *data() const
+        {
+            return data_;
+        }
+
+        size_t size() const
+        {
+            return size_;
+        }
+
+        bool empty() const
+        {
+            return size_ == 0;
+        }
+
+        //@brief 要素を全て取り除く
+        //@note ファイルに置いているときは書き込める状態に戻す
+        //      ファイルを切り詰めて古い中身を捨てることもできるが、毎ターンページフォールトが起きて遅くなるので、
+        //      同じページをそのまま上書きして使う
+        void clear()
+        {
+            for (size_t i = 0; i < size_; ++i)
+            {
+                data_[i].~T();
+            }
+            size_ = 0;
+            if (fd_ != -1 && data_ != nullptr)
+            {
+                mprotect(data_, capacity_ * sizeof(T), PROT_READ | PROT_WRITE);
+            }
+        }
+
+        //@brief 以降は読むだけになったことを伝える
+        //@note ファイルに置いているときは読み込み専用にし、先頭から順に読むので先読みしてもらう
+        void seal()
+        {
+            if (fd_ != -1)
+            {
+                size_t bytes = capacity_ * sizeof(T);
+                mprotect(data_, bytes, PROT_READ);
+                madvise(data_, bytes, MADV_SEQUENTIAL);
+            }
+        }
+
+        //@brief 要素数を変えずに、capacity個以上の要素を置ける容量を確保する
+        void reserve(size_t capacity)
+        {
+            if (capacity <= capacity_)
+            {
+                return;
+            }
+            if (fd_ == -1)
+            {
+                T *data = static_cast<T *>(::operator new(capacity * sizeof(T), align_val_t(alignof(T))));
+                if constexpr (is_trivially_copyable_v<T>)
+                {
+                    if (size_ > 0)
+                    {
+                        memcpy(static_cast<void *>(data), data_, size_ * sizeof(T));
+                    }
+                }
+                else
+                {
+                    uninitialized_move(data_, data_ + size_, data);
+                    destroy(data_, data_ + size_);
+                }
+                ::operator delete(data_, align_val_t(alignof(T)));
+                data_ = data;
+                capacity_ = capacity;
+                return;
+            }
+            // ページ単位で確保する
+            size_t page_size = sysconf(_SC_PAGESIZE);
+            size_t old_bytes = capacity_ * sizeof(T);
+            size_t new_bytes = (capacity * sizeof(T) + page_size - 1) / page_size * page_size;
+            if (ftruncate(fd_, new_bytes) == -1)
+            {
+                cerr << "ERROR: cannot extend the tour file" << endl;
+                exit(-1);
+            }
+            void *data = data_ == nullptr ? mmap(nullptr, new_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0)
+                                          : mremap(data_, old_bytes, new_bytes, MREMAP_MAYMOVE);
+            if (data == MAP_FAILED)
+            {
+                cerr << "ERROR: cannot map the tour file" << endl;
+                exit(-1);
+            }
+            data_ = static_cast<T *>(data);
+            capacity_ = new_bytes / sizeof(T);
+        }
+
+        //@brief [first, first + n) の要素で置き換える
+        void assign(const T *first, size_t n)
+        {
+            clear();
+            reserve(n);
+            uninitialized_copy(first, first + n, data_);
+            size_ = n;
+        }
+
+        void swap(TourBuffer &other) noexcept
+        {
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+            std::swap(capacity_, other.capacity_);
+            std::swap(fd_, other.fd_);
+        }
+
+        friend void swap(TourBuffer &a, TourBuffer &b) noexcept
+        {
+            a.swap(b);
+        }
+
+    private:
+        T *data_ = nullptr;
+        size_t size_ = 0;
+        size_t capacity_ = 0;
+        // 一時ファイルのファイル記述子。メモリ上に置くときは-1
+        int fd_ = -1;
+    };
+
+    // expand_batch で State が子を書き込むバッファ
+    // 子ごとのaction、親からのコストの差分、ハッシュの差分(XOR)をそれぞれ別の配列に持つ
+    // 配列が連続しているので、エンジン側で子のコストとハッシュをまとめてベクトル化して計算できる
+    // 毎回clearして使い回すので、容量が足りてからはメモリ確保をしない
+    template <typename Action, typename Cost, typename Hash>
+    struct ExpandBatch
+    {
+        vector<Action> actions;
+        vector<Cost> cost_deltas;
+        vector<Hash> hash_deltas;
+        vector<uint8_t> finished;
+
+        // 以下はエンジン側で使う作業領域
+        vector<Cost> costs;
+        vector<Hash> hashes;
+
+        // 子を追加する
+        // 子のコストは親のコスト + cost_delta、ハッシュは親のハッシュ ^ hash_delta になる
+        void push(const Action &action, Cost cost_delta, Hash hash_delta, bool is_finished = false)
+        {
+            actions.push_back(action);
+            cost_deltas.push_back(cost_delta);
+            hash_deltas.push_back(hash_delta);
+            finished.push_back(is_finished);
+        }
+
+        size_t size() const
+        {
+            return actions.size();
+        }
+
+        void clear()
+        {
+            actions.clear();
+            cost_deltas.clear();
+            hash_deltas.clear();
+            finished.clear();
+        }
+    };
+
+    template <typename HashType>
+    concept HashConcept = requires(HashType hash) {
+        { std::is_unsigned_v<HashType> };
+    };
+    template <typename CostType>
+    concept CostConcept = requires(CostType cost) {
+        { std::is_arithmetic_v<CostType> };
+    };
+
+    // expand の代わりに expand_batch を実装しているか
+    template <typename StateType, typename BatchType>
+    concept BatchExpandConcept = requires(StateType state, BatchType batch) {
+        { state.expand_batch(std::declval<int>(), batch) } -> same_as<void>;
+    };
+
+    template <typename StateType, typename HashType, typename CostType, typename ActionType, typename SelectorType>
+    concept StateConcept = HashConcept<HashType> &&
+                           CostConcept<CostType> &&
+                           (requires(StateType state, SelectorType selector) {
+                               { state.expand(std::declval<int>(), selector) } -> same_as<void>;
+                           } || BatchExpandConcept<StateType, typename SelectorType::Batch>) &&
+                           requires(StateType state) {
+                               { state.move_forward(std::declval<ActionType>()) } -> same_as<void>;
+                               { state.move_backward(std::declval<ActionType>()) } -> same_as<void>;
+                               { state.make_initial_node() } -> same_as<pair<CostType, HashType>>;
+                           };
+
+    template <HashConcept Hash, typename Action, CostConcept Cost, template <typename> class State>
+    struct EdgeBeamSearch
+    {
+        // ビームサーチの設定
+        struct Config
+        {
+            int max_turn;
+            size_t beam_width;
+            // 最初に確保するEuler Tourの長さ。足りなくなったら倍々に増やすので目安でよい
+            size_t tour_capacity;
+            uint32_t hash_map_capacity;
+            // 実行可能解が見つかったらすぐに返すかどうか
+            // ビーム内のターンと問題文のターンが同じレイヤーで、
+            // かつターン数最小化問題であればtrueにする。
+            // そうでなければfalse
+            bool return_finished_immediately;
+            // trueにすると、同一盤面の検出にHashMapの代わりにBloom filterとビーム内の候補だけを持つハッシュ表を使う
+            // ビーム幅が数万以上でHashMapがキャッシュに収まらないときに速くなる
+            // Bloom filterで見たことがないと判定された候補は、ビーム内のハッシュ表を引かずに追加する
+            // 見たことがあると判定されたときだけハッシュ表を引き、ビーム内になければ(偽陽性か、ビームから追い出された後)新しい候補として追加する
+            // このときhash_map_capacityは使わないので、1など小さな値でよい
+            // max_children_per_parent, max_candidates_per_group とは併用できない
+            bool use_bloom_filter = false;
+            // Bloom filterの偽陽性率
+            double bloom_false_positive_rate = 0.01;
+            // 1ターンにBloom filterに追加する候補数の見込み。0ならbeam_widthの4倍とする
+            size_t bloom_expected_insertions = 0;
+            // 制限時間(timer_library::timer の経過秒数)
+            // これを過ぎたターンを最終ターンとして扱う
+            double time_limit = numeric_limits<double>::infinity();
+            // 0以外を指定すると、ビームの末尾でコストが等しい候補のどちらを残すかをこの値をシードとした乱数で決める
+            // 並列に独立なビームサーチを行うときに、インスタンスごとに変えると探索が多様になる
+            uint64_t tie_break_seed = 0;
+            // 0以外を指定すると、同じ親から選ぶ子をこの個数までにする
+            // ビームが1つの系統に偏るのを防ぐ
+            size_t max_children_per_parent = 0;
+            // 0以外を指定すると、pushで同じgroupを指定した候補をこの個数までにする
+            // ハッシュでは区別できるが似ている盤面を、問題ごとの特徴量でまとめて制限する
+            size_t max_candidates_per_group = 0;
+            // ターンごとのビーム幅を返す関数。省略するとbeam_widthで一定になる
+            // 配列で指定したい場合は [&](int turn) { return widths[turn]; } のように渡す
+            // 返す値は1以上beam_width以下にする。メモリはbeam_widthの分だけ確保し、各ターンはその幅だけ使う
+            function<size_t(int)> beam_width_schedule = nullptr;
+            // 途中経過を保存するファイル
+            string checkpoint_path = "";
+            // 0以外を指定すると、beam_search で checkpoint_interval ターンごとに checkpoint_path に保存する
+            // checkpoint_interval, resume_from_checkpoint は THUNDER_CHECKPOINT を define したときだけ指定できる
+            // 保存には Euler Tour の長さに比例する時間がかかるので、1ターンの時間に比べて十分大きくする
+            int checkpoint_interval = 0;
+            // trueにすると、checkpoint_path があればそのターンから beam_search を再開する
+            // 保存したときと同じ入力、同じ設定(beam_widthなど)で実行する必要がある
+            // 制限時間(time_limit)は再開してからの経過時間で判定する
+            bool resume_from_checkpoint = false;
+            // 空でなければ、Euler Tourをメモリではなくこのディレクトリに作る一時ファイルに置く(例: "/tmp")
+            // 次のターンのEuler Tourを作る間は今のターンの分と合わせて2本が必要になり、
+            // ビーム幅がとても大きいとメモリの上限を超えることがある。ファイルに置くと、
+            // OSがページをディスクに書き出して手放せるので、メモリの使用量を抑えられる
+            // Euler Tourは先頭から順に読み書きするだけなので、ページキャッシュに収まらなくてもディスクの帯域で動く
+            // Actionは trivially copyable である必要がある
+            string tour_spill_dir = "";
+            // 0以外を指定すると、各ターンにビームに入らなかった候補のうちよいものをこの個数まで覚えておき、
+            // 実行可能解が見つかる前にビームが途絶えたとき(候補がなくなったとき)に、
+            // 覚えている中で最も深いターンの候補から探索をやり直す(beam stack search)
+            // Selectorはビーム幅がこの個数だけ広いのと同じだけ重くなり、覚える候補の根からのパスを毎ターン計算する
+            // beam_search だけで使う。覚えた候補はチェックポイントにも保存する
+            size_t backtrack_width = 0;
+            // backtrack_width を指定したときに0以外を指定すると、ビーム内の最もよいコストがこのターン数だけ
+            // 更新されなかったときも行き詰まったとみなして、今より浅いターンの候補から探索をやり直す
+            int backtrack_stall_turns = 0;
+            // 探索をやり直す回数の上限
+            int max_backtracks = numeric_limits<int>::max();
+
+            // turnターン目のビーム幅
+            // max_turn以降のターンはmax_turn - 1ターン目と同じ幅にする
+            size_t get_beam_width(int turn) const
+            {
+                if (!beam_width_schedule)
+                {
+                    return beam_width;
+                }
+                size_t width = beam_width_schedule(min(turn, max_turn - 1));
+                assert(1 <= width && width <= beam_width);
+                return width;
+            }
+        };
+
+        // 展開するノードの候補を表す構造体
+        struct Candidate
+        {
+            Action action;
+            Cost cost;
+            Hash hash;
+            int parent;
+
+            Candidate(Action action, Cost cost, Hash hash, int parent) : action(action),
+                                                                         cost(cost),
+                                                                         hash(hash),
+                                                                         parent(parent) {}
+        };
+
+        // 複数の初期状態から探索するときの、初期状態を表す構造体
+        // 渡された state を仮想的な根とし、action で各初期状態に移る
+        // 根の分だけ State の深さが1段増えるので、UndoLog(max_turn + 1) のように深さで容量を決めるものは1つ多く確保する
+        struct Root
+        {
+            Action action;
+            Cost cost;
+            Hash hash;
+        };
+
+        // 複数のパスをまとめて返すときの型
+        using Paths = PathTrie<Action, Cost>;
+
+        // ビームに入らなかった候補を覚えておく型(backtrack_width 参照)
+        using Frontier = PrunedFrontier<Action, pair<Cost, Hash>>;
+
+        // 評価がよい順に最大k個のCandidateを返す
+        static vector<Candidate> select_top_k(const vector<Candidate> &candidates, size_t k)
+        {
+            vector<Candidate> ret = candidates;
+            k = min(k, ret.size());
+            partial_sort(ret.begin(), ret.begin() + k, ret.end(),
+                         [](const Candidate &a, const Candidate &b)
+                         { return a.cost < b.cost; });
+            ret.erase(ret.begin() + k, ret.end());
+            return ret;
+        }
+
+        // ノードの候補から実際に追加するものを選ぶクラス
+        // ビーム幅の個数だけ、評価がよいものを選ぶ
+        // ハッシュ値が一致したものについては、評価がよいほうのみを残す
+        class Selector
+        {
+        public:
+            // expand_batch で子を書き込むバッファの型
+            using Batch = ExpandBatch<Action, Cost, Hash>;
+
+            explicit Selector(const Config &config) : hash_to_index_(config.hash_map_capacity),
+                                                      diversity_(config.max_children_per_parent, config.max_candidates_per_group,
+                                                                 config.beam_width + config.backtrack_width, config.hash_map_capacity)
+            {
+                use_bloom_filter_ = config.use_bloom_filter;
+                if (use_bloom_filter_)
+                {
+                    assert(!diversity_.enabled());
+                    size_t expected_insertions = config.bloom_expected_insertions == 0 ? 4 * config.beam_width : config.bloom_expected_insertions;
+                    bloom_filter_ = BlockedBloomFilter(expected_insertions, config.bloom_false_positive_rate);
+                    beam_hashes_ = CompactHashTable<Hash>(config.beam_width + config.backtrack_width);
+                }
+                tie_break_state_ = config.tie_break_seed;
+                // backtrack_width を指定したときは、ビームに入らなかった候補もその個数だけ一緒に選ぶ
+                beam_width = config.beam_width + config.backtrack_width;
+                // Cost が整数型なら、segment treeの代わりに基数選択でビームを選ぶ(radix_shrink 参照)
+                // Bloom filterや多様性の制約を使うときは、入れ替える候補を1つずつ決めるのでsegment treeを使う
+                use_radix_ = is_integral_v<Cost> && !use_bloom_filter_ && !diversity_.enabled();
+                candidates_.reserve(use_radix_ ? 2 * beam_width : beam_width);
+                full_ = false;
+
+                costs_.resize(beam_width);
+                for (size_t i = 0; i < beam_width; ++i)
+                {
+                    costs_[i] = {0, i};
+                }
+            }
+
+            // 親の添字が num_parents 未満の候補を追加できるようにする(DiversityLimiter::reserve_parents 参照)
+            void reserve_parents(size_t num_parents)
+            {
+                diversity_.reserve_parents(num_parents);
+            }
+
+            // このターンのビーム幅を変える
+            // 候補を持っていないとき(構築直後かclearの後)に呼ぶ。幅は構築時のbeam_width以下にする
+            // segment treeはこの幅で構築するので、幅が狭いターンはその分だけ軽くなる
+            void set_beam_width(size_t width)
+            {
+                assert(candidates_.empty() && 1 <= width && width <= candidates_.capacity());
+                size_t old_width = costs_.size();
+                beam_width = width;
+                costs_.resize(width);
+                for (size_t i = old_width; i < width; ++i)
+                {
+                    costs_[i] = {0, i};
+                }
+            }
+
+            // 候補を追加する
+            // ターン数最小化型の問題で、candidateによって実行可能解が得られる場合にのみ finished = true とする
+            // ビーム幅分の候補をCandidateを追加したときにsegment treeを構築する
+            // max_candidates_per_group を指定したときは、groupに盤面の特徴を表すキーを渡す
+            void push(const Action &action, const Cost &cost, const Hash &hash, int parent, bool finished, uint64_t group = Diversity::NO_GROUP)
+            {
+                THUNDER_PROFILE_SCOPE("select");
+                if (finished)
+                {
+                    if (finished_candidates_.empty() || cost < finished_candidates_[best_finished_].cost)
+                    {
+                        best_finished_ = finished_candidates_.size();
+                    }
+                    finished_candidates_.emplace_back(action, cost, hash, parent);
+                    return;
+                }
+                if constexpr (is_integral_v<Cost>)
+                {
+                    if (use_radix_)
+                    {
+                        // 一度絞った後は、境目のコストより大きい候補は入らない
+                        // 境目と等しい候補は、tie_break_seed を指定したときだけ入れておき、絞るときに乱数で選ぶ
+                        if (full_ && (cost > cutoff_ || (cost == cutoff_ && tie_break_state_ == 0)))
+                        {
+                            return;
+                        }
+                        push_radix(Candidate(action, cost, hash, parent));
+                        return;
+                    }
+                }
+                if (full_ && cost >= st_.all_prod().first)
+                {
+                    // 保持しているどの候補よりもコストが小さくないとき
+                    // コストが等しいときは、tie_break_seed が指定されていれば乱数で入れ替えるか決める
+                    if (cost > st_.all_prod().first || !tie_break(cost))
+                    {
+                        return;
+                    }
+                }
+                if (use_bloom_filter_)
+                {
+                    push_with_bloom_filter(Candidate(action, cost, hash, parent));
+                    return;
+                }
+                if (diversity_.enabled())
+                {
+                    push_diverse(Candidate(action, cost, hash, parent), group);
+                    return;
+                }
+                // 足切りされなかったものだけCandidateを作る
+                Candidate candidate(action, cost, hash, parent);
+                auto [valid, i] = hash_to_index_.get_index(candidate.hash);
+
+                if (valid)
+                {
+                    int j = hash_to_index_.get(i);
+                    if (candidate.hash == candidates_[j].hash)
+                    {
+                        // ハッシュ値が等しいものが存在しているとき
+                        if (full_)
+                        {
+                            // segment treeが構築されている場合
+                            if (cost < st_.get(j).first)
+                            {
+                                candidates_[j] = candidate;
+                                update_best(j);
+                                st_.set(j, {cost, j});
+                            }
+                        }
+                        else
+                        {
+                            // segment treeが構築されていない場合
+                            if (cost < costs_[j].first)
+                            {
+                                candidates_[j] = candidate;
+                                update_best(j);
+                                costs_[j].first = cost;
+                            }
+                        }
+                        return;
+                    }
+                }
+                if (full_)
+                {
+                    // segment treeが構築されている場合
+                    int j = st_.all_prod().second;
+                    hash_to_index_.set(i, candidate.hash, j);
+                    candidates_[j] = candidate;
+                    update_best(j);
+                    st_.set(j, {cost, j});
+                }
+                else
+                {
+                    // segment treeが構築されていない場合
+                    int j = candidates_.size();
+                    hash_to_index_.set(i, candidate.hash, j);
+                    candidates_.emplace_back(candidate);
+                    update_best(j);
+                    costs_[j].first = cost;
+
+                    if (candidates_.size() == beam_width)
+                    {
+                        // 保持している候補がビーム幅分になったときにsegment treeを構築する
+                        full_ = true;
+                        st_ = MaxSegtree(costs_);
+                    }
+                }
+            }
+
+            // 子をまとめて追加する
+            // 今のビームの最大コストより大きいものを先にまとめて除き、残ったものだけをpushする
+            // pushするたびに最大コストは小さくなるだけなので、先に除いても結果は変わらない
+            void push_batch(const Action *actions, const Cost *costs, const Hash *hashes, const uint8_t *finished, size_t n, int parent)
+            {
+                survivors_.resize(n);
+                int *survivors = survivors_.data();
+                size_t num_survivors = n;
+                if (full_)
+                {
+                    num_survivors = filter_by_threshold(costs, finished, n, use_radix_ ? cutoff_ : st_.all_prod().first, survivors);
+                }
+                else
+                {
+                    iota(survivors, survivors + n, 0);
+                }
+
+                if (!use_bloom_filter_)
+                {
+                    for (size_t k = 0; k < num_survivors; ++k)
+                    {
+                        hash_to_index_.prefetch(hashes[survivors[k]]);
+                    }
+                }
+                for (size_t k = 0; k < num_survivors; ++k)
+                {
+                    int i = survivors[k];
+                    push(actions[i], costs[i], hashes[i], parent, finished[i]);
+                }
+            }
+
+            // expand_batch で書き込まれた子をまとめて追加する
+            // 子のコストとハッシュを配列のまま計算してから push_batch に渡す
+            void push_batch(Batch &batch, int parent, Cost parent_cost, Hash parent_hash)
+            {
+                size_t n = batch.size();
+                batch.costs.resize(n);
+                batch.hashes.resize(n);
+                Cost *costs = batch.costs.data();
+                Hash *hashes = batch.hashes.data();
+                const Cost *cost_deltas = batch.cost_deltas.data();
+                const Hash *hash_deltas = batch.hash_deltas.data();
+                for (size_t i = 0; i < n; ++i)
+                {
+                    costs[i] = parent_cost + cost_deltas[i];
+                    hashes[i] = parent_hash ^ hash_deltas[i];
+                }
+                push_batch(batch.actions.data(), costs, hashes, batch.finished.data(), n, parent);
+            }
+
+            // 選んだ候補を返す
+            const vector<Candidate> &select() const
+            {
+                return candidates_;
+            }
+
+            // 実行可能解が見つかったか
+            bool have_finished() const
+            {
+                return !finished_candidates_.empty();
+            }
+
+            // 実行可能解に到達するCandidateを返す
+            const vector<Candidate> &get_finished_candidates() const
+            {
+                return finished_candidates_;
+            }
+
+            // 実行可能解に到達するCandidateのうち最も評価がよいものを返す
+            // pushのたびに更新しているのでO(1)
+            const Candidate &get_best_finished_candidate() const
+            {
+                assert(have_finished());
+                return finished_candidates_[best_finished_];
+            }
+
+            // 最もよいCandidateを返す
+            // pushのたびに更新しているのでO(1)
+            const Candidate &calculate_best_candidate() const
+            {
+                assert(best_ != -1);
+                return candidates_[best_];
+            }
+
+            // 候補を追加し終えたら呼び、選んだ候補をビーム幅の個数に絞る
+            // 基数選択を使うときは、ビーム幅の2倍まで候補を溜めてから絞っているので、最後にもう一度絞る
+            void shrink_to_beam()
+            {
+                if constexpr (is_integral_v<Cost>)
+                {
+                    if (use_radix_)
+                    {
+                        radix_shrink();
+                    }
+                }
+            }
+
+            void clear()
+            {
+                candidates_.clear();
+                best_ = -1;
+                radix_costs_.clear();
+                radix_slots_.clear();
+                full_ = false;
+                tie_count_ = 0;
+                if (use_bloom_filter_)
+                {
+                    bloom_filter_.clear();
+                    beam_hashes_.clear();
+                }
+                else
+                {
+                    hash_to_index_.clear();
+                }
+                if (diversity_.enabled())
+                {
+                    diversity_.clear();
+                }
+            }
+
+            // 評価がよい順に最大k個のCandidateを返す
+            vector<Candidate> calculate_top_k_candidates(size_t k) const
+            {
+                return select_top_k(candidates_, k);
+            }
+
+            // 実行可能解に到達するCandidateを評価がよい順に最大k個返す
+            vector<Candidate> calculate_top_k_finished_candidates(size_t k) const
+            {
+                return select_top_k(finished_candidates_, k);
+            }
+
+            void clear_finished_candidates()
+            {
+                finished_candidates_.clear();
+            }
+
+            // 選んだ候補を、コストがよい width 個とそれ以外に分け、それ以外を返す
+            // select() はよい width 個だけを返すようになる
+            // backtrack_width を指定したときに、ビームに入らなかった候補を取り出すために使う
+            // segment treeは作り直さないので、呼んだ後は clear するまで push しない
+            const vector<Candidate> &split_pruned(size_t width)
+            {
+                pruned_.clear();
+                if (candidates_.size() <= width)
+                {
+                    return pruned_;
+                }
+                nth_element(candidates_.begin(), candidates_.begin() + width, candidates_.end(),
+                            [](const Candidate &a, const Candidate &b)
+                            { return a.cost < b.cost; });
+                pruned_.assign(candidates_.begin() + width, candidates_.end());
+                candidates_.erase(candidates_.begin() + width, candidates_.end());
+                // 並べ替えたので、最もよい候補の添字を求め直す
+                best_ = -1;
+                for (size_t j = 0; j < candidates_.size(); ++j)
+                {
+                    update_best(j);
+                }
+                return pruned_;
+            }
+
+#ifdef THUNDER_CHECKPOINT
+            // チェックポイントに保存する
+            // ターンの区切り(clear, clear_finished_candidates の後)に呼ぶので、候補は持っておらず、乱数の状態だけを保存すればよい
+            void save(CheckpointWriter &writer) const
+            {
+                assert(candidates_.empty() && finished_candidates_.empty());
+                writer.write(tie_break_state_);
+            }
+
+            // save で保存した状態を読み込む
+            void load(CheckpointReader &reader)
+            {
+                reader.read(tie_break_state_);
+            }
+#endif
+
+        private:
+            // 削除可能な優先度付きキュー
+            using MaxSegtree = atcoder::segtree<
+                pair<Cost, int>,
+                [](pair<Cost, int> a, pair<Cost, int> b)
+                {
+                    if (a.first >= b.first)
+                    {
+                        return a;
+                    }
+                    else
+                    {
+                        return b;
+                    }
+                },
+                []()
+                { return make_pair(numeric_limits<Cost>::min(), -1); }>;
+
+            size_t beam_width;
+            vector<Candidate> candidates_;
+            HashMap<Hash, int> hash_to_index_;
+            bool full_;
+            vector<pair<Cost, int>> costs_;
+            MaxSegtree st_;
+            uint64_t tie_break_state_;
+            // tie_break で数えている、最も悪い候補のコストとそのコストの候補の個数
+            Cost tie_cost_{};
+            size_t tie_count_ = 0;
+            // 基数選択でビームを選ぶか
+            bool use_radix_;
+            // 基数選択でビームを選ぶときに使う(radix_shrink 参照)
+            RadixSelect<Cost> radix_;
+            // 候補のコストとハッシュ表での位置(candidates_ と同じ順番)
+            vector<Cost> radix_costs_;
+            vector<int> radix_slots_;
+            // 一度絞った後の、残した候補の最大のコスト
+            Cost cutoff_;
+            // push_batch で残った子の添字
+            vector<int> survivors_;
+            // split_pruned で分けた、ビームに入らなかった候補
+            vector<Candidate> pruned_;
+            // 親ごと、グループごとの候補数の制限
+            using Diversity = DiversityLimiter<Cost>;
+            Diversity diversity_;
+            // Bloom filterで同一盤面を検出するときに使う
+            bool use_bloom_filter_;
+            BlockedBloomFilter bloom_filter_;
+            // ビーム内の候補のハッシュ値から添字への対応
+            CompactHashTable<Hash> beam_hashes_;
+
+            // Bloom filterで同一盤面を検出するときのpush
+            void push_with_bloom_filter(const Candidate &candidate)
+            {
+                if (bloom_filter_.insert(candidate.hash))
+                {
+                    // 見たことがあるかもしれないとき、ビーム内にあれば評価がよいほうを残す
+                    // ビーム内になければ重複ではないので、見たことがない候補と同じように追加する
+                    int j = beam_hashes_.find(candidate.hash);
+                    if (j != -1)
+                    {
+                        if (candidate.cost < candidates_[j].cost)
+                        {
+                            candidates_[j] = candidate;
+                            update_best(j);
+                            if (full_)
+                            {
+                                st_.set(j, {candidate.cost, j});
+                            }
+                            else
+                            {
+                                costs_[j].first = candidate.cost;
+                            }
+                        }
+                        return;
+                    }
+                }
+                if (full_)
+                {
+                    // segment treeが構築されている場合
+                    int j = st_.all_prod().second;
+                    beam_hashes_.erase(candidates_[j].hash);
+                    beam_hashes_.insert(candidate.hash, j);
+                    candidates_[j] = candidate;
+                    update_best(j);
+                    st_.set(j, {candidate.cost, j});
+                }
+                else
+                {
+                    // segment treeが構築されていない場合
+                    int j = candidates_.size();
+                    beam_hashes_.insert(candidate.hash, j);
+                    candidates_.emplace_back(candidate);
+                    update_best(j);
+                    costs_[j].first = candidate.cost;
+
+                    if (candidates_.size() == beam_width)
+                    {
+                        full_ = true;
+                        st_ = MaxSegtree(costs_);
+                    }
+                }
+            }
+
+            // 多様性の制約があるときのpush
+            // 同じ親や同じグループの候補が上限に達していたら、その中でコストが最大のものと入れ替える
+            void push_diverse(const Candidate &candidate, uint64_t group)
+            {
+                auto [valid, i] = hash_to_index_.get_index(candidate.hash);
+                if (valid)
+                {
+                    int j = hash_to_index_.get(i);
+                    if (candidate.hash == candidates_[j].hash)
+                    {
+                        // ハッシュ値が等しいものが存在しているとき
+                        if (candidate.cost < candidates_[j].cost && diversity_.can_replace(j, candidate.parent, group))
+                        {
+                            replace_candidate(j, candidate, group);
+                        }
+                        return;
+                    }
+                }
+                int victim = diversity_.find_victim(candidate.parent, group);
+                if (victim == -2 || (victim != -1 && candidate.cost >= candidates_[victim].cost))
+                {
+                    return;
+                }
+                if (victim == -1 && full_)
+                {
+                    victim = st_.all_prod().second;
+                }
+                if (victim != -1)
+                {
+                    hash_to_index_.set(i, candidate.hash, victim);
+                    replace_candidate(victim, candidate, group);
+                    return;
+                }
+                int j = candidates_.size();
+                hash_to_index_.set(i, candidate.hash, j);
+                candidates_.emplace_back(candidate);
+                update_best(j);
+                costs_[j].first = candidate.cost;
+                diversity_.add(j, candidate.cost, candidate.parent, group);
+                if (candidates_.size() == beam_width)
+                {
+                    full_ = true;
+                    st_ = MaxSegtree(costs_);
+                }
+            }
+
+            // j番目の候補を candidate に置き換える
+            void replace_candidate(int j, const Candidate &candidate, uint64_t group)
+            {
+                diversity_.remove(j);
+                candidates_[j] = candidate;
+                update_best(j);
+                if (full_)
+                {
+                    st_.set(j, {candidate.cost, j});
+                }
+                else
+                {
+                    costs_[j].first = candidate.cost;
+                }
+                diversity_.add(j, candidate.cost, candidate.parent, group);
+            }
+
+            // 基数選択を使うときのpush
+            // 候補をビーム幅の2倍まで溜め、溜まったらコストが小さい順にビーム幅の個数に絞る
+            // 絞るたびに境目のコストが下がるので、segment treeを使う場合と同じく悪い候補はすぐに捨てられる
+            void push_radix(const Candidate &candidate)
+            {
+                auto [valid, i] = hash_to_index_.get_index(candidate.hash);
+                if (valid)
+                {
+                    // 絞ったときに取り除いた候補の添字は、範囲外か別の候補を指している
+                    size_t j = hash_to_index_.get(i);
+                    if (j < candidates_.size() && candidate.hash == candidates_[j].hash)
+                    {
+                        // ハッシュ値が等しいものが存在しているとき
+                        if (candidate.cost < candidates_[j].cost)
+                        {
+                            candidates_[j] = candidate;
+                            radix_costs_[j] = candidate.cost;
+                            update_best(j);
+                        }
+                        return;
+                    }
+                }
+                int j = candidates_.size();
+                hash_to_index_.set(i, candidate.hash, j);
+                candidates_.emplace_back(candidate);
+                radix_costs_.push_back(candidate.cost);
+                radix_slots_.push_back(i);
+                update_best(j);
+                if (candidates_.size() == 2 * beam_width)
+                {
+                    radix_shrink();
+                }
+            }
+
+            // 基数選択で、コストが小さい順にビーム幅の個数だけ候補を残す
+            // コストが等しい候補は先に追加したほうを残し、tie_break_seed を指定したときは乱数で選ぶ
+            // 残す候補を前に詰めるだけなので、候補は追加した順に並んだまま
+            void radix_shrink()
+            {
+                if (candidates_.size() <= beam_width)
+                {
+                    return;
+                }
+                auto [threshold, num_taken, num_ties] = radix_.select(radix_costs_.data(), candidates_.size(), beam_width);
+                size_t m = 0;
+                best_ = -1;
+                for (size_t i = 0; i < candidates_.size(); ++i)
+                {
+                    Cost cost = radix_costs_[i];
+                    if (cost > threshold)
+                    {
+                        continue;
+                    }
+                    if (cost == threshold)
+                    {
+                        // 残りの num_ties 個から num_taken 個を選ぶ
+                        bool take = tie_break_state_ == 0 ? num_taken > 0 : xorshift64(tie_break_state_) % num_ties < num_taken;
+                        --num_ties;
+                        if (!take)
+                        {
+                            continue;
+                        }
+                        --num_taken;
+                    }
+                    candidates_[m] = candidates_[i];
+                    radix_costs_[m] = cost;
+                    radix_slots_[m] = radix_slots_[i];
+                    hash_to_index_.set(radix_slots_[m], candidates_[m].hash, m);
+                    update_best(m);
+                    ++m;
+                }
+                candidates_.erase(candidates_.begin() + m, candidates_.end());
+                radix_costs_.resize(m);
+                radix_slots_.resize(m);
+                cutoff_ = threshold;
+                full_ = true;
+            }
+
+            // 最も悪い候補とコストが等しい候補 cost で入れ替えるかどうかを返す
+            // そのコストの候補が来るのが n 個目なら、確率 1/n で入れ替える(reservoir sampling)
+            // 同じ枠を争った候補はどれも同じ確率で残るので、基数選択で境目の候補を乱数で選ぶのと揃う
+            // tie_break_seed が0なら常に入れ替えない
+            bool tie_break(const Cost &cost)
+            {
+                if (tie_break_state_ == 0)
+                {
+                    return false;
+                }
+                if (tie_count_ == 0 || cost != tie_cost_)
+                {
+                    // 最も悪い候補のコストは下がる一方なので、違うコストになったら数え直す
+                    // 枠を持っている候補を1個目とする
+                    tie_cost_ = cost;
+                    tie_count_ = 1;
+                }
+                ++tie_count_;
+                return xorshift64(tie_break_state_) % tie_count_ == 0;
+            }
+            vector<Candidate> finished_candidates_;
+            size_t best_finished_ = 0;
+            // 最もよい候補の添字(候補がなければ-1)
+            int best_ = -1;
+
+            // j番目の候補を書き換えた後に呼び、最もよい候補の添字を更新する
+            // 書き換えるのは同じ盤面でコストがよくなるときか、コストが最大の候補を追い出すときだけで、
+            // どの添字のコストも大きくならないので、最もよい候補を探し直す必要はない
+            // コストが等しいときは添字が小さいほうを選ぶ
+            void update_best(int j)
+            {
+                if (best_ == -1 || candidates_[j].cost < candidates_[best_].cost ||
+                    (candidates_[j].cost == candidates_[best_].cost && j < best_))
+                {
+                    best_ = j;
+                }
+            }
+        };
+
+        // 根からのパスを、direct_road_ の先頭部分の長さとそれより後ろのactionで表す
+        // 毎回direct_road_をコピーせずに済む
+        struct LazyPath
+        {
+            size_t direct_road_length = 0;
+            vector<Action> tail;
+        };
+
+        // Euler Tourを管理するためのクラス
+        class Tree
+        {
+        public:
+            explicit Tree(const State<Selector> &state, const Config &config) : state_(state)
+            {
+                curr_tour_.init(config.tour_capacity, config.tour_spill_dir);
+                next_tour_.init(config.tour_capacity, config.tour_spill_dir);
+                // 探索をやり直したときは、葉の数が backtrack_width 個になる
+                leaves_.reserve(max(config.beam_width, config.backtrack_width));
+                buckets_.assign(max(config.beam_width, config.backtrack_width), {});
+            }
+
+            // 状態を更新しながら深さ優先探索を行い、次のノードの候補を全てselectorに追加する
+            void dfs(Selector &selector)
+            {
+                THUNDER_PROFILE_SCOPE("dfs");
+                THUNDER_TRACE_SCOPE("dfs");
+                THUNDER_PERF_SCOPE("dfs");
+                if (curr_tour_.empty())
+                {
+                    // 最初のターン
+                    // commit_best_child で根の子の葉を確定したときは、その葉が新しい根になる
+                    auto [cost, hash] = root_leaf_ ? *root_leaf_ : state_.make_initial_node();
+                    expand(0, cost, hash, selector);
+                    return;
+                }
+
+                for (auto [leaf_index, action] : curr_tour_)
+                {
+                    if (leaf_index >= 0)
+                    {
+                        // 葉
+                        state_.move_forward(action);
+                        auto [cost, hash] = leaves_[leaf_index];
+                        {
+                            THUNDER_PROFILE_SCOPE("expand");
+                            expand(leaf_index, cost, hash, selector);
+                        }
+                        state_.move_backward(action);
+                    }
+                    else if (leaf_index == -1)
+                    {
+                        // 前進辺
+                        state_.move_forward(action);
+                    }
+                    else
+                    {
+                        // 後退辺
+                        state_.move_backward(action);
+                    }
+                }
+            }
+
+            // 木を更新する
+            void update(const vector<Candidate> &candidates)
+            {
+                THUNDER_PROFILE_SCOPE("update");
+                THUNDER_TRACE_SCOPE("update");
+                THUNDER_PERF_SCOPE("update");
+                leaves_.clear();
+
+                if (curr_tour_.empty())
+                {
+                    // 最初のターン
+                    for (const Candidate &candidate : candidates)
+                    {
+                        curr_tour_.push_back({(int)leaves_.size(), candidate.action});
+                        leaves_.push_back({candidate.cost, candidate.hash});
+                    }
+                    return;
+                }
+
+                for (const Candidate &candidate : candidates)
+                {
+                    buckets_[candidate.parent].push_back({candidate.action, candidate.cost, candidate.hash});
+                }
+
+                auto it = curr_tour_.begin();
+
+                // 一本道を反復しないようにする
+                while (it->first == -1 && it->second == curr_tour_.back().second)
+                {
+                    Action action = (it++)->second;
+                    state_.move_forward(action);
+                    direct_road_.push_back(action);
+                    curr_tour_.pop_back();
+                }
+
+                // 葉の追加や不要な辺の削除をする
+                while (it != curr_tour_.end())
+                {
+                    auto [leaf_index, action] = *(it++);
+                    if (leaf_index >= 0)
+                    {
+                        // 葉
+                        if (buckets_[leaf_index].empty())
+                        {
+                            continue;
+                        }
+                        next_tour_.push_back({-1, action});
+                        for (auto [new_action, cost, hash] : buckets_[leaf_index])
+                        {
+                            int new_leaf_index = leaves_.size();
+                            next_tour_.push_back({new_leaf_index, new_action});
+                            leaves_.push_back({cost, hash});
+                        }
+                        buckets_[leaf_index].clear();
+                        next_tour_.push_back({-2, action});
+                    }
+                    else if (leaf_index == -1)
+                    {
+                        // 前進辺
+                        next_tour_.push_back({-1, action});
+                    }
+                    else
+                    {
+                        // 後退辺
+                        auto [old_leaf_index, old_action] = next_tour_.back();
+                        if (old_leaf_index == -1)
+                        {
+                            next_tour_.pop_back();
+                        }
+                        else
+                        {
+                            next_tour_.push_back({-2, action});
+                        }
+                    }
+                }
+                swap(curr_tour_, next_tour_);
+                curr_tour_.seal();
+                next_tour_.clear();
+                THUNDER_TRACE_COUNTER("tour_size", curr_tour_.size());
+                THUNDER_TRACE_COUNTER("leaves", leaves_.size());
+            }
+
+            // 仮想的な根の子として複数の初期状態を置き、それらを葉とする
+            // 構築直後に呼ぶ
+            void set_roots(const vector<Root> &roots)
+            {
+                assert(curr_tour_.empty());
+                if (buckets_.size() < roots.size())
+                {
+                    buckets_.resize(roots.size());
+                }
+                for (const Root &root : roots)
+                {
+                    curr_tour_.push_back({(int)leaves_.size(), root.action});
+                    leaves_.push_back({root.cost, root.hash});
+                }
+                curr_tour_.seal();
+            }
+
+            // 根からのパスを取得する
+            vector<Action> calculate_path(int parent, int turn) const
+            {
+                // cerr << curr_tour_.size() << endl;
+
+                vector<Action> ret = direct_road_;
+                ret.reserve(turn);
+                if (curr_tour_.empty())
+                {
+                    // 最初のターン
+                    return ret;
+                }
+                for (auto [leaf_index, action] : curr_tour_)
+                {
+                    if (leaf_index >= 0)
+                    {
+                        if (leaf_index == parent)
+                        {
+                            ret.push_back(action);
+                            return ret;
+                        }
+                    }
+                    else if (leaf_index == -1)
+                    {
+                        ret.push_back(action);
+                    }
+                    else
+                    {
+                        ret.pop_back();
+                    }
+                }
+
+                assert(false);
+                return {};
+            }
+
+            // 根からのパスを後から復元できる形で取得する
+            // direct_road_ は末尾に追加されるだけなので、その長さだけを覚えておけばよい
+            LazyPath calculate_lazy_path(int parent) const
+            {
+                LazyPath ret;
+                ret.direct_road_length = direct_road_.size();
+                if (curr_tour_.empty())
+                {
+                    // 最初のターン
+                    return ret;
+                }
+                for (auto [leaf_index, action] : curr_tour_)
+                {
+                    if (leaf_index >= 0)
+                    {
+                        if (leaf_index == parent)
+                        {
+                            ret.tail.push_back(action);
+                            return ret;
+                        }
+                    }
+                    else if (leaf_index == -1)
+                    {
+                        ret.tail.push_back(action);
+                    }
+                    else
+                    {
+                        ret.tail.pop_back();
+                    }
+                }
+
+                assert(false);
+                return {};
+            }
+
+            // calculate_lazy_path で取得したパスを復元する
+            vector<Action> restore_path(const LazyPath &path) const
+            {
+                vector<Action> ret(direct_road_.begin(), direct_road_.begin() + path.direct_road_length);
+                ret.insert(ret.end(), path.tail.begin(), path.tail.end());
+                return ret;
+            }
+
+            // 各候補の根からのパスを、Euler Tourを1回走査するだけでまとめて取得する
+            // 共通の接頭辞はトライ木のノードを共有する
+            // 戻り値のk番目のパスはcandidates[k]に対応する
+            Paths calculate_paths(const vector<Candidate> &candidates) const
+            {
+                Paths paths;
+                paths.ends.assign(candidates.size(), -1);
+                for (const Candidate &candidate : candidates)
+                {
+                    paths.costs.push_back(candidate.cost);
+                }
+
+                int base = -1;
+                for (const Action &action : direct_road_)
+                {
+                    base = paths.add_node(base, action);
+                }
+
+                if (curr_tour_.empty())
+                {
+                    // 最初のターン
+                    for (size_t k = 0; k < candidates.size(); ++k)
+                    {
+                        paths.ends[k] = paths.add_node(base, candidates[k].action);
+                    }
+                    return paths;
+                }
+
+                // 葉のインデックスはEuler Tour上で昇順に並んでいるので、
+                // 親の昇順に候補を並べておけば1回の走査で済む
+                vector<int> order(candidates.size());
+                iota(order.begin(), order.end(), 0);
+                sort(order.begin(), order.end(), [&](int a, int b)
+                     { return candidates[a].parent < candidates[b].parent; });
+                size_t next = 0;
+
+                // 根から今いる位置までの辺と、対応するトライ木のノード(未作成なら-1)
+                vector<pair<Action, int>> road;
+                road.reserve(direct_road_.size() + curr_tour_.size());
+                // road のうち先頭 created 個はトライ木のノードが作成済み
+                size_t created = 0;
+                for (auto [leaf_index, action] : curr_tour_)
+                {
+                    if (next == order.size())
+                    {
+                        break;
+                    }
+                    if (leaf_index >= 0)
+                    {
+                        if (leaf_index != candidates[order[next]].parent)
+                        {
+                            continue;
+                        }
+                        for (; created < road.size(); ++created)
+                        {
+                            int parent = created == 0 ? base : road[created - 1].second;
+                            road[created].second = paths.add_node(parent, road[created].first);
+                        }
+                        int parent = road.empty() ? base : road.back().second;
+                        int leaf = paths.add_node(parent, action);
+                        while (next < order.size() && candidates[order[next]].parent == leaf_index)
+                        {
+                            int k = order[next++];
+                            paths.ends[k] = paths.add_node(leaf, candidates[k].action);
+                        }
+                    }
+                    else if (leaf_index == -1)
+                    {
+                        road.push_back({action, -1});
+                    }
+                    else
+                    {
+                        road.pop_back();
+                        created = min(created, road.size());
+                    }
+                }
+
+                assert(next == order.size());
+                return paths;
+            }
+
+            // 探索木を捨て、layer のパスの終点を葉とする木から探索をやり直す
+            // layer のパスは根から始まり、全て同じ長さとする
+            void restart(const typename Frontier::Layer &layer)
+            {
+                THUNDER_PROFILE_SCOPE("restart");
+                // state_ は一本道の終点にいるので、根まで戻す
+                for (auto it = direct_road_.rbegin(); it != direct_road_.rend(); ++it)
+                {
+                    state_.move_backward(*it);
+                }
+                direct_road_.clear();
+                committed_ = 0;
+                root_leaf_.reset();
+                leaves_.clear();
+                curr_tour_.clear();
+
+                // トライ木の子を列挙できるようにする
+                // 子はインデックスの降順につなぐので、順にstackに積むと昇順に取り出せる
+                size_t n = layer.nodes.size();
+                vector<int> child(n, -1), right(n, -1), end_index(n, -1);
+                int roots = -1;
+                for (size_t v = 0; v < n; ++v)
+                {
+                    int parent = layer.nodes[v].first;
+                    int &head = parent == -1 ? roots : child[parent];
+                    right[v] = head;
+                    head = v;
+                }
+                for (size_t k = 0; k < layer.size(); ++k)
+                {
+                    end_index[layer.ends[k]] = k;
+                }
+
+                // トライ木を深さ優先で走査してEuler Tourを作る
+                // stack の要素は {ノード, 後退辺か}
+                vector<pair<int, bool>> stack;
+                for (int v = roots; v != -1; v = right[v])
+                {
+                    stack.push_back({v, false});
+                }
+                while (!stack.empty())
+                {
+                    auto [v, backward] = stack.back();
+                    stack.pop_back();
+                    const Action &action = layer.nodes[v].second;
+                    if (backward)
+                    {
+                        curr_tour_.push_back({-2, action});
+                    }
+                    else if (end_index[v] != -1)
+                    {
+                        curr_tour_.push_back({(int)leaves_.size(), action});
+                        leaves_.push_back(layer.costs[end_index[v]]);
+                    }
+                    else
+                    {
+                        curr_tour_.push_back({-1, action});
+                        stack.push_back({v, true});
+                        for (int c = child[v]; c != -1; c = right[c])
+                        {
+                            stack.push_back({c, false});
+                        }
+                    }
+                }
+                curr_tour_.seal();
+            }
+
+#ifdef THUNDER_CHECKPOINT
+            // チェックポイントに保存する
+            // Euler Tour と葉は配列のまま書き出すので、読み込みはコピー1回で済む
+            void save(CheckpointWriter &writer) const
+            {
+                writer.write_array(curr_tour_.data(), curr_tour_.size());
+                writer.write_vector(leaves_);
+                writer.write_vector(direct_road_);
+                writer.write(committed_);
+                if constexpr (CheckpointableState<State<Selector>>)
+                {
+                    state_.save(writer);
+                }
+            }
+
+            // save で保存した状態を読み込む
+            // 構築直後(state_ が初期状態)に呼ぶ
+            // State が save, load を実装していなければ、初期状態から direct_road_ をたどって復元する
+            void load(CheckpointReader &reader)
+            {
+                span<const pair<int, Action>> tour = reader.view_vector<pair<int, Action>>();
+                curr_tour_.assign(tour.data(), tour.size());
+                reader.read_vector(leaves_);
+                reader.read_vector(direct_road_);
+                reader.read(committed_);
+                if constexpr (CheckpointableState<State<Selector>>)
+                {
+                    state_.load(reader);
+                }
+                else
+                {
+                    for (const Action &action : direct_road_)
+                    {
+                        state_.move_forward(action);
+                    }
+                }
+            }
+#endif
+
+            // 確定済みのactionの個数
+            size_t get_committed_size() const
+            {
+                return committed_;
+            }
+
+            // commit_best_child で確定できるactionがあるか
+            // 探索する前(葉がまだないとき)は、direct_road_ に未確定のactionが残っていなければ確定できない
+            bool can_commit() const
+            {
+                return committed_ < direct_road_.size() || !leaves_.empty();
+            }
+
+            // 根から最もよい葉に向かう最初のactionを確定して返す
+            // can_commit() が true のときに呼ぶ
+            // direct_road_ に未確定のactionが残っていればそれを確定するだけでよい
+            // そうでなければ、確定しなかった根の子の部分木をEuler Tourから取り除き、
+            // 残った部分木の葉をそのまま次の探索に使う
+            Action commit_best_child()
+            {
+                THUNDER_PROFILE_SCOPE("commit");
+                THUNDER_TRACE_SCOPE("commit");
+                THUNDER_PERF_SCOPE("commit");
+                if (committed_ < direct_road_.size())
+                {
+                    return direct_road_[committed_++];
+                }
+                assert(!leaves_.empty());
+
+                int best_leaf = 0;
+                for (size_t i = 0; i < leaves_.size(); ++i)
+                {
+                    if (leaves_[i].first < leaves_[best_leaf].first)
+                    {
+                        best_leaf = i;
+                    }
+                }
+
+                // best_leaf を含む根の子の部分木 [begin, end] を探す
+                size_t begin = 0;
+                size_t end = 0;
+                int depth = 0;
+                bool found = false;
+                for (size_t i = 0; i < curr_tour_.size(); ++i)
+                {
+                    auto [leaf_index, action] = curr_tour_[i];
+                    if (depth == 0)
+                    {
+                        begin = i;
+                    }
+                    if (leaf_index >= 0)
+                    {
+                        found |= leaf_index == best_leaf;
+                    }
+                    else if (leaf_index == -1)
+                    {
+                        ++depth;
+                    }
+                    else
+                    {
+                        --depth;
+                    }
+                    if (depth == 0 && found)
+                    {
+                        end = i;
+                        break;
+                    }
+                }
+                assert(found);
+
+                Action action = curr_tour_[begin].second;
+                state_.move_forward(action);
+                direct_road_.push_back(action);
+                ++committed_;
+
+                // 部分木の内側だけを残し、葉のインデックスをEuler Tour上の順に振り直す
+                vector<pair<Cost, Hash>> old_leaves;
+                swap(old_leaves, leaves_);
+                if (begin == end)
+                {
+                    // 根の子の葉を確定したので、部分木の内側は空になる
+                    // 次の dfs ではその葉のコストから展開する
+                    root_leaf_ = old_leaves[best_leaf];
+                }
+                for (size_t i = begin + 1; i < end; ++i)
+                {
+                    auto [leaf_index, old_action] = curr_tour_[i];
+                    if (leaf_index >= 0)
+                    {
+                        next_tour_.push_back({(int)leaves_.size(), old_action});
+                        leaves_.push_back(old_leaves[leaf_index]);
+                    }
+                    else
+                    {
+                        next_tour_.push_back({leaf_index, old_action});
+                    }
+                }
+                swap(curr_tour_, next_tour_);
+                curr_tour_.seal();
+                next_tour_.clear();
+                return action;
+            }
+
+        private:
+            State<Selector> state_;
+            TourBuffer<pair<int, Action>> curr_tour_;
+            TourBuffer<pair<int, Action>> next_tour_;
+            vector<pair<Cost, Hash>> leaves_;
+            vector<vector<tuple<Action, Cost, Hash>>> buckets_;
+            vector<Action> direct_road_;
+            // direct_road_ のうち、先頭から何個のactionを確定したか
+            size_t committed_ = 0;
+            // Euler Tour が空のときに展開する根の値(commit_best_child で根の子の葉を確定したとき)
+            // 持っていなければ make_initial_node を使う
+            optional<pair<Cost, Hash>> root_leaf_;
+            // expand_batch で使い回すバッファ
+            typename Selector::Batch batch_;
+
+            // 今のノードの子をselectorに追加する
+            void expand(int parent, Cost cost, Hash hash, Selector &selector)
+            {
+                if constexpr (BatchExpandConcept<State<Selector>, typename Selector::Batch>)
+                {
+                    batch_.clear();
+                    state_.expand_batch(parent, batch_);
+                    selector.push_batch(batch_, parent, cost, hash);
+                }
+                else
+                {
+                    state_.expand(parent, selector);
+                }
+            }
+        };
+
+        // ローリングホライズン(オンライン)で探索するためのクラス
+        // step(turns) で探索をturnsターン深くしてから、根から最もよい葉に向かう最初のactionを確定して返す
+        // 確定しなかった根の子の部分木は捨て、残った部分木は次のstepでそのまま使うので、
+        // 毎回最初から探索し直す場合と違い、ビーム幅分の葉を作り直さずに済む
+        // 初回はビームの深さ分、2回目以降は1ターンずつ深くするのが基本的な使い方
+        class RollingSearch
+        {
+        public:
+            explicit RollingSearch(const Config &config, const State<Selector> &state) : config_(config),
+                                                                                          tree_(state, config),
+                                                                                          selector_(config) {}
+
+            // 探索をturnsターン深くしてから、actionを1つ確定して返す
+            // 実行可能解が見つかった後は、そのパスに沿ってactionを返す
+            // 返すactionがないとき(ビームが途絶えたとき、実行可能解のパスを返し終えたとき、
+            // 葉がないのに turns が0のとき)はnulloptを返す
+            optional<Action> step(int turns)
+            {
+                if (!finished_path_.empty())
+                {
+                    if (finished_path_index_ == finished_path_.size())
+                    {
+                        return nullopt;
+                    }
+                    return finished_path_[finished_path_index_++];
+                }
+
+                for (int turn = 0; turn < turns; ++turn, ++turn_)
+                {
+                    // Euler Tourでselectorに候補を追加する
+                    selector_.set_beam_width(config_.get_beam_width(turn_));
+                    tree_.dfs(selector_);
+                    selector_.shrink_to_beam();
+
+                    if (selector_.have_finished())
+                    {
+                        // 実行可能解が見つかったら、以降はそのパスをたどる
+                        const Candidate &candidate = selector_.get_best_finished_candidate();
+                        finished_path_ = tree_.calculate_path(candidate.parent, 0);
+                        finished_path_.push_back(candidate.action);
+                        finished_path_index_ = tree_.get_committed_size();
+                        selector_.clear_finished_candidates();
+                        selector_.clear();
+                        return step(0);
+                    }
+                    if (selector_.select().empty())
+                    {
+                        return nullopt;
+                    }
+
+                    // 木を更新する
+                    tree_.update(selector_.select());
+                    THUNDER_PERF_TURN_END();
+
+                    selector_.clear();
+                }
+                if (!tree_.can_commit())
+                {
+                    return nullopt;
+                }
+                return tree_.commit_best_child();
+            }
+
+        private:
+            Config config_;
+            Tree tree_;
+            Selector selector_;
+            // 根から何ターン探索したか
+            int turn_ = 0;
+            vector<Action> finished_path_;
+            size_t finished_path_index_ = 0;
+        };
+
+#ifdef THUNDER_CHECKPOINT
+        // beam_search の途中経過を config.checkpoint_path に保存する
+        // next_turn は再開したときに最初に探索するターン
+        void save_checkpoint(const Config &config, int next_turn, Cost best_cost, const LazyPath &best_path,
+                             const Frontier &frontier, int backtracks, Cost stall_best_cost, int stall_turns,
+                             const Tree &tree, const Selector &selector) const
+        {
+            THUNDER_PROFILE_SCOPE("checkpoint");
+            CheckpointWriter writer(config.checkpoint_path);
+            // 読み込むときに設定や型が変わっていないかを確認するための値
+            writer.write(sizeof(Action));
+            writer.write(sizeof(Cost));
+            writer.write(sizeof(Hash));
+            writer.write(config.beam_width);
+            writer.write(config.max_turn);
+            writer.write(config.backtrack_width);
+
+            writer.write(next_turn);
+            writer.write(best_cost);
+            writer.write(best_path.direct_road_length);
+            writer.write_vector(best_path.tail);
+            frontier.save(writer);
+            writer.write(backtracks);
+            writer.write(stall_best_cost);
+            writer.write(stall_turns);
+            tree.save(writer);
+            selector.save(writer);
+            writer.commit();
+        }
+
+        // save_checkpoint で保存した途中経過を読み込み、再開するターンを返す
+        int load_checkpoint(const Config &config, Cost &best_cost, LazyPath &best_path,
+                            Frontier &frontier, int &backtracks, Cost &stall_best_cost, int &stall_turns,
+                            Tree &tree, Selector &selector) const
+        {
+            THUNDER_PROFILE_SCOPE("checkpoint");
+            CheckpointReader reader(config.checkpoint_path);
+            reader.expect(sizeof(Action), "sizeof(Action)");
+            reader.expect(sizeof(Cost), "sizeof(Cost)");
+            reader.expect(sizeof(Hash), "sizeof(Hash)");
+            reader.expect(config.beam_width, "beam_width");
+            reader.expect(config.max_turn, "max_turn");
+            reader.expect(config.backtrack_width, "backtrack_width");
+
+            int next_turn = reader.read<int>();
+            reader.read(best_cost);
+            reader.read(best_path.direct_road_length);
+            reader.read_vector(best_path.tail);
+            frontier.load(reader);
+            reader.read(backtracks);
+            reader.read(stall_best_cost);
+            reader.read(stall_turns);
+            tree.load(reader);
+            selector.load(reader);
+            return next_turn;
+        }
+#endif
+
+        // ビームサーチを行う関数
+        // roots を渡すと、state を仮想的な根としてその子の複数の初期状態から同時に探索する
+        // 初期状態どうしも1つのSelectorで競わせるので、初期状態ごとに探索する場合と違い、Euler Tourなどは1組で済む
+        // このとき返すパスの先頭は、どの初期状態から始めたかを表す roots[k].action になる
+        vector<Action> beam_search(const Config &config, const State<Selector> &state, const vector<Root> &roots = {})
+        {
+            Tree tree(state, config);
+            if (!roots.empty())
+            {
+                tree.set_roots(roots);
+            }
+
+            // 新しいノード候補の集合
+            Selector selector(config);
+            selector.reserve_parents(roots.size());
+
+            // config.return_finished_immediately が false のときに、
+            // 実行可能解の中で一番よいものを覚えておくための変数
+            // ビームサーチ内で扱うturnと問題のturnが一致しないときに使う
+            Cost best_cost = numeric_limits<Cost>::max();
+            LazyPath best_path;
+
+            // backtrack_width を指定したときに、ビームに入らなかった候補を覚えておく
+            Frontier frontier(config.backtrack_width);
+            int backtracks = 0;
+            // backtrack_stall_turns を指定したときに、ビーム内の最もよいコストが更新されなかったターン数を数える
+            Cost stall_best_cost = numeric_limits<Cost>::max();
+            int stall_turns = 0;
+
+            int start_turn = 0;
+#ifdef THUNDER_CHECKPOINT
+            if (config.resume_from_checkpoint && CheckpointReader::exists(config.checkpoint_path))
+            {
+                start_turn = load_checkpoint(config, best_cost, best_path, frontier, backtracks, stall_best_cost, stall_turns,
+                                             tree, selector);
+            }
+#else
+            if (config.checkpoint_interval > 0 || config.resume_from_checkpoint)
+            {
+                cerr << "ERROR: checkpoint_interval and resume_from_checkpoint require THUNDER_CHECKPOINT" << endl;
+                exit(-1);
+            }
+#endif
+            for (int turn = start_turn; turn < config.max_turn; ++turn)
+            {
+                // Euler Tourでselectorに候補を追加する
+                // ビームに入らなかった候補も覚えるときは、その分だけ広く選んでおいて後で分ける
+                selector.set_beam_width(config.get_beam_width(turn) + config.backtrack_width);
+                tree.dfs(selector);
+                selector.shrink_to_beam();
+
+                if (selector.have_finished())
+                {
+                    // ターン数最小化型の問題で実行可能解が見つかったとき
+                    if (config.return_finished_immediately)
+                    {
+                        const Candidate &candidate = selector.get_best_finished_candidate();
+                        vector<Action> ret = tree.calculate_path(candidate.parent, turn + 1);
+                        ret.push_back(candidate.action);
+                        return ret;
+                    }
+                    else
+                    {
+                        // 最もよいものだけを見て、更新するときだけパスを計算する
+                        const Candidate &candidate = selector.get_best_finished_candidate();
+                        if (candidate.cost < best_cost)
+                        {
+                            best_cost = candidate.cost;
+                            best_path = tree.calculate_lazy_path(candidate.parent);
+                            best_path.tail.push_back(candidate.action);
+                        }
+                    }
+                    selector.clear_finished_candidates();
+                }
+                if (frontier.enabled() && best_path.tail.empty() && backtracks < config.max_backtracks &&
+                    timer_library::timer.getTime() <= config.time_limit)
+                {
+                    // 実行可能解が見つかる前にビームが途絶えたか、行き詰まったときは、覚えている候補からやり直す
+                    bool dead = selector.select().empty();
+                    bool stalled = false;
+                    if (!dead && config.backtrack_stall_turns > 0)
+                    {
+                        Cost cost = selector.calculate_best_candidate().cost;
+                        if (cost < stall_best_cost)
+                        {
+                            stall_best_cost = cost;
+                            stall_turns = 0;
+                        }
+                        else
+                        {
+                            stalled = ++stall_turns >= config.backtrack_stall_turns;
+                        }
+                    }
+                    if (dead || stalled)
+                    {
+                        // 途絶えたときはこのターン以前、行き詰まったときは今より浅いターンの候補を使う
+                        typename Frontier::Layer layer;
+                        int restart_turn = frontier.pop(dead ? turn : turn - 1, layer);
+                        if (restart_turn != -1)
+                        {
+                            tree.restart(layer);
+                            selector.clear();
+                            ++backtracks;
+                            stall_best_cost = numeric_limits<Cost>::max();
+                            stall_turns = 0;
+                            // restart_turn ターン目の候補が葉になったので、次は restart_turn + 1 ターン目を探索する
+                            turn = restart_turn;
+                            continue;
+                        }
+                    }
+                }
+                if (selector.select().empty())
+                {
+                    if (best_path.tail.empty())
+                    {
+                        // 実行可能解が見つからなかったとき
+                        return {};
+                    }
+                    return tree.restore_path(best_path);
+                }
+                assert(!selector.select().empty());
+
+                if (turn == config.max_turn - 1 || timer_library::timer.getTime() > config.time_limit)
+                {
+                    // ターン数固定型の問題で全ターンが終了したとき、または制限時間を過ぎたとき
+                    if (!best_path.tail.empty())
+                    {
+                        // 制限時間を過ぎる前に実行可能解が見つかっていたとき
+                        return tree.restore_path(best_path);
+                    }
+                    Candidate best_candidate = selector.calculate_best_candidate();
+                    vector<Action> ret = tree.calculate_path(best_candidate.parent, turn + 1);
+                    ret.push_back(best_candidate.action);
+                    return ret;
+                }
+
+                if (frontier.enabled())
+                {
+                    // ビームに入らなかった候補を、根からのパスにして覚えておく
+                    const vector<Candidate> &pruned = selector.split_pruned(config.get_beam_width(turn));
+                    if (!pruned.empty())
+                    {
+                        vector<pair<Cost, Hash>> leaves;
+                        leaves.reserve(pruned.size());
+                        for (const Candidate &candidate : pruned)
+                        {
+                            leaves.push_back({candidate.cost, candidate.hash});
+                        }
+                        frontier.record(turn, tree.calculate_paths(pruned), move(leaves));
+                    }
+                }
+
+                // 木を更新する
+                tree.update(selector.select());
+                THUNDER_PERF_TURN_END();
+
+                selector.clear();
+
+#ifdef THUNDER_CHECKPOINT
+                if (config.checkpoint_interval > 0 && (turn + 1) % config.checkpoint_interval == 0)
+                {
+                    save_checkpoint(config, turn + 1, best_cost, best_path, frontier, backtracks, stall_best_cost, stall_turns,
+                                    tree, selector);
+                }
+#endif
+            }
+
+            assert(false);
+            return {};
+        }
+
+        // ビームサーチを行い、評価がよい順に最大k個の解のパスを返す
+        // 最終ターンのSelectorに残った候補(実行可能解が見つかった場合はその候補)からk個を選ぶ
+        // k回ビームサーチをする場合と違い、探索は1回で済む
+        // roots は beam_search と同じ
+        Paths beam_search_top_k(const Config &config, const State<Selector> &state, size_t k, const vector<Root> &roots = {})
+        {
+            Tree tree(state, config);
+            if (!roots.empty())
+            {
+                tree.set_roots(roots);
+            }
+
+            // 新しいノード候補の集合
+            Selector selector(config);
+            selector.reserve_parents(roots.size());
+
+            // config.return_finished_immediately が false のときに、
+            // 実行可能解の中でよいものk個を覚えておくための変数
+            Paths best_paths;
+            for (int turn = 0; turn < config.max_turn; ++turn)
+            {
+                // Euler Tourでselectorに候補を追加する
+                selector.set_beam_width(config.get_beam_width(turn));
+                tree.dfs(selector);
+                selector.shrink_to_beam();
+
+                if (selector.have_finished())
+                {
+                    // ターン数最小化型の問題で実行可能解が見つかったとき
+                    Paths paths = tree.calculate_paths(selector.calculate_top_k_finished_candidates(k));
+                    if (config.return_finished_immediately)
+                    {
+                        return paths;
+                    }
+                    best_paths = Paths::merge_top_k(best_paths, paths, k);
+                    selector.clear_finished_candidates();
+                }
+                if (selector.select().empty())
+                {
+                    return best_paths;
+                }
+
+                if (turn == config.max_turn - 1 || timer_library::timer.getTime() > config.time_limit)
+                {
+                    // ターン数固定型の問題で全ターンが終了したとき、または制限時間を過ぎたとき
+                    if (best_paths.size() > 0)
+                    {
+                        // 制限時間を過ぎる前に実行可能解が見つかっていたとき
+                        return best_paths;
+                    }
+                    return tree.calculate_paths(selector.calculate_top_k_candidates(k));
+                }
+
+                // 木を更新する
+                tree.update(selector.select());
+                THUNDER_PERF_TURN_END();
+
+                selector.clear();
+            }
+
+            assert(false);
+            return {};
+        }
+
+        // StateConcept のチェックを構造体内で実施
+        static_assert(StateConcept<State<Selector>, Hash, Cost, Action, Selector>,
+                      "State template must satisfy StateConcept with BeamSearch::Selector");
+
+    }; // EdgeBeamSearch
+
+    // expand_batch で State が子を書き込むバッファ(hashなし版)
+    template <typename Action, typename Cost>
+    struct ExpandBatchNoHash
+    {
+        vector<Action> actions;
+        vector<Cost> cost_deltas;
+        vector<uint8_t> finished;
+
+        // 以下はエンジン側で使う作業領域
+        vector<Cost> costs;
+
+        // 子を追加する
+        // 子のコストは親のコスト + cost_delta になる
+        void push(const Action &action, Cost cost_delta, bool is_finished = false)
+        {
+            actions.push_back(action);
+            cost_deltas.push_back(cost_delta);
+            finished.push_back(is_finished);
+        }
+
+        size_t size() const
+        {
+            return actions.size();
+        }
+
+        void clear()
+        {
+            actions.clear();
+            cost_deltas.clear();
+            finished.clear();
+        }
+    };
+
+    template <typename StateType, typename CostType, typename ActionType, typename SelectorType>
+    concept StateConceptNoHash =
+        CostConcept<CostType> &&
+        (requires(StateType state, SelectorType selector) {
+            { state.expand(std::declval<int>(), selector) } -> same_as<void>;
+        } || BatchExpandConcept<StateType, typename SelectorType::Batch>) &&
+        requires(StateType state) {
+            { state.move_forward(std::declval<ActionType>()) } -> same_as<void>;
+            { state.move_backward(std::declval<ActionType>()) } -> same_as<void>;
+            { state.make_initial_node() } -> CostConcept;
+        };
+
+    template <typename Action, CostConcept Cost, template <typename> class State>
+    struct EdgeBeamSearchNoHash
+    {
+        // ビームサーチの設定
+        struct Config
+        {
+            int max_turn;
+            size_t beam_width;
+            // 最初に確保するEuler Tourの長さ。足りなくなったら倍々に増やすので目安でよい
+            size_t tour_capacity;
+            // 実行可能解が見つかったらすぐに返すかどうか
+            // ビーム内のターンと問題文のターンが同じレイヤーで、
+            // かつターン数最小化問題であればtrueにする。
+            // そうでなければfalse
+            bool return_finished_immediately;
+            // 制限時間(timer_library::timer の経過秒数)
+            // これを過ぎたターンを最終ターンとして扱う
+            double time_limit = numeric_limits<double>::infinity();
+            // 0以外を指定すると、ビームの末尾でコストが等しい候補のどちらを残すかをこの値をシードとした乱数で決める
+            // 並列に独立なビームサーチを行うときに、インスタンスごとに変えると探索が多様になる
+            uint64_t tie_break_seed = 0;
+            // 0以外を指定すると、同じ親から選ぶ子をこの個数までにする
+            // ビームが1つの系統に偏るのを防ぐ
+            size_t max_children_per_parent = 0;
+            // 0以外を指定すると、pushで同じgroupを指定した候補をこの個数までにする
+            // ハッシュでは区別できるが似ている盤面を、問題ごとの特徴量でまとめて制限する
+            size_t max_candidates_per_group = 0;
+            // ターンごとのビーム幅を返す関数。省略するとbeam_widthで一定になる
+            // 配列で指定したい場合は [&](int turn) { return widths[turn]; } のように渡す
+            // 返す値は1以上beam_width以下にする。メモリはbeam_widthの分だけ確保し、各ターンはその幅だけ使う
+            function<size_t(int)> beam_width_schedule = nullptr;
+            // 途中経過を保存するファイル
+            string checkpoint_path = "";
+            // 0以外を指定すると、beam_search で checkpoint_interval ターンごとに checkpoint_path に保存する
+            // checkpoint_interval, resume_from_checkpoint は THUNDER_CHECKPOINT を define したときだけ指定できる
+            // 保存には Euler Tour の長さに比例する時間がかかるので、1ターンの時間に比べて十分大きくする
+            int checkpoint_interval = 0;
+            // trueにすると、checkpoint_path があればそのターンから beam_search を再開する
+            // 保存したときと同じ入力、同じ設定(beam_widthなど)で実行する必要がある
+            // 制限時間(time_limit)は再開してからの経過時間で判定する
+            bool resume_from_checkpoint = false;
+            // 空でなければ、Euler Tourをメモリではなくこのディレクトリに作る一時ファイルに置く(例: "/tmp")
+            // 次のターンのEuler Tourを作る間は今のターンの分と合わせて2本が必要になり、
+            // ビーム幅がとても大きいとメモリの上限を超えることがある。ファイルに置くと、
+            // OSがページをディスクに書き出して手放せるので、メモリの使用量を抑えられる
+            // Euler Tourは先頭から順に読み書きするだけなので、ページキャッシュに収まらなくてもディスクの帯域で動く
+            // Actionは trivially copyable である必要がある
+            string tour_spill_dir = "";
+            // 0以外を指定すると、各ターンにビームに入らなかった候補のうちよいものをこの個数まで覚えておき、
+            // 実行可能解が見つかる前にビームが途絶えたとき(候補がなくなったとき)に、
+            // 覚えている中で最も深いターンの候補から探索をやり直す(beam stack search)
+            // Selectorはビーム幅がこの個数だけ広いのと同じだけ重くなり、覚える候補の根からのパスを毎ターン計算する
+            // beam_search だけで使う。覚えた候補はチェックポイントにも保存する
+            size_t backtrack_width = 0;
+            // backtrack_width を指定したときに0以外を指定すると、ビーム内の最もよいコストがこのターン数だけ
+            // 更新されなかったときも行き詰まったとみなして、今より浅いターンの候補から探索をやり直す
+            int backtrack_stall_turns = 0;
+            // 探索をやり直す回数の上限
+            int max_backtracks = numeric_limits<int>::max();
+
+            // turnターン目のビーム幅
+            // max_turn以降のターンはmax_turn - 1ターン目と同じ幅にする
+            size_t get_beam_width(int turn) const
+            {
+                if (!beam_width_schedule)
+                {
+                    return beam_width;
+                }
+                size_t width = beam_width_schedule(min(turn, max_turn - 1));
+                assert(1 <= width && width <= beam_width);
+                return width;
+            }
+        };
+
+        // 展開するノードの候補を表す構造体
+        struct Candidate
+        {
+            Action action;
+            Cost cost;
+            int parent;
+
+            Candidate(Action action, Cost cost, int parent) : action(action),
+                                                              cost(cost),
+                                                              parent(parent) {}
+        };
+
+        // 複数の初期状態から探索するときの、初期状態を表す構造体
+        // 渡された state を仮想的な根とし、action で各初期状態に移る
+        // 根の分だけ State の深さが1段増えるので、UndoLog(max_turn + 1) のように深さで容量を決めるものは1つ多く確保する
+        struct Root
+        {
+            Action action;
+            Cost cost;
+        };
+
+        // 複数のパスをまとめて返すときの型
+        using Paths = PathTrie<Action, Cost>;
+
+        // ビームに入らなかった候補を覚えておく型(backtrack_width 参照)
+        using Frontier = PrunedFrontier<Action, Cost>;
+
+        // 評価がよい順に最大k個のCandidateを返す
+        static vector<Candidate> select_top_k(const vector<Candidate> &candidates, size_t k)
+        {
+            vector<Candidate> ret = candidates;
+            k = min(k, ret.size());
+            partial_sort(ret.begin(), ret.begin() + k, ret.end(),
+                         [](const Candidate &a, const Candidate &b)
+                         { return a.cost < b.cost; });
+            ret.erase(ret.begin() + k, ret.end());
+            return ret;
+        }
+
+        // ノードの候補から実際に追加するものを選ぶクラス
+        // ビーム幅の個数だけ、評価がよいものを選ぶ
+        // ハッシュ値が一致したものについては、評価がよいほうのみを残す
+        class Selector
+        {
+        public:
+            // expand_batch で子を書き込むバッファの型
+            using Batch = ExpandBatchNoHash<Action, Cost>;
+
+            explicit Selector(const Config &config) : diversity_(config.max_children_per_parent, config.max_candidates_per_group,
+                                                                 config.beam_width + config.backtrack_width, config.beam_width * 16)
+            {
+                tie_break_state_ = config.tie_break_seed;
+                // backtrack_width を指定したときは、ビームに入らなかった候補もその個数だけ一緒に選ぶ
+                beam_width = config.beam_width + config.backtrack_width;
+                // Cost が整数型なら、segment treeの代わりに基数選択でビームを選ぶ(radix_shrink 参照)
+                // 多様性の制約を使うときは、入れ替える候補を1つずつ決めるのでsegment treeを使う
+                use_radix_ = is_integral_v<Cost> && !diversity_.enabled();
+                candidates_.reserve(use_radix_ ? 2 * beam_width : beam_width);
+                full_ = false;
+
+                costs_.resize(beam_width);
+                for (size_t i = 0; i < beam_width; ++i)
+                {
+                    costs_[i] = {0, i};
+                }
+            }
+
+            // 親の添字が num_parents 未満の候補を追加できるようにする(DiversityLimiter::reserve_parents 参照)
+            void reserve_parents(size_t num_parents)
+            {
+                diversity_.reserve_parents(num_parents);
+            }
+
+            // このターンのビーム幅を変える
+            // 候補を持っていないとき(構築直後かclearの後)に呼ぶ。幅は構築時のbeam_width以下にする
+            // segment treeはこの幅で構築するので、幅が狭いターンはその分だけ軽くなる
+            void set_beam_width(size_t width)
+            {
+                assert(candidates_.empty() && 1 <= width && width <= candidates_.capacity());
+                size_t old_width = costs_.size();
+                beam_width = width;
+                costs_.resize(width);
+                for (size_t i = old_width; i < width; ++i)
+                {
+                    costs_[i] = {0, i};
+                }
+            }
+
+            // 候補を追加する
+            // ターン数最小化型の問題で、candidateによって実行可能解が得られる場合にのみ finished = true とする
+            // ビーム幅分の候補をCandidateを追加したときにsegment treeを構築する
+            // max_candidates_per_group を指定したときは、groupに盤面の特徴を表すキーを渡す
+            void push(const Action &action, const Cost &cost, int parent, bool finished, uint64_t group = Diversity::NO_GROUP)
+            {
+                THUNDER_PROFILE_SCOPE("select");
+                if (finished)
+                {
+                    if (finished_candidates_.empty() || cost < finished_candidates_[best_finished_].cost)
+                    {
+                        best_finished_ = finished_candidates_.size();
+                    }
+                    finished_candidates_.emplace_back(action, cost, parent);
+                    return;
+                }
+                if constexpr (is_integral_v<Cost>)
+                {
+                    if (use_radix_)
+                    {
+                        // 一度絞った後は、境目のコストより大きい候補は入らない
+                        // 境目と等しい候補は、tie_break_seed を指定したときだけ入れておき、絞るときに乱数で選ぶ
+                        if (full_ && (cost > cutoff_ || (cost == cutoff_ && tie_break_state_ == 0)))
+                        {
+                            return;
+                        }
+                        push_radix(Candidate(action, cost, parent));
+                        return;
+                    }
+                }
+                if (full_ && cost >= st_.all_prod().first)
+                {
+                    // 保持しているどの候補よりもコストが小さくないとき
+                    // コストが等しいときは、tie_break_seed が指定されていれば乱数で入れ替えるか決める
+                    if (cost > st_.all_prod().first || !tie_break(cost))
+                    {
+                        return;
+                    }
+                }
+                if (diversity_.enabled())
+                {
+                    push_diverse(Candidate(action, cost, parent), group);
+                    return;
+                }
+                // 足切りされなかったものだけCandidateを作る
+                Candidate candidate(action, cost, parent);
+                if (full_)
+                {
+                    // segment treeが構築されている場合
+                    int j = st_.all_prod().second;
+                    candidates_[j] = candidate;
+                    update_best(j);
+                    st_.set(j, {cost, j});
+                }
+                else
+                {
+                    // segment treeが構築されていない場合
+                    int j = candidates_.size();
+                    candidates_.emplace_back(candidate);
+                    update_best(j);
+                    costs_[j].first = cost;
+
+                    if (candidates_.size() == beam_width)
+                    {
+                        // 保持している候補がビーム幅分になったときにsegment treeを構築する
+                        full_ = true;
+                        st_ = MaxSegtree(costs_);
+                    }
+                }
+            }
+
+            // 子をまとめて追加する
+            // 今のビームの最大コストより大きいものを先にまとめて除き、残ったものだけをpushする
+            // pushするたびに最大コストは小さくなるだけなので、先に除いても結果は変わらない
+            void push_batch(const Action *actions, const Cost *costs, const uint8_t *finished, size_t n, int parent)
+            {
+                survivors_.resize(n);
+                int *survivors = survivors_.data();
+                size_t num_survivors = n;
+                if (full_)
+                {
+                    num_survivors = filter_by_threshold(costs, finished, n, use_radix_ ? cutoff_ : st_.all_prod().first, survivors);
+                }
+                else
+                {
+                    iota(survivors, survivors + n, 0);
+                }
+
+                for (size_t k = 0; k < num_survivors; ++k)
+                {
+                    int i = survivors[k];
+                    push(actions[i], costs[i], parent, finished[i]);
+                }
+            }
+
+            // expand_batch で書き込まれた子をまとめて追加する
+            // 子のコストを配列のまま計算してから push_batch に渡す
+            void push_batch(Batch &batch, int parent, Cost parent_cost)
+            {
+                size_t n = batch.size();
+                batch.costs.resize(n);
+                Cost *costs = batch.costs.data();
+                const Cost *cost_deltas = batch.cost_deltas.data();
+                for (size_t i = 0; i < n; ++i)
+                {
+                    costs[i] = parent_cost + cost_deltas[i];
+                }
+                push_batch(batch.actions.data(), costs, batch.finished.data(), n, parent);
+            }
+
+            // 選んだ候補を返す
+            const vector<Candidate> &select() const
+            {
+                return candidates_;
+            }
+
+            // 実行可能解が見つかったか
+            bool have_finished() const
+            {
+                return !finished_candidates_.empty();
+            }
+
+            // 実行可能解に到達するCandidateを返す
+            const vector<Candidate> &get_finished_candidates() const
+            {
+                return finished_candidates_;
+            }
+
+            // 実行可能解に到達するCandidateのうち最も評価がよいものを返す
+            // pushのたびに更新しているのでO(1)
+            const Candidate &get_best_finished_candidate() const
+            {
+                assert(have_finished());
+                return finished_candidates_[best_finished_];
+            }
+
+            // 最もよいCandidateを返す
+            // pushのたびに更新しているのでO(1)
+            const Candidate &calculate_best_candidate() const
+            {
+                assert(best_ != -1);
+                return candidates_[best_];
+            }
+
+            // 候補を追加し終えたら呼び、選んだ候補をビーム幅の個数に絞る
+            // 基数選択を使うときは、ビーム幅の2倍まで候補を溜めてから絞っているので、最後にもう一度絞る
+            void shrink_to_beam()
+            {
+                if constexpr (is_integral_v<Cost>)
+                {
+                    if (use_radix_)
+                    {
+                        radix_shrink();
+                    }
+                }
+            }
+
+            void clear()
+            {
+                candidates_.clear();
+                best_ = -1;
+                radix_costs_.clear();
+                full_ = false;
+                tie_count_ = 0;
+                if (diversity_.enabled())
+                {
+                    diversity_.clear();
+                }
+            }
+
+            // 評価がよい順に最大k個のCandidateを返す
+            vector<Candidate> calculate_top_k_candidates(size_t k) const
+            {
+                return select_top_k(candidates_, k);
+            }
+
+            // 実行可能解に到達するCandidateを評価がよい順に最大k個返す
+            vector<Candidate> calculate_top_k_finished_candidates(size_t k) const
+            {
+                return select_top_k(finished_candidates_, k);
+            }
+
+            void clear_finished_candidates()
+            {
+                finished_candidates_.clear();
+            }
+
+            // 選んだ候補を、コストがよい width 個とそれ以外に分け、それ以外を返す
+            // select() はよい width 個だけを返すようになる
+            // backtrack_width を指定したときに、ビームに入らなかった候補を取り出すために使う
+            // segment treeは作り直さないので、呼んだ後は clear するまで push しない
+            const vector<Candidate> &split_pruned(size_t width)
+            {
+                pruned_.clear();
+                if (candidates_.size() <= width)
+                {
+                    return pruned_;
+                }
+                nth_element(candidates_.begin(), candidates_.begin() + width, candidates_.end(),
+                            [](const Candidate &a, const Candidate &b)
+                            { return a.cost < b.cost; });
+                pruned_.assign(candidates_.begin() + width, candidates_.end());
+                candidates_.erase(candidates_.begin() + width, candidates_.end());
+                // 並べ替えたので、最もよい候補の添字を求め直す
+                best_ = -1;
+                for (size_t j = 0; j < candidates_.size(); ++j)
+                {
+                    update_best(j);
+                }
+                return pruned_;
+            }
+
+#ifdef THUNDER_CHECKPOINT
+            // チェックポイントに保存する
+            // ターンの区切り(clear, clear_finished_candidates の後)に呼ぶので、候補は持っておらず、乱数の状態だけを保存すればよい
+            void save(CheckpointWriter &writer) const
+            {
+                assert(candidates_.empty() && finished_candidates_.empty());
+                writer.write(tie_break_state_);
+            }
+
+            // save で保存した状態を読み込む
+            void load(CheckpointReader &reader)
+            {
+                reader.read(tie_break_state_);
+            }
+#endif
+
+        private:
+            // 削除可能な優先度付きキュー
+            using MaxSegtree = atcoder::segtree<
+                pair<Cost, int>,
+                [](pair<Cost, int> a, pair<Cost, int> b)
+                {
+                    if (a.first >= b.first)
+                    {
+                        return a;
+                    }
+                    else
+                    {
+                        return b;
+                    }
+                },
+                []()
+                { return make_pair(numeric_limits<Cost>::min(), -1); }>;
+
+            size_t beam_width;
+            vector<Candidate> candidates_;
+            bool full_;
+            vector<pair<Cost, int>> costs_;
+            MaxSegtree st_;
+            uint64_t tie_break_state_;
+            // tie_break で数えている、最も悪い候補のコストとそのコストの候補の個数
+            Cost tie_cost_{};
+            size_t tie_count_ = 0;
+            // 基数選択でビームを選ぶか
+            bool use_radix_;
+            // 基数選択でビームを選ぶときに使う(radix_shrink 参照)
+            RadixSelect<Cost> radix_;
+            // 候補のコスト(candidates_ と同じ順番)
+            vector<Cost> radix_costs_;
+            // 一度絞った後の、残した候補の最大のコスト
+            Cost cutoff_;
+            // push_batch で残った子の添字
+            vector<int> survivors_;
+            // split_pruned で分けた、ビームに入らなかった候補
+            vector<Candidate> pruned_;
+            // 親ごと、グループごとの候補数の制限
+            using Diversity = DiversityLimiter<Cost>;
+            Diversity diversity_;
+
+            // 多様性の制約があるときのpush
+            // 同じ親や同じグループの候補が上限に達していたら、その中でコストが最大のものと入れ替える
+            void push_diverse(const Candidate &candidate, uint64_t group)
+            {
+                int victim = diversity_.find_victim(candidate.parent, group);
+                if (victim == -2 || (victim != -1 && candidate.cost >= candidates_[victim].cost))
+                {
+                    return;
+                }
+                if (victim == -1 && full_)
+                {
+                    victim = st_.all_prod().second;
+                }
+                if (victim != -1)
+                {
+                    replace_candidate(victim, candidate, group);
+                    return;
+                }
+                int j = candidates_.size();
+                candidates_.emplace_back(candidate);
+                update_best(j);
+                costs_[j].first = candidate.cost;
+                diversity_.add(j, candidate.cost, candidate.parent, group);
+                if (candidates_.size() == beam_width)
+                {
+                    full_ = true;
+                    st_ = MaxSegtree(costs_);
+                }
+            }
+
+            // j番目の候補を candidate に置き換える
+            void replace_candidate(int j, const Candidate &candidate, uint64_t group)
+            {
+                diversity_.remove(j);
+                candidates_[j] = candidate;
+                update_best(j);
+                if (full_)
+                {
+                    st_.set(j, {candidate.cost, j});
+                }
+                else
+                {
+                    costs_[j].first = candidate.cost;
+                }
+                diversity_.add(j, candidate.cost, candidate.parent, group);
+            }
+
+            // 基数選択を使うときのpush
+            // 候補をビーム幅の2倍まで溜め、溜まったらコストが小さい順にビーム幅の個数に絞る
+            // 絞るたびに境目のコストが下がるので、segment treeを使う場合と同じく悪い候補はすぐに捨てられる
+            void push_radix(const Candidate &candidate)
+            {
+                int j = candidates_.size();
+                candidates_.emplace_back(candidate);
+                radix_costs_.push_back(candidate.cost);
+                update_best(j);
+                if (candidates_.size() == 2 * beam_width)
+                {
+                    radix_shrink();
+                }
+            }
+
+            // 基数選択で、コストが小さい順にビーム幅の個数だけ候補を残す
+            // コストが等しい候補は先に追加したほうを残し、tie_break_seed を指定したときは乱数で選ぶ
+            // 残す候補を前に詰めるだけなので、候補は追加した順に並んだまま
+            void radix_shrink()
+            {
+                if (candidates_.size() <= beam_width)
+                {
+                    return;
+                }
+                auto [threshold, num_taken, num_ties] = radix_.select(radix_costs_.data(), candidates_.size(), beam_width);
+                size_t m = 0;
+                best_ = -1;
+                for (size_t i = 0; i < candidates_.size(); ++i)
+                {
+                    Cost cost = radix_costs_[i];
+                    if (cost > threshold)
+                    {
+                        continue;
+                    }
+                    if (cost == threshold)
+                    {
+                        // 残りの num_ties 個から num_taken 個を選ぶ
+                        bool take = tie_break_state_ == 0 ? num_taken > 0 : xorshift64(tie_break_state_) % num_ties < num_taken;
+                        --num_ties;
+                        if (!take)
+                        {
+                            continue;
+                        }
+                        --num_taken;
+                    }
+                    candidates_[m] = candidates_[i];
+                    radix_costs_[m] = cost;
+                    update_best(m);
+                    ++m;
+                }
+                candidates_.erase(candidates_.begin() + m, candidates_.end());
+                radix_costs_.resize(m);
+                cutoff_ = threshold;
+                full_ = true;
+            }
+
+            // 最も悪い候補とコストが等しい候補 cost で入れ替えるかどうかを返す
+            // そのコストの候補が来るのが n 個目なら、確率 1/n で入れ替える(reservoir sampling)
+            // 同じ枠を争った候補はどれも同じ確率で残るので、基数選択で境目の候補を乱数で選ぶのと揃う
+            // tie_break_seed が0なら常に入れ替えない
+            bool tie_break(const Cost &cost)
+            {
+                if (tie_break_state_ == 0)
+                {
+                    return false;
+                }
+                if (tie_count_ == 0 || cost != tie_cost_)
+                {
+                    // 最も悪い候補のコストは下がる一方なので、違うコストになったら数え直す
+                    // 枠を持っている候補を1個目とする
+                    tie_cost_ = cost;
+                    tie_count_ = 1;
+                }
+                ++tie_count_;
+                return xorshift64(tie_break_state_) % tie_count_ == 0;
+            }
+            vector<Candidate> finished_candidates_;
+            size_t best_finished_ = 0;
+            // 最もよい候補の添字(候補がなければ-1)
+            int best_ = -1;
+
+            // j番目の候補を書き換えた後に呼び、最もよい候補の添字を更新する
+            // 書き換えるのは同じ盤面でコストがよくなるときか、コストが最大の候補を追い出すときだけで、
+            // どの添字のコストも大きくならないので、最もよい候補を探し直す必要はない
+            // コストが等しいときは添字が小さいほうを選ぶ
+            void update_best(int j)
+            {
+                if (best_ == -1 || candidates_[j].cost < candidates_[best_].cost ||
+                    (candidates_[j].cost == candidates_[best_].cost && j < best_))
+                {
+                    best_ = j;
+                }
+            }
+        };
+
+        // 根からのパスを、direct_road_ の先頭部分の長さとそれより後ろのactionで表す
+        // 毎回direct_road_をコピーせずに済む
+        struct LazyPath
+        {
+            size_t direct_road_length = 0;
+            vector<Action> tail;
+        };
+
+        // Euler Tourを管理するためのクラス
+        class Tree
+        {
+        public:
+            explicit Tree(const State<Selector> &state, const Config &config) : state_(state)
+            {
+                curr_tour_.init(config.tour_capacity, config.tour_spill_dir);
+                next_tour_.init(config.tour_capacity, config.tour_spill_dir);
+                // 探索をやり直したときは、葉の数が backtrack_width 個になる
+                leaves_.reserve(max(config.beam_width, config.backtrack_width));
+                buckets_.assign(max(config.beam_width, config.backtrack_width), {});
+            }
+
+            // 状態を更新しながら深さ優先探索を行い、次のノードの候補を全てselectorに追加する
+            void dfs(Selector &selector)
+            {
+                THUNDER_PROFILE_SCOPE("dfs");
+                THUNDER_TRACE_SCOPE("dfs");
+                THUNDER_PERF_SCOPE("dfs");
+                if (curr_tour_.empty())
+                {
+                    // 最初のターン
+                    // commit_best_child で根の子の葉を確定したときは、その葉が新しい根になる
+                    Cost cost = root_leaf_ ? *root_leaf_ : state_.make_initial_node();
+                    expand(0, cost, selector);
                     return;
                 }
 
@@ -351,8 +3574,11 @@ namespace edge_beam_library
                     {
                         // 葉
                         state_.move_forward(action);
-                        auto &[cost, hash] = leaves_[leaf_index];
-                        state_.expand(leaf_index, selector);
+                        auto cost = leaves_[leaf_index];
+                        {
+                            THUNDER_PROFILE_SCOPE("expand");
+                            expand(leaf_index, cost, selector);
+                        }
                         state_.move_backward(action);
                     }
                     else if (leaf_index == -1)
@@ -371,6 +3597,9 @@ namespace edge_beam_library
             // 木を更新する
             void update(const vector<Candidate> &candidates)
             {
+                THUNDER_PROFILE_SCOPE("update");
+                THUNDER_TRACE_SCOPE("update");
+                THUNDER_PERF_SCOPE("update");
                 leaves_.clear();
 
                 if (curr_tour_.empty())
@@ -379,14 +3608,14 @@ namespace edge_beam_library
                     for (const Candidate &candidate : candidates)
                     {
                         curr_tour_.push_back({(int)leaves_.size(), candidate.action});
-                        leaves_.push_back({candidate.cost, candidate.hash});
+                        leaves_.push_back(candidate.cost);
                     }
                     return;
                 }
 
                 for (const Candidate &candidate : candidates)
                 {
-                    buckets_[candidate.parent].push_back({candidate.action, candidate.cost, candidate.hash});
+                    buckets_[candidate.parent].push_back({candidate.action, candidate.cost});
                 }
 
                 auto it = curr_tour_.begin();
@@ -412,11 +3641,11 @@ namespace edge_beam_library
                             continue;
                         }
                         next_tour_.push_back({-1, action});
-                        for (auto [new_action, cost, hash] : buckets_[leaf_index])
+                        for (auto [new_action, cost] : buckets_[leaf_index])
                         {
                             int new_leaf_index = leaves_.size();
                             next_tour_.push_back({new_leaf_index, new_action});
-                            leaves_.push_back({cost, hash});
+                            leaves_.push_back(cost);
                         }
                         buckets_[leaf_index].clear();
                         next_tour_.push_back({-2, action});
@@ -441,7 +3670,27 @@ namespace edge_beam_library
                     }
                 }
                 swap(curr_tour_, next_tour_);
+                curr_tour_.seal();
                 next_tour_.clear();
+                THUNDER_TRACE_COUNTER("tour_size", curr_tour_.size());
+                THUNDER_TRACE_COUNTER("leaves", leaves_.size());
+            }
+
+            // 仮想的な根の子として複数の初期状態を置き、それらを葉とする
+            // 構築直後に呼ぶ
+            void set_roots(const vector<Root> &roots)
+            {
+                assert(curr_tour_.empty());
+                if (buckets_.size() < roots.size())
+                {
+                    buckets_.resize(roots.size());
+                }
+                for (const Root &root : roots)
+                {
+                    curr_tour_.push_back({(int)leaves_.size(), root.action});
+                    leaves_.push_back(root.cost);
+                }
+                curr_tour_.seal();
             }
 
             // 根からのパスを取得する
@@ -451,6 +3700,11 @@ namespace edge_beam_library
 
                 vector<Action> ret = direct_road_;
                 ret.reserve(turn);
+                if (curr_tour_.empty())
+                {
+                    // 最初のターン
+                    return ret;
+                }
                 for (auto [leaf_index, action] : curr_tour_)
                 {
                     if (leaf_index >= 0)
@@ -475,492 +3729,726 @@ namespace edge_beam_library
                 return {};
             }
 
-        private:
-            State<Selector> state_;
-            vector<pair<int, Action>> curr_tour_;
-            vector<pair<int, Action>> next_tour_;
-            vector<pair<Cost, Hash>> leaves_;
-            vector<vector<tuple<Action, Cost, Hash>>> buckets_;
-            vector<Action> direct_road_;
-        };
-
-        // ビームサーチを行う関数
-        vector<Action> beam_search(const Config &config, const State<Selector> &state)
-        {
-            Tree tree(state, config);
-
-            // 新しいノード候補の集合
-            Selector selector(config);
-
-            // config.return_finished_immediately が false のときに、
-            // 実行可能解の中で一番よいものを覚えておくための変数
-            // ビームサーチ内で扱うturnと問題のturnが一致しないときに使う
-            Cost best_cost = numeric_limits<Cost>::max();
-            vector<Action> best_ret;
-            for (int turn = 0; turn < config.max_turn; ++turn)
+            // 根からのパスを後から復元できる形で取得する
+            // direct_road_ は末尾に追加されるだけなので、その長さだけを覚えておけばよい
+            LazyPath calculate_lazy_path(int parent) const
             {
-                // Euler Tourでselectorに候補を追加する
-                tree.dfs(selector);
-
-                if (selector.have_finished())
+                LazyPath ret;
+                ret.direct_road_length = direct_road_.size();
+                if (curr_tour_.empty())
                 {
-                    // ターン数最小化型の問題で実行可能解が見つかったとき
-                    if (config.return_finished_immediately)
+                    // 最初のターン
+                    return ret;
+                }
+                for (auto [leaf_index, action] : curr_tour_)
+                {
+                    if (leaf_index >= 0)
                     {
-                        Candidate candidate = selector.get_finished_candidates()[0];
-                        vector<Action> ret = tree.calculate_path(candidate.parent, turn + 1);
-                        ret.push_back(candidate.action);
-                        return ret;
+                        if (leaf_index == parent)
+                        {
+                            ret.tail.push_back(action);
+                            return ret;
+                        }
+                    }
+                    else if (leaf_index == -1)
+                    {
+                        ret.tail.push_back(action);
                     }
                     else
                     {
-                        for (auto candidate : selector.get_finished_candidates())
-                        {
-                            vector<Action> ret = tree.calculate_path(candidate.parent, turn + 1);
-                            ret.push_back(candidate.action);
-                            if (candidate.cost < best_cost)
-                            {
-                                best_cost = candidate.cost;
-                                best_ret = ret;
-                            }
-                        }
+                        ret.tail.pop_back();
                     }
-                    selector.clear_finished_candidates();
                 }
-                if (selector.select().empty())
-                {
-                    return best_ret;
-                }
-                assert(!selector.select().empty());
-
-                if (turn == config.max_turn - 1)
-                {
-                    assert(selector.select().empty());
-                    // ターン数固定型の問題で全ターンが終了したとき
-                    Candidate best_candidate = selector.calculate_best_candidate();
-                    vector<Action> ret = tree.calculate_path(best_candidate.parent, turn + 1);
-                    ret.push_back(best_candidate.action);
-                    return ret;
-                }
-
-                // 木を更新する
-                tree.update(selector.select());
 
-                selector.clear();
+                assert(false);
+                return {};
             }
 
-            assert(false);
-            return {};
-        }
-
-        // StateConcept のチェックを構造体内で実施
-        static_assert(StateConcept<State<Selector>, Hash, Cost, Action, Selector>,
-                      "State template must satisfy StateConcept with BeamSearch::Selector");
-
-    }; // EdgeBeamSearch
-
-    template <typename StateType, typename CostType, typename ActionType, typename SelectorType>
-    concept StateConceptNoHash =
-        CostConcept<CostType> &&
-        requires(StateType state, SelectorType selector) {
-            { state.expand(std::declval<int>(), selector) } -> same_as<void>;
-            { state.move_forward(std::declval<ActionType>()) } -> same_as<void>;
-            { state.move_backward(std::declval<ActionType>()) } -> same_as<void>;
-            { state.make_initial_node() } -> CostConcept;
-        };
-
-    template <typename Action, CostConcept Cost, template <typename> class State>
-    struct EdgeBeamSearchNoHash
-    {
-        // ビームサーチの設定
-        struct Config
-        {
-            int max_turn;
-            size_t beam_width;
-            size_t tour_capacity;
-            // 実行可能解が見つかったらすぐに返すかどうか
-            // ビーム内のターンと問題文のターンが同じレイヤーで、
-            // かつターン数最小化問題であればtrueにする。
-            // そうでなければfalse
-            bool return_finished_immediately;
-        };
-
-        // 展開するノードの候補を表す構造体
-        struct Candidate
-        {
-            Action action;
-            Cost cost;
-            int parent;
-
-            Candidate(Action action, Cost cost, int parent) : action(action),
-                                                              cost(cost),
-                                                              parent(parent) {}
-        };
-
-        // ノードの候補から実際に追加するものを選ぶクラス
-        // ビーム幅の個数だけ、評価がよいものを選ぶ
-        // ハッシュ値が一致したものについては、評価がよいほうのみを残す
-        class Selector
-        {
-        public:
-            explicit Selector(const Config &config)
+            // calculate_lazy_path で取得したパスを復元する
+            vector<Action> restore_path(const LazyPath &path) const
             {
-                beam_width = config.beam_width;
-                candidates_.reserve(beam_width);
-                full_ = false;
-
-                costs_.resize(beam_width);
-                for (size_t i = 0; i < beam_width; ++i)
-                {
-                    costs_[i] = {0, i};
-                }
+                vector<Action> ret(direct_road_.begin(), direct_road_.begin() + path.direct_road_length);
+                ret.insert(ret.end(), path.tail.begin(), path.tail.end());
+                return ret;
             }
 
-            // 候補を追加する
-            // ターン数最小化型の問題で、candidateによって実行可能解が得られる場合にのみ finished = true とする
-            // ビーム幅分の候補をCandidateを追加したときにsegment treeを構築する
-            void push(const Action &action, const Cost &cost, int parent, bool finished)
+            // 各候補の根からのパスを、Euler Tourを1回走査するだけでまとめて取得する
+            // 共通の接頭辞はトライ木のノードを共有する
+            // 戻り値のk番目のパスはcandidates[k]に対応する
+            Paths calculate_paths(const vector<Candidate> &candidates) const
             {
-                Candidate candidate(action, cost, parent);
-                if (finished)
-                {
-                    finished_candidates_.emplace_back(candidate);
-                    return;
-                }
-                if (full_ && cost >= st_.all_prod().first)
+                Paths paths;
+                paths.ends.assign(candidates.size(), -1);
+                for (const Candidate &candidate : candidates)
                 {
-                    // 保持しているどの候補よりもコストが小さくないとき
-                    return;
+                    paths.costs.push_back(candidate.cost);
                 }
-                if (full_)
+
+                int base = -1;
+                for (const Action &action : direct_road_)
                 {
-                    // segment treeが構築されている場合
-                    int j = st_.all_prod().second;
-                    candidates_[j] = candidate;
-                    st_.set(j, {cost, j});
+                    base = paths.add_node(base, action);
                 }
-                else
-                {
-                    // segment treeが構築されていない場合
-                    int j = candidates_.size();
-                    candidates_.emplace_back(candidate);
-                    costs_[j].first = cost;
 
-                    if (candidates_.size() == beam_width)
+                if (curr_tour_.empty())
+                {
+                    // 最初のターン
+                    for (size_t k = 0; k < candidates.size(); ++k)
                     {
-                        // 保持している候補がビーム幅分になったときにsegment treeを構築する
-                        full_ = true;
-                        st_ = MaxSegtree(costs_);
+                        paths.ends[k] = paths.add_node(base, candidates[k].action);
                     }
+                    return paths;
                 }
-            }
-
-            // 選んだ候補を返す
-            const vector<Candidate> &select() const
-            {
-                return candidates_;
-            }
-
-            // 実行可能解が見つかったか
-            bool have_finished() const
-            {
-                return !finished_candidates_.empty();
-            }
 
-            // 実行可能解に到達するCandidateを返す
-            vector<Candidate> get_finished_candidates() const
-            {
-                return finished_candidates_;
-            }
+                // 葉のインデックスはEuler Tour上で昇順に並んでいるので、
+                // 親の昇順に候補を並べておけば1回の走査で済む
+                vector<int> order(candidates.size());
+                iota(order.begin(), order.end(), 0);
+                sort(order.begin(), order.end(), [&](int a, int b)
+                     { return candidates[a].parent < candidates[b].parent; });
+                size_t next = 0;
 
-            // 最もよいCandidateを返す
-            Candidate calculate_best_candidate() const
-            {
-                if (full_)
+                // 根から今いる位置までの辺と、対応するトライ木のノード(未作成なら-1)
+                vector<pair<Action, int>> road;
+                road.reserve(direct_road_.size() + curr_tour_.size());
+                // road のうち先頭 created 個はトライ木のノードが作成済み
+                size_t created = 0;
+                for (auto [leaf_index, action] : curr_tour_)
                 {
-                    size_t best = 0;
-                    for (size_t i = 0; i < beam_width; ++i)
+                    if (next == order.size())
                     {
-                        if (st_.get(i).first < st_.get(best).first)
-                        {
-                            best = i;
-                        }
+                        break;
                     }
-                    return candidates_[best];
-                }
-                else
-                {
-                    size_t best = 0;
-                    for (size_t i = 0; i < candidates_.size(); ++i)
+                    if (leaf_index >= 0)
                     {
-                        if (costs_[i].first < costs_[best].first)
+                        if (leaf_index != candidates[order[next]].parent)
+                        {
+                            continue;
+                        }
+                        for (; created < road.size(); ++created)
+                        {
+                            int parent = created == 0 ? base : road[created - 1].second;
+                            road[created].second = paths.add_node(parent, road[created].first);
+                        }
+                        int parent = road.empty() ? base : road.back().second;
+                        int leaf = paths.add_node(parent, action);
+                        while (next < order.size() && candidates[order[next]].parent == leaf_index)
                         {
-                            best = i;
+                            int k = order[next++];
+                            paths.ends[k] = paths.add_node(leaf, candidates[k].action);
                         }
                     }
-                    return candidates_[best];
-                }
-            }
-
-            void clear()
-            {
-                candidates_.clear();
-                full_ = false;
-            }
-
-            void clear_finished_candidates()
-            {
-                finished_candidates_.clear();
-            }
-
-        private:
-            // 削除可能な優先度付きキュー
-            using MaxSegtree = atcoder::segtree<
-                pair<Cost, int>,
-                [](pair<Cost, int> a, pair<Cost, int> b)
-                {
-                    if (a.first >= b.first)
+                    else if (leaf_index == -1)
                     {
-                        return a;
+                        road.push_back({action, -1});
                     }
                     else
                     {
-                        return b;
-                    }
-                },
-                []()
-                { return make_pair(numeric_limits<Cost>::min(), -1); }>;
-
-            size_t beam_width;
-            vector<Candidate> candidates_;
-            bool full_;
-            vector<pair<Cost, int>> costs_;
-            MaxSegtree st_;
-            vector<Candidate> finished_candidates_;
-        };
+                        road.pop_back();
+                        created = min(created, road.size());
+                    }
+                }
 
-        // Euler Tourを管理するためのクラス
-        class Tree
-        {
-        public:
-            explicit Tree(const State<Selector> &state, const Config &config) : state_(state)
-            {
-                curr_tour_.reserve(config.tour_capacity);
-                next_tour_.reserve(config.tour_capacity);
-                leaves_.reserve(config.beam_width);
-                buckets_.assign(config.beam_width, {});
+                assert(next == order.size());
+                return paths;
             }
 
-            // 状態を更新しながら深さ優先探索を行い、次のノードの候補を全てselectorに追加する
-            void dfs(Selector &selector)
+            // 探索木を捨て、layer のパスの終点を葉とする木から探索をやり直す
+            // layer のパスは根から始まり、全て同じ長さとする
+            void restart(const typename Frontier::Layer &layer)
             {
-                if (curr_tour_.empty())
+                THUNDER_PROFILE_SCOPE("restart");
+                // state_ は一本道の終点にいるので、根まで戻す
+                for (auto it = direct_road_.rbegin(); it != direct_road_.rend(); ++it)
                 {
-                    // 最初のターン
-                    auto cost = state_.make_initial_node();
-                    state_.expand(0, selector);
-                    return;
+                    state_.move_backward(*it);
                 }
+                direct_road_.clear();
+                committed_ = 0;
+                root_leaf_.reset();
+                leaves_.clear();
+                curr_tour_.clear();
 
-                for (auto [leaf_index, action] : curr_tour_)
+                // トライ木の子を列挙できるようにする
+                // 子はインデックスの降順につなぐので、順にstackに積むと昇順に取り出せる
+                size_t n = layer.nodes.size();
+                vector<int> child(n, -1), right(n, -1), end_index(n, -1);
+                int roots = -1;
+                for (size_t v = 0; v < n; ++v)
                 {
-                    if (leaf_index >= 0)
+                    int parent = layer.nodes[v].first;
+                    int &head = parent == -1 ? roots : child[parent];
+                    right[v] = head;
+                    head = v;
+                }
+                for (size_t k = 0; k < layer.size(); ++k)
+                {
+                    end_index[layer.ends[k]] = k;
+                }
+
+                // トライ木を深さ優先で走査してEuler Tourを作る
+                // stack の要素は {ノード, 後退辺か}
+                vector<pair<int, bool>> stack;
+                for (int v = roots; v != -1; v = right[v])
+                {
+                    stack.push_back({v, false});
+                }
+                while (!stack.empty())
+                {
+                    auto [v, backward] = stack.back();
+                    stack.pop_back();
+                    const Action &action = layer.nodes[v].second;
+                    if (backward)
                     {
-                        // 葉
-                        state_.move_forward(action);
-                        auto cost = leaves_[leaf_index];
-                        state_.expand(leaf_index, selector);
-                        state_.move_backward(action);
+                        curr_tour_.push_back({-2, action});
                     }
-                    else if (leaf_index == -1)
+                    else if (end_index[v] != -1)
                     {
-                        // 前進辺
-                        state_.move_forward(action);
+                        curr_tour_.push_back({(int)leaves_.size(), action});
+                        leaves_.push_back(layer.costs[end_index[v]]);
                     }
                     else
                     {
-                        // 後退辺
-                        state_.move_backward(action);
+                        curr_tour_.push_back({-1, action});
+                        stack.push_back({v, true});
+                        for (int c = child[v]; c != -1; c = right[c])
+                        {
+                            stack.push_back({c, false});
+                        }
                     }
                 }
+                curr_tour_.seal();
             }
 
-            // 木を更新する
-            void update(const vector<Candidate> &candidates)
+#ifdef THUNDER_CHECKPOINT
+            // チェックポイントに保存する
+            // Euler Tour と葉は配列のまま書き出すので、読み込みはコピー1回で済む
+            void save(CheckpointWriter &writer) const
             {
-                leaves_.clear();
+                writer.write_array(curr_tour_.data(), curr_tour_.size());
+                writer.write_vector(leaves_);
+                writer.write_vector(direct_road_);
+                writer.write(committed_);
+                if constexpr (CheckpointableState<State<Selector>>)
+                {
+                    state_.save(writer);
+                }
+            }
 
-                if (curr_tour_.empty())
+            // save で保存した状態を読み込む
+            // 構築直後(state_ が初期状態)に呼ぶ
+            // State が save, load を実装していなければ、初期状態から direct_road_ をたどって復元する
+            void load(CheckpointReader &reader)
+            {
+                span<const pair<int, Action>> tour = reader.view_vector<pair<int, Action>>();
+                curr_tour_.assign(tour.data(), tour.size());
+                reader.read_vector(leaves_);
+                reader.read_vector(direct_road_);
+                reader.read(committed_);
+                if constexpr (CheckpointableState<State<Selector>>)
                 {
-                    // 最初のターン
-                    for (const Candidate &candidate : candidates)
+                    state_.load(reader);
+                }
+                else
+                {
+                    for (const Action &action : direct_road_)
                     {
-                        curr_tour_.push_back({(int)leaves_.size(), candidate.action});
-                        leaves_.push_back(candidate.cost);
+                        state_.move_forward(action);
                     }
-                    return;
                 }
+            }
+#endif
 
-                for (const Candidate &candidate : candidates)
+            // 確定済みのactionの個数
+            size_t get_committed_size() const
+            {
+                return committed_;
+            }
+
+            // commit_best_child で確定できるactionがあるか
+            // 探索する前(葉がまだないとき)は、direct_road_ に未確定のactionが残っていなければ確定できない
+            bool can_commit() const
+            {
+                return committed_ < direct_road_.size() || !leaves_.empty();
+            }
+
+            // 根から最もよい葉に向かう最初のactionを確定して返す
+            // can_commit() が true のときに呼ぶ
+            // direct_road_ に未確定のactionが残っていればそれを確定するだけでよい
+            // そうでなければ、確定しなかった根の子の部分木をEuler Tourから取り除き、
+            // 残った部分木の葉をそのまま次の探索に使う
+            Action commit_best_child()
+            {
+                THUNDER_PROFILE_SCOPE("commit");
+                THUNDER_TRACE_SCOPE("commit");
+                THUNDER_PERF_SCOPE("commit");
+                if (committed_ < direct_road_.size())
                 {
-                    buckets_[candidate.parent].push_back({candidate.action, candidate.cost});
+                    return direct_road_[committed_++];
                 }
+                assert(!leaves_.empty());
 
-                auto it = curr_tour_.begin();
-
-                // 一本道を反復しないようにする
-                while (it->first == -1 && it->second == curr_tour_.back().second)
+                int best_leaf = 0;
+                for (size_t i = 0; i < leaves_.size(); ++i)
                 {
-                    Action action = (it++)->second;
-                    state_.move_forward(action);
-                    direct_road_.push_back(action);
-                    curr_tour_.pop_back();
+                    if (leaves_[i] < leaves_[best_leaf])
+                    {
+                        best_leaf = i;
+                    }
                 }
 
-                // 葉の追加や不要な辺の削除をする
-                while (it != curr_tour_.end())
+                // best_leaf を含む根の子の部分木 [begin, end] を探す
+                size_t begin = 0;
+                size_t end = 0;
+                int depth = 0;
+                bool found = false;
+                for (size_t i = 0; i < curr_tour_.size(); ++i)
                 {
-                    auto [leaf_index, action] = *(it++);
+                    auto [leaf_index, action] = curr_tour_[i];
+                    if (depth == 0)
+                    {
+                        begin = i;
+                    }
                     if (leaf_index >= 0)
                     {
-                        // 葉
-                        if (buckets_[leaf_index].empty())
-                        {
-                            continue;
-                        }
-                        next_tour_.push_back({-1, action});
-                        for (auto [new_action, cost] : buckets_[leaf_index])
-                        {
-                            int new_leaf_index = leaves_.size();
-                            next_tour_.push_back({new_leaf_index, new_action});
-                            leaves_.push_back(cost);
-                        }
-                        buckets_[leaf_index].clear();
-                        next_tour_.push_back({-2, action});
+                        found |= leaf_index == best_leaf;
                     }
                     else if (leaf_index == -1)
                     {
-                        // 前進辺
-                        next_tour_.push_back({-1, action});
+                        ++depth;
                     }
                     else
                     {
-                        // 後退辺
-                        auto [old_leaf_index, old_action] = next_tour_.back();
-                        if (old_leaf_index == -1)
-                        {
-                            next_tour_.pop_back();
-                        }
-                        else
-                        {
-                            next_tour_.push_back({-2, action});
-                        }
+                        --depth;
+                    }
+                    if (depth == 0 && found)
+                    {
+                        end = i;
+                        break;
                     }
                 }
-                swap(curr_tour_, next_tour_);
-                next_tour_.clear();
-            }
+                assert(found);
 
-            // 根からのパスを取得する
-            vector<Action> calculate_path(int parent, int turn) const
-            {
-                // cerr << curr_tour_.size() << endl;
+                Action action = curr_tour_[begin].second;
+                state_.move_forward(action);
+                direct_road_.push_back(action);
+                ++committed_;
 
-                vector<Action> ret = direct_road_;
-                ret.reserve(turn);
-                for (auto [leaf_index, action] : curr_tour_)
+                // 部分木の内側だけを残し、葉のインデックスをEuler Tour上の順に振り直す
+                vector<Cost> old_leaves;
+                swap(old_leaves, leaves_);
+                if (begin == end)
+                {
+                    // 根の子の葉を確定したので、部分木の内側は空になる
+                    // 次の dfs ではその葉のコストから展開する
+                    root_leaf_ = old_leaves[best_leaf];
+                }
+                for (size_t i = begin + 1; i < end; ++i)
                 {
+                    auto [leaf_index, old_action] = curr_tour_[i];
                     if (leaf_index >= 0)
                     {
-                        if (leaf_index == parent)
-                        {
-                            ret.push_back(action);
-                            return ret;
-                        }
-                    }
-                    else if (leaf_index == -1)
-                    {
-                        ret.push_back(action);
+                        next_tour_.push_back({(int)leaves_.size(), old_action});
+                        leaves_.push_back(old_leaves[leaf_index]);
                     }
                     else
                     {
-                        ret.pop_back();
+                        next_tour_.push_back({leaf_index, old_action});
                     }
                 }
-
-                assert(false);
-                return {};
+                swap(curr_tour_, next_tour_);
+                curr_tour_.seal();
+                next_tour_.clear();
+                return action;
             }
 
         private:
             State<Selector> state_;
-            vector<pair<int, Action>> curr_tour_;
-            vector<pair<int, Action>> next_tour_;
+            TourBuffer<pair<int, Action>> curr_tour_;
+            TourBuffer<pair<int, Action>> next_tour_;
             vector<Cost> leaves_;
             vector<vector<tuple<Action, Cost>>> buckets_;
             vector<Action> direct_road_;
+            // direct_road_ のうち、先頭から何個のactionを確定したか
+            size_t committed_ = 0;
+            // Euler Tour が空のときに展開する根の値(commit_best_child で根の子の葉を確定したとき)
+            // 持っていなければ make_initial_node を使う
+            optional<Cost> root_leaf_;
+            // expand_batch で使い回すバッファ
+            typename Selector::Batch batch_;
+
+            // 今のノードの子をselectorに追加する
+            void expand(int parent, Cost cost, Selector &selector)
+            {
+                if constexpr (BatchExpandConcept<State<Selector>, typename Selector::Batch>)
+                {
+                    batch_.clear();
+                    state_.expand_batch(parent, batch_);
+                    selector.push_batch(batch_, parent, cost);
+                }
+                else
+                {
+                    state_.expand(parent, selector);
+                }
+            }
+        };
+
+        // ローリングホライズン(オンライン)で探索するためのクラス
+        // step(turns) で探索をturnsターン深くしてから、根から最もよい葉に向かう最初のactionを確定して返す
+        // 確定しなかった根の子の部分木は捨て、残った部分木は次のstepでそのまま使うので、
+        // 毎回最初から探索し直す場合と違い、ビーム幅分の葉を作り直さずに済む
+        // 初回はビームの深さ分、2回目以降は1ターンずつ深くするのが基本的な使い方
+        class RollingSearch
+        {
+        public:
+            explicit RollingSearch(const Config &config, const State<Selector> &state) : config_(config),
+                                                                                          tree_(state, config),
+                                                                                          selector_(config) {}
+
+            // 探索をturnsターン深くしてから、actionを1つ確定して返す
+            // 実行可能解が見つかった後は、そのパスに沿ってactionを返す
+            // 返すactionがないとき(ビームが途絶えたとき、実行可能解のパスを返し終えたとき、
+            // 葉がないのに turns が0のとき)はnulloptを返す
+            optional<Action> step(int turns)
+            {
+                if (!finished_path_.empty())
+                {
+                    if (finished_path_index_ == finished_path_.size())
+                    {
+                        return nullopt;
+                    }
+                    return finished_path_[finished_path_index_++];
+                }
+
+                for (int turn = 0; turn < turns; ++turn, ++turn_)
+                {
+                    // Euler Tourでselectorに候補を追加する
+                    selector_.set_beam_width(config_.get_beam_width(turn_));
+                    tree_.dfs(selector_);
+                    selector_.shrink_to_beam();
+
+                    if (selector_.have_finished())
+                    {
+                        // 実行可能解が見つかったら、以降はそのパスをたどる
+                        const Candidate &candidate = selector_.get_best_finished_candidate();
+                        finished_path_ = tree_.calculate_path(candidate.parent, 0);
+                        finished_path_.push_back(candidate.action);
+                        finished_path_index_ = tree_.get_committed_size();
+                        selector_.clear_finished_candidates();
+                        selector_.clear();
+                        return step(0);
+                    }
+                    if (selector_.select().empty())
+                    {
+                        return nullopt;
+                    }
+
+                    // 木を更新する
+                    tree_.update(selector_.select());
+                    THUNDER_PERF_TURN_END();
+
+                    selector_.clear();
+                }
+                if (!tree_.can_commit())
+                {
+                    return nullopt;
+                }
+                return tree_.commit_best_child();
+            }
+
+        private:
+            Config config_;
+            Tree tree_;
+            Selector selector_;
+            // 根から何ターン探索したか
+            int turn_ = 0;
+            vector<Action> finished_path_;
+            size_t finished_path_index_ = 0;
         };
 
+#ifdef THUNDER_CHECKPOINT
+        // beam_search の途中経過を config.checkpoint_path に保存する
+        // next_turn は再開したときに最初に探索するターン
+        void save_checkpoint(const Config &config, int next_turn, Cost best_cost, const LazyPath &best_path,
+                             const Frontier &frontier, int backtracks, Cost stall_best_cost, int stall_turns,
+                             const Tree &tree, const Selector &selector) const
+        {
+            THUNDER_PROFILE_SCOPE("checkpoint");
+            CheckpointWriter writer(config.checkpoint_path);
+            // 読み込むときに設定や型が変わっていないかを確認するための値
+            writer.write(sizeof(Action));
+            writer.write(sizeof(Cost));
+            writer.write(config.beam_width);
+            writer.write(config.max_turn);
+            writer.write(config.backtrack_width);
+
+            writer.write(next_turn);
+            writer.write(best_cost);
+            writer.write(best_path.direct_road_length);
+            writer.write_vector(best_path.tail);
+            frontier.save(writer);
+            writer.write(backtracks);
+            writer.write(stall_best_cost);
+            writer.write(stall_turns);
+            tree.save(writer);
+            selector.save(writer);
+            writer.commit();
+        }
+
+        // save_checkpoint で保存した途中経過を読み込み、再開するターンを返す
+        int load_checkpoint(const Config &config, Cost &best_cost, LazyPath &best_path,
+                            Frontier &frontier, int &backtracks, Cost &stall_best_cost, int &stall_turns,
+                            Tree &tree, Selector &selector) const
+        {
+            THUNDER_PROFILE_SCOPE("checkpoint");
+            CheckpointReader reader(config.checkpoint_path);
+            reader.expect(sizeof(Action), "sizeof(Action)");
+            reader.expect(sizeof(Cost), "sizeof(Cost)");
+            reader.expect(config.beam_width, "beam_width");
+            reader.expect(config.max_turn, "max_turn");
+            reader.expect(config.backtrack_width, "backtrack_width");
+
+            int next_turn = reader.read<int>();
+            reader.read(best_cost);
+            reader.read(best_path.direct_road_length);
+            reader.read_vector(best_path.tail);
+            frontier.load(reader);
+            reader.read(backtracks);
+            reader.read(stall_best_cost);
+            reader.read(stall_turns);
+            tree.load(reader);
+            selector.load(reader);
+            return next_turn;
+        }
+#endif
+
         // ビームサーチを行う関数
-        vector<Action> beam_search(const Config &config, const State<Selector> &state)
+        // roots を渡すと、state を仮想的な根としてその子の複数の初期状態から同時に探索する
+        // 初期状態どうしも1つのSelectorで競わせるので、初期状態ごとに探索する場合と違い、Euler Tourなどは1組で済む
+        // このとき返すパスの先頭は、どの初期状態から始めたかを表す roots[k].action になる
+        vector<Action> beam_search(const Config &config, const State<Selector> &state, const vector<Root> &roots = {})
         {
             Tree tree(state, config);
+            if (!roots.empty())
+            {
+                tree.set_roots(roots);
+            }
 
             // 新しいノード候補の集合
             Selector selector(config);
+            selector.reserve_parents(roots.size());
 
             // config.return_finished_immediately が false のときに、
             // 実行可能解の中で一番よいものを覚えておくための変数
             // ビームサーチ内で扱うturnと問題のturnが一致しないときに使う
             Cost best_cost = numeric_limits<Cost>::max();
-            vector<Action> best_ret;
-            for (int turn = 0; turn < config.max_turn; ++turn)
+            LazyPath best_path;
+
+            // backtrack_width を指定したときに、ビームに入らなかった候補を覚えておく
+            Frontier frontier(config.backtrack_width);
+            int backtracks = 0;
+            // backtrack_stall_turns を指定したときに、ビーム内の最もよいコストが更新されなかったターン数を数える
+            Cost stall_best_cost = numeric_limits<Cost>::max();
+            int stall_turns = 0;
+
+            int start_turn = 0;
+#ifdef THUNDER_CHECKPOINT
+            if (config.resume_from_checkpoint && CheckpointReader::exists(config.checkpoint_path))
+            {
+                start_turn = load_checkpoint(config, best_cost, best_path, frontier, backtracks, stall_best_cost, stall_turns,
+                                             tree, selector);
+            }
+#else
+            if (config.checkpoint_interval > 0 || config.resume_from_checkpoint)
+            {
+                cerr << "ERROR: checkpoint_interval and resume_from_checkpoint require THUNDER_CHECKPOINT" << endl;
+                exit(-1);
+            }
+#endif
+            for (int turn = start_turn; turn < config.max_turn; ++turn)
             {
                 // Euler Tourでselectorに候補を追加する
+                // ビームに入らなかった候補も覚えるときは、その分だけ広く選んでおいて後で分ける
+                selector.set_beam_width(config.get_beam_width(turn) + config.backtrack_width);
                 tree.dfs(selector);
+                selector.shrink_to_beam();
 
                 if (selector.have_finished())
                 {
                     // ターン数最小化型の問題で実行可能解が見つかったとき
                     if (config.return_finished_immediately)
                     {
-                        Candidate candidate = selector.get_finished_candidates()[0];
+                        const Candidate &candidate = selector.get_best_finished_candidate();
                         vector<Action> ret = tree.calculate_path(candidate.parent, turn + 1);
                         ret.push_back(candidate.action);
                         return ret;
                     }
                     else
                     {
-                        for (auto candidate : selector.get_finished_candidates())
+                        // 最もよいものだけを見て、更新するときだけパスを計算する
+                        const Candidate &candidate = selector.get_best_finished_candidate();
+                        if (candidate.cost < best_cost)
                         {
-                            vector<Action> ret = tree.calculate_path(candidate.parent, turn + 1);
-                            ret.push_back(candidate.action);
-                            if (candidate.cost < best_cost)
-                            {
-                                best_cost = candidate.cost;
-                                best_ret = ret;
-                            }
+                            best_cost = candidate.cost;
+                            best_path = tree.calculate_lazy_path(candidate.parent);
+                            best_path.tail.push_back(candidate.action);
                         }
                     }
                     selector.clear_finished_candidates();
                 }
+                if (frontier.enabled() && best_path.tail.empty() && backtracks < config.max_backtracks &&
+                    timer_library::timer.getTime() <= config.time_limit)
+                {
+                    // 実行可能解が見つかる前にビームが途絶えたか、行き詰まったときは、覚えている候補からやり直す
+                    bool dead = selector.select().empty();
+                    bool stalled = false;
+                    if (!dead && config.backtrack_stall_turns > 0)
+                    {
+                        Cost cost = selector.calculate_best_candidate().cost;
+                        if (cost < stall_best_cost)
+                        {
+                            stall_best_cost = cost;
+                            stall_turns = 0;
+                        }
+                        else
+                        {
+                            stalled = ++stall_turns >= config.backtrack_stall_turns;
+                        }
+                    }
+                    if (dead || stalled)
+                    {
+                        // 途絶えたときはこのターン以前、行き詰まったときは今より浅いターンの候補を使う
+                        typename Frontier::Layer layer;
+                        int restart_turn = frontier.pop(dead ? turn : turn - 1, layer);
+                        if (restart_turn != -1)
+                        {
+                            tree.restart(layer);
+                            selector.clear();
+                            ++backtracks;
+                            stall_best_cost = numeric_limits<Cost>::max();
+                            stall_turns = 0;
+                            // restart_turn ターン目の候補が葉になったので、次は restart_turn + 1 ターン目を探索する
+                            turn = restart_turn;
+                            continue;
+                        }
+                    }
+                }
                 if (selector.select().empty())
                 {
-                    return best_ret;
+                    if (best_path.tail.empty())
+                    {
+                        // 実行可能解が見つからなかったとき
+                        return {};
+                    }
+                    return tree.restore_path(best_path);
                 }
                 assert(!selector.select().empty());
 
-                if (turn == config.max_turn - 1)
+                if (turn == config.max_turn - 1 || timer_library::timer.getTime() > config.time_limit)
                 {
-                    // ターン数固定型の問題で全ターンが終了したとき
+                    // ターン数固定型の問題で全ターンが終了したとき、または制限時間を過ぎたとき
+                    if (!best_path.tail.empty())
+                    {
+                        // 制限時間を過ぎる前に実行可能解が見つかっていたとき
+                        return tree.restore_path(best_path);
+                    }
                     Candidate best_candidate = selector.calculate_best_candidate();
                     vector<Action> ret = tree.calculate_path(best_candidate.parent, turn + 1);
                     ret.push_back(best_candidate.action);
                     return ret;
                 }
 
+                if (frontier.enabled())
+                {
+                    // ビームに入らなかった候補を、根からのパスにして覚えておく
+                    const vector<Candidate> &pruned = selector.split_pruned(config.get_beam_width(turn));
+                    if (!pruned.empty())
+                    {
+                        vector<Cost> leaves;
+                        leaves.reserve(pruned.size());
+                        for (const Candidate &candidate : pruned)
+                        {
+                            leaves.push_back(candidate.cost);
+                        }
+                        frontier.record(turn, tree.calculate_paths(pruned), move(leaves));
+                    }
+                }
+
+                // 木を更新する
+                tree.update(selector.select());
+                THUNDER_PERF_TURN_END();
+
+                selector.clear();
+
+#ifdef THUNDER_CHECKPOINT
+                if (config.checkpoint_interval > 0 && (turn + 1) % config.checkpoint_interval == 0)
+                {
+                    save_checkpoint(config, turn + 1, best_cost, best_path, frontier, backtracks, stall_best_cost, stall_turns,
+                                    tree, selector);
+                }
+#endif
+            }
+
+            assert(false);
+            return {};
+        }
+
+        // ビームサーチを行い、評価がよい順に最大k個の解のパスを返す
+        // 最終ターンのSelectorに残った候補(実行可能解が見つかった場合はその候補)からk個を選ぶ
+        // k回ビームサーチをする場合と違い、探索は1回で済む
+        // roots は beam_search と同じ
+        Paths beam_search_top_k(const Config &config, const State<Selector> &state, size_t k, const vector<Root> &roots = {})
+        {
+            Tree tree(state, config);
+            if (!roots.empty())
+            {
+                tree.set_roots(roots);
+            }
+
+            // 新しいノード候補の集合
+            Selector selector(config);
+            selector.reserve_parents(roots.size());
+
+            // config.return_finished_immediately が false のときに、
+            // 実行可能解の中でよいものk個を覚えておくための変数
+            Paths best_paths;
+            for (int turn = 0; turn < config.max_turn; ++turn)
+            {
+                // Euler Tourでselectorに候補を追加する
+                selector.set_beam_width(config.get_beam_width(turn));
+                tree.dfs(selector);
+                selector.shrink_to_beam();
+
+                if (selector.have_finished())
+                {
+                    // ターン数最小化型の問題で実行可能解が見つかったとき
+                    Paths paths = tree.calculate_paths(selector.calculate_top_k_finished_candidates(k));
+                    if (config.return_finished_immediately)
+                    {
+                        return paths;
+                    }
+                    best_paths = Paths::merge_top_k(best_paths, paths, k);
+                    selector.clear_finished_candidates();
+                }
+                if (selector.select().empty())
+                {
+                    return best_paths;
+                }
+
+                if (turn == config.max_turn - 1 || timer_library::timer.getTime() > config.time_limit)
+                {
+                    // ターン数固定型の問題で全ターンが終了したとき、または制限時間を過ぎたとき
+                    if (best_paths.size() > 0)
+                    {
+                        // 制限時間を過ぎる前に実行可能解が見つかっていたとき
+                        return best_paths;
+                    }
+                    return tree.calculate_paths(selector.calculate_top_k_candidates(k));
+                }
+
                 // 木を更新する
                 tree.update(selector.select());
+                THUNDER_PERF_TURN_END();
 
                 selector.clear();
             }
@@ -0,0 +1,384 @@
+/**************************************************************/
+// 標準入出力を速くするライブラリ
+// cin, cout の代わりに fin, fout を使う。
+// fin >> n >> a[i]; fout << x << ' ' << y << '\n'; のように、cin, cout と同じように書ける。
+// 入力
+// 標準入力がファイルなら mmap し、パイプなどなら read でまとめて読み込んでから解析する。
+// 整数は8桁ずつまとめて(SWARで)変換するので、桁数の多い整数が多いときに特に速い。
+// 最初に読むときに入力を全て読み込むので、インタラクティブな問題には使えない。
+// 出力
+// バッファに溜めて、いっぱいになったときとプログラム終了時にまとめて書き出す。
+// 途中で書き出したいときは fout.flush() を呼ぶ(endl でも書き出す)。
+// cout と混ぜて使うと順番が入れ替わるので、出力はどちらかに揃える。
+/**************************************************************/
+#pragma once
+#ifndef FASTIO_HPP
+#define FASTIO_HPP
+#include <bits/stdc++.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+// 内部のusing namespace std;が他のプログラムを破壊する可能性があるため、
+// ライブラリ全体をnamespaceで囲っている。
+namespace fastio_library
+{
+    using namespace std;
+
+    //@brief 8バイトが全て数字か
+    inline bool is_eight_digits(uint64_t chunk)
+    {
+        return ((chunk & 0xf0f0f0f0f0f0f0f0ULL) == 0x3030303030303030ULL) &&
+               (((chunk + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) == 0x3030303030303030ULL);
+    }
+
+    //@brief 8桁の数字を整数に変換する
+    //@note リトルエンディアンで、先頭の文字が最下位バイトにあるとする
+    //      隣り合う桁を2桁、4桁、8桁と乗算3回でまとめる
+    inline uint32_t parse_eight_digits(uint64_t chunk)
+    {
+        chunk = (chunk & 0x0f0f0f0f0f0f0f0fULL) * 2561 >> 8;
+        chunk = (chunk & 0x00ff00ff00ff00ffULL) * 6553601 >> 16;
+        return (uint32_t)((chunk & 0x0000ffff0000ffffULL) * 42949672960001ULL >> 32);
+    }
+
+    //@brief 標準入力を読むクラス
+    class FastInput
+    {
+    public:
+        FastInput() = default;
+
+        FastInput(const FastInput &) = delete;
+        FastInput &operator=(const FastInput &) = delete;
+
+        ~FastInput()
+        {
+            if (mapped_)
+            {
+                munmap(const_cast<char *>(begin_), end_ - begin_);
+            }
+        }
+
+        template <class T>
+            requires integral<T> && (!same_as<T, char>) && (!same_as<T, bool>)
+        FastInput &operator>>(T &x)
+        {
+            skip_spaces();
+            bool negative = false;
+            if constexpr (is_signed_v<T>)
+            {
+                if (p_ < end_ && *p_ == '-')
+                {
+                    negative = true;
+                    ++p_;
+                }
+            }
+            make_unsigned_t<T> value = 0;
+            // 8桁ずつまとめて変換する
+            while (end_ - p_ >= 8)
+            {
+                uint64_t chunk;
+                memcpy(&chunk, p_, 8);
+                if (!is_eight_digits(chunk))
+                {
+                    break;
+                }
+                value = value * 100000000 + parse_eight_digits(chunk);
+                p_ += 8;
+            }
+            while (p_ < end_ && (unsigned char)(*p_ - '0') < 10)
+            {
+                value = value * 10 + (*p_ - '0');
+                ++p_;
+            }
+            x = negative ? (T)(0 - value) : (T)value;
+            return *this;
+        }
+
+        FastInput &operator>>(char &c)
+        {
+            skip_spaces();
+            c = p_ < end_ ? *p_++ : '\0';
+            return *this;
+        }
+
+        FastInput &operator>>(string &s)
+        {
+            skip_spaces();
+            const char *begin = p_;
+            while (p_ < end_ && !is_space(*p_))
+            {
+                ++p_;
+            }
+            s.assign(begin, p_);
+            return *this;
+        }
+
+        template <class T>
+            requires floating_point<T>
+        FastInput &operator>>(T &x)
+        {
+            skip_spaces();
+            auto [ptr, ec] = from_chars(p_, end_, x);
+            p_ = ptr;
+            return *this;
+        }
+
+        //@brief 空白以外の文字が残っているか
+        bool has_next()
+        {
+            skip_spaces();
+            return p_ < end_;
+        }
+
+    private:
+        const char *begin_ = nullptr;
+        const char *p_ = nullptr;
+        const char *end_ = nullptr;
+        bool loaded_ = false;
+        bool mapped_ = false;
+        // パイプなどから読んだときの入力
+        vector<char> buffer_;
+
+        static bool is_space(char c)
+        {
+            return (unsigned char)c <= ' ';
+        }
+
+        void skip_spaces()
+        {
+            if (!loaded_)
+            {
+                load();
+            }
+            while (p_ < end_ && is_space(*p_))
+            {
+                ++p_;
+            }
+        }
+
+        // 標準入力を全て読み込む
+        void load()
+        {
+            loaded_ = true;
+            struct stat st;
+            if (fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+            {
+                void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+                if (data != MAP_FAILED)
+                {
+                    mapped_ = true;
+                    begin_ = static_cast<const char *>(data);
+                    p_ = begin_;
+                    end_ = begin_ + st.st_size;
+                    return;
+                }
+            }
+            size_t size = 0;
+            buffer_.resize(1 << 16);
+            while (true)
+            {
+                if (size == buffer_.size())
+                {
+                    buffer_.resize(2 * size);
+                }
+                ssize_t n = read(STDIN_FILENO, buffer_.data() + size, buffer_.size() - size);
+                if (n == -1 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    break;
+                }
+                size += n;
+            }
+            begin_ = buffer_.data();
+            p_ = begin_;
+            end_ = begin_ + size;
+        }
+    };
+
+    //@brief 標準出力に書くクラス
+    class FastOutput
+    {
+    public:
+        FastOutput()
+        {
+            buffer_.resize(BUFFER_SIZE);
+        }
+
+        FastOutput(const FastOutput &) = delete;
+        FastOutput &operator=(const FastOutput &) = delete;
+
+        ~FastOutput()
+        {
+            flush();
+        }
+
+        template <class T>
+            requires integral<T> && (!same_as<T, char>) && (!same_as<T, bool>)
+        FastOutput &operator<<(T x)
+        {
+            reserve(24);
+            make_unsigned_t<T> value = x;
+            if constexpr (is_signed_v<T>)
+            {
+                if (x < 0)
+                {
+                    buffer_[size_++] = '-';
+                    value = 0 - value;
+                }
+            }
+            // 下の桁から2桁ずつ表を引いて作業領域に書き、まとめてコピーする
+            char digits[24];
+            char *q = digits + sizeof(digits);
+            while (value >= 100)
+            {
+                q -= 2;
+                memcpy(q, digit_pairs() + 2 * (value % 100), 2);
+                value /= 100;
+            }
+            if (value >= 10)
+            {
+                q -= 2;
+                memcpy(q, digit_pairs() + 2 * value, 2);
+            }
+            else
+            {
+                *--q = '0' + value;
+            }
+            size_t length = digits + sizeof(digits) - q;
+            memcpy(buffer_.data() + size_, q, length);
+            size_ += length;
+            return *this;
+        }
+
+        FastOutput &operator<<(bool x)
+        {
+            return *this << (x ? '1' : '0');
+        }
+
+        FastOutput &operator<<(char c)
+        {
+            reserve(1);
+            buffer_[size_++] = c;
+            return *this;
+        }
+
+        FastOutput &operator<<(string_view s)
+        {
+            if (s.size() > BUFFER_SIZE)
+            {
+                flush();
+                write_all(s.data(), s.size());
+                return *this;
+            }
+            reserve(s.size());
+            memcpy(buffer_.data() + size_, s.data(), s.size());
+            size_ += s.size();
+            return *this;
+        }
+
+        FastOutput &operator<<(const char *s)
+        {
+            return *this << string_view(s);
+        }
+
+        FastOutput &operator<<(const string &s)
+        {
+            return *this << string_view(s);
+        }
+
+        //@note precision を指定しなければ、読み直して同じ値になる最短の表記にする
+        template <class T>
+            requires floating_point<T>
+        FastOutput &operator<<(T x)
+        {
+            reserve(64);
+            char *first = buffer_.data() + size_;
+            auto [ptr, ec] = precision_ < 0 ? to_chars(first, first + 64, x)
+                                            : to_chars(first, first + 64, x, chars_format::fixed, precision_);
+            size_ = ptr - buffer_.data();
+            return *this;
+        }
+
+        //@brief endl などのマニピュレータ。endl と flush のときは書き出す
+        FastOutput &operator<<(ostream &(*manipulator)(ostream &))
+        {
+            if (manipulator == static_cast<ostream &(*)(ostream &)>(endl))
+            {
+                *this << '\n';
+            }
+            flush();
+            return *this;
+        }
+
+        //@brief 実数を小数点以下 precision 桁で書く。負の値なら最短の表記に戻す
+        void set_precision(int precision)
+        {
+            precision_ = precision;
+        }
+
+        //@brief バッファの中身を書き出す
+        void flush()
+        {
+            write_all(buffer_.data(), size_);
+            size_ = 0;
+        }
+
+    private:
+        static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+        vector<char> buffer_;
+        size_t size_ = 0;
+        int precision_ = -1;
+
+        // "00", "01", ..., "99" を並べた表
+        static const char *digit_pairs()
+        {
+            static constexpr auto table = []()
+            {
+                array<char, 200> table{};
+                for (int i = 0; i < 100; ++i)
+                {
+                    table[2 * i] = '0' + i / 10;
+                    table[2 * i + 1] = '0' + i % 10;
+                }
+                return table;
+            }();
+            return table.data();
+        }
+
+        // あと size バイト書けるようにする
+        void reserve(size_t size)
+        {
+            if (size_ + size > BUFFER_SIZE)
+            {
+                flush();
+            }
+        }
+
+        static void write_all(const char *data, size_t size)
+        {
+            while (size > 0)
+            {
+                ssize_t written = write(STDOUT_FILENO, data, size);
+                if (written == -1)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return;
+                }
+                data += written;
+                size -= written;
+            }
+        }
+    };
+
+    FastInput fin;
+    FastOutput fout;
+} // namespace fastio_library
+using namespace fastio_library;
+#endif
@@ -0,0 +1,434 @@
+/**************************************************************/
+// モンテカルロ木探索(MCTS)のライブラリ
+// 遷移に乱数が絡む問題など、ビームサーチで状態を比べにくい問題で使う。
+// Action, State を自分で定義、実装して
+// using MCTSUser = MonteCarloTreeSearch<Action, State>;
+// と記述し、
+// MCTSUser mcts;
+// auto action = mcts.search(config, state);
+// で、今の状態で最もよい行動を求める。
+// State について
+// ビームサーチと同じ差分更新の State を使い、プレイアウトでは State をコピーせずに
+// move_forward で進み、終わったら move_backward で戻る。
+// void legal_actions(vector<Action> &actions)  今の状態で選べる行動を actions に入れる(actions は空で渡す)
+// void move_forward(const Action &action)       action を実行して次の状態に遷移する
+// void move_backward(const Action &action)      action を実行する前の状態に遷移する
+// bool is_terminal() const                      終了状態か
+// double evaluate() const                       今の状態の報酬(大きいほどよい。0以上1以下にそろえるとexplorationを調整しやすい)
+// を実装する。
+// 遷移に乱数が絡む場合は、move_forward の中で State が持つ乱数を使って遷移してよい(戻すための情報は State が覚えておく)。
+// 木のノードは行動の列だけで決まり、同じ行動の列から起こりうる状態をまとめて扱う(open-loop MCTS)。
+// 複数のスレッドで探索するときは、State がスレッドごとにコピーされる。
+// void reseed(uint64_t seed) を実装すると、コピーごとに異なる種で呼ぶので、スレッドごとに乱数の系列を変えられる。
+// 木
+// ノードは skip_beam.cpp の Node と同じく、最初の子と右の兄弟のインデックスで木を表し、ObjectPool にまとめて置く。
+// 選択には UCT を使い、log は表を引く。
+// 複数のスレッドで探索するときは、選択中のノードに仮想的な負けを足して、スレッドが同じ経路に集まらないようにする(virtual loss)。
+/**************************************************************/
+#pragma once
+#ifndef MCTS_HPP
+#define MCTS_HPP
+#include <bits/stdc++.h>
+#include "timer.cpp"
+#include "random.cpp"
+// 内部のusing namespace std;が他のプログラムを破壊する可能性があるため、
+// ライブラリ全体をnamespaceで囲っている。
+namespace mcts_library
+{
+    using namespace std;
+
+    // メモリを再利用しながら要素を追加していく配列
+    // 探索ごとに clear して使い回すので、2回目以降の探索ではメモリを確保しない
+    template <class T>
+    class ObjectPool
+    {
+    public:
+        // 配列と同じようにアクセスできる
+        T &operator[](int i)
+        {
+            return data_[i];
+        }
+
+        const T &operator[](int i) const
+        {
+            return data_[i];
+        }
+
+        // 配列の長さを変更せずにメモリを確保する
+        void reserve(size_t capacity)
+        {
+            data_.reserve(capacity);
+        }
+
+        // 要素を追加し、追加されたインデックスを返す
+        int push(const T &x)
+        {
+            data_.push_back(x);
+            return data_.size() - 1;
+        }
+
+        // 全ての要素を削除する(メモリは解放しない)
+        void clear()
+        {
+            data_.clear();
+        }
+
+        size_t size() const
+        {
+            return data_.size();
+        }
+
+    private:
+        vector<T> data_;
+    };
+
+    // UCT で使う log(n) の表
+    // n が表の大きさ以上のときだけ log を計算する
+    class LogTable
+    {
+    public:
+        static constexpr uint32_t LOG_TABLE_SIZE = 1 << 16;
+
+        static const LogTable &get()
+        {
+            static const LogTable table;
+            return table;
+        }
+
+        double operator()(uint32_t n) const
+        {
+            return n < LOG_TABLE_SIZE ? table_[n] : log((double)n);
+        }
+
+    private:
+        array<double, LOG_TABLE_SIZE> table_;
+
+        LogTable()
+        {
+            table_[0] = 0;
+            for (uint32_t n = 1; n < LOG_TABLE_SIZE; ++n)
+            {
+                table_[n] = log((double)n);
+            }
+        }
+    };
+
+    template <typename StateType, typename ActionType>
+    concept MCTSStateConcept = requires(StateType state, const StateType const_state, vector<ActionType> actions) {
+        { state.legal_actions(actions) } -> same_as<void>;
+        { state.move_forward(std::declval<const ActionType &>()) } -> same_as<void>;
+        { state.move_backward(std::declval<const ActionType &>()) } -> same_as<void>;
+        { const_state.is_terminal() } -> same_as<bool>;
+        { const_state.evaluate() } -> same_as<double>;
+    };
+
+    // スレッドごとに乱数の種を変えられるか
+    template <typename StateType>
+    concept ReseedableConcept = requires(StateType state) {
+        { state.reseed(std::declval<uint64_t>()) } -> same_as<void>;
+    };
+
+    template <typename Action, class State>
+    struct MonteCarloTreeSearch
+    {
+        // 探索の設定
+        struct Config
+        {
+            // 終了する時刻(timer_library::timer の経過秒数)
+            double time_limit;
+            // 最初に確保するノード数
+            size_t nodes_capacity;
+            // UCT の探索項の係数。報酬が0以上1以下なら sqrt(2) 前後がよく使われる
+            double exploration = 1.41421356237;
+            // プレイアウトを終えた訪問がこの回数に達する葉を展開する(今の訪問を含み、選択中の virtual loss は数えない)
+            // 根は最初の訪問で展開する
+            uint32_t expand_threshold = 1;
+            // プレイアウトで進む最大の手数
+            int max_rollout_depth = 1000;
+            // 探索するスレッドの数
+            int num_threads = 1;
+            // 選択中のノードに足す仮想的な訪問回数(報酬は0として足す)
+            uint32_t virtual_loss = 1;
+            uint64_t seed = 1;
+        };
+
+        // 根の子ごとの統計
+        struct ChildStatistics
+        {
+            Action action;
+            uint32_t visits;
+            double mean_reward;
+        };
+
+        // 探索を行い、根から最も多く訪れた行動を返す
+        // 根が終了状態か、選べる行動がないときは nullopt を返す
+        optional<Action> search(const Config &config, const State &state)
+        {
+            assert(config.num_threads >= 1 && config.expand_threshold >= 1);
+            config_ = config;
+            nodes_.clear();
+            nodes_.reserve(config.nodes_capacity);
+            nodes_.push(Node(Action(), -1));
+            num_playouts_ = 0;
+
+            if (config.num_threads == 1)
+            {
+                Worker worker(*this, state, make_thread_seed(config.seed, 0));
+                worker.run();
+            }
+            else
+            {
+                vector<thread> threads;
+                threads.reserve(config.num_threads);
+                for (int i = 0; i < config.num_threads; ++i)
+                {
+                    threads.emplace_back([&, i]()
+                                         {
+                                             Worker worker(*this, state, make_thread_seed(config.seed, i));
+                                             worker.run(); });
+                }
+                for (thread &th : threads)
+                {
+                    th.join();
+                }
+            }
+
+            int best = -1;
+            for (int c = nodes_[ROOT].child; c != -1; c = nodes_[c].right)
+            {
+                if (best == -1 || nodes_[c].visits > nodes_[best].visits)
+                {
+                    best = c;
+                }
+            }
+            if (best == -1)
+            {
+                return nullopt;
+            }
+            return nodes_[best].action;
+        }
+
+        // 直前の search での根の子ごとの統計を返す
+        vector<ChildStatistics> get_root_statistics() const
+        {
+            vector<ChildStatistics> ret;
+            for (int c = nodes_[ROOT].child; c != -1; c = nodes_[c].right)
+            {
+                const Node &node = nodes_[c];
+                ret.push_back({node.action, node.visits, node.visits == 0 ? 0.0 : node.reward_sum / node.visits});
+            }
+            return ret;
+        }
+
+        // 直前の search で行ったプレイアウトの回数
+        uint64_t get_num_playouts() const
+        {
+            return num_playouts_;
+        }
+
+    private:
+        static constexpr int ROOT = 0;
+
+        // 木のノード
+        // 子は child から right をたどって列挙する
+        struct Node
+        {
+            Action action;
+            int parent, child, right;
+            // 訪問回数(選択中の virtual loss を含む)と報酬の合計
+            uint32_t visits;
+            double reward_sum;
+            // プレイアウトを終えた訪問回数(expand_threshold と比べる)
+            uint32_t finished_visits;
+            bool expanded;
+
+            Node(const Action &action, int parent) : action(action),
+                                                     parent(parent),
+                                                     child(-1),
+                                                     right(-1),
+                                                     visits(0),
+                                                     reward_sum(0),
+                                                     finished_visits(0),
+                                                     expanded(false) {}
+        };
+
+        Config config_;
+        ObjectPool<Node> nodes_;
+        // 木を読み書きするときに取るロック
+        // プレイアウトはロックの外で行うので、スレッド数が少なければ待ちはほとんど起きない
+        mutex mtx_;
+        uint64_t num_playouts_ = 0;
+
+        // 1つのスレッドで探索する
+        class Worker
+        {
+        public:
+            Worker(MonteCarloTreeSearch &mcts, const State &state, uint64_t seed) : mcts_(mcts),
+                                                                                     state_(state),
+                                                                                     random_(seed),
+                                                                                     log_table_(LogTable::get())
+            {
+                if constexpr (ReseedableConcept<State>)
+                {
+                    state_.reseed(seed);
+                }
+            }
+
+            // 制限時間を過ぎていても1回はプレイアウトするので、根は必ず展開される
+            void run()
+            {
+                uint64_t playouts = 0;
+                do
+                {
+                    playout();
+                    ++playouts;
+                } while (timer_library::timer.getTime() < mcts_.config_.time_limit);
+                lock_guard<mutex> lock(mcts_.mtx_);
+                mcts_.num_playouts_ += playouts;
+            }
+
+        private:
+            MonteCarloTreeSearch &mcts_;
+            State state_;
+            Xoshiro256PlusPlus random_;
+            const LogTable &log_table_;
+            // 以下は毎回使い回すバッファ
+            vector<int> path_;
+            vector<Action> path_actions_;
+            vector<Action> actions_;
+            vector<Action> rollout_actions_;
+
+            // 選択、展開、プレイアウト、逆伝播を1回ずつ行う
+            void playout()
+            {
+                const Config &config = mcts_.config_;
+                ObjectPool<Node> &nodes = mcts_.nodes_;
+                path_.clear();
+                path_actions_.clear();
+
+                // 選択
+                bool should_expand;
+                {
+                    lock_guard<mutex> lock(mcts_.mtx_);
+                    int v = ROOT;
+                    nodes[v].visits += config.virtual_loss;
+                    path_.push_back(v);
+                    while (nodes[v].expanded && nodes[v].child != -1)
+                    {
+                        v = select_child(v);
+                        nodes[v].visits += config.virtual_loss;
+                        path_.push_back(v);
+                        path_actions_.push_back(nodes[v].action);
+                    }
+                    should_expand = !nodes[v].expanded && (v == ROOT || nodes[v].finished_visits + 1 >= config.expand_threshold);
+                }
+                for (const Action &action : path_actions_)
+                {
+                    state_.move_forward(action);
+                }
+
+                // 展開
+                if (should_expand && !state_.is_terminal())
+                {
+                    actions_.clear();
+                    state_.legal_actions(actions_);
+                    lock_guard<mutex> lock(mcts_.mtx_);
+                    int v = path_.back();
+                    // 他のスレッドが先に展開していなければ展開する
+                    if (!nodes[v].expanded)
+                    {
+                        for (const Action &action : actions_)
+                        {
+                            int c = nodes.push(Node(action, v));
+                            nodes[c].right = nodes[v].child;
+                            nodes[v].child = c;
+                        }
+                        nodes[v].expanded = true;
+                    }
+                    if (nodes[v].child != -1)
+                    {
+                        int c = select_child(v);
+                        nodes[c].visits += config.virtual_loss;
+                        path_.push_back(c);
+                        path_actions_.push_back(nodes[c].action);
+                        state_.move_forward(nodes[c].action);
+                    }
+                }
+
+                // プレイアウト
+                double reward = rollout();
+
+                for (auto it = path_actions_.rbegin(); it != path_actions_.rend(); ++it)
+                {
+                    state_.move_backward(*it);
+                }
+
+                // 逆伝播
+                lock_guard<mutex> lock(mcts_.mtx_);
+                for (int v : path_)
+                {
+                    nodes[v].visits -= config.virtual_loss - 1;
+                    nodes[v].reward_sum += reward;
+                    ++nodes[v].finished_visits;
+                }
+            }
+
+            // 一様ランダムに行動を選んで終了状態まで進み、報酬を返す
+            // 進んだ分は move_backward で戻す
+            double rollout()
+            {
+                rollout_actions_.clear();
+                for (int depth = 0; depth < mcts_.config_.max_rollout_depth && !state_.is_terminal(); ++depth)
+                {
+                    actions_.clear();
+                    state_.legal_actions(actions_);
+                    if (actions_.empty())
+                    {
+                        break;
+                    }
+                    const Action &action = actions_[random_.next_int(actions_.size())];
+                    state_.move_forward(action);
+                    rollout_actions_.push_back(action);
+                }
+                double reward = state_.evaluate();
+                for (auto it = rollout_actions_.rbegin(); it != rollout_actions_.rend(); ++it)
+                {
+                    state_.move_backward(*it);
+                }
+                return reward;
+            }
+
+            // UCT の値が最大の子を返す
+            // 訪れていない子があればそれを優先する
+            int select_child(int v)
+            {
+                ObjectPool<Node> &nodes = mcts_.nodes_;
+                double exploration = mcts_.config_.exploration * sqrt(log_table_(nodes[v].visits));
+                int best = -1;
+                double best_score = -numeric_limits<double>::infinity();
+                for (int c = nodes[v].child; c != -1; c = nodes[c].right)
+                {
+                    const Node &child = nodes[c];
+                    if (child.visits == 0)
+                    {
+                        return c;
+                    }
+                    double inverse = 1.0 / child.visits;
+                    double score = child.reward_sum * inverse + exploration * sqrt(inverse);
+                    if (score > best_score)
+                    {
+                        best_score = score;
+                        best = c;
+                    }
+                }
+                return best;
+            }
+        };
+
+        // MCTSStateConcept のチェックを構造体内で実施
+        static_assert(MCTSStateConcept<State, Action>,
+                      "State must satisfy MCTSStateConcept");
+    }; // MonteCarloTreeSearch
+} // namespace mcts_library
+using namespace mcts_library;
+#endif
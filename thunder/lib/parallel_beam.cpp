@@ -0,0 +1,83 @@
+/**************************************************************/
+// 独立なビームサーチを複数のスレッドで同時に実行し、最もよい結果を返すライブラリ
+// edge_beam.cpp, skip_beam.cpp のどちらのビームサーチとも組み合わせられる
+// ビームサーチはタイブレークやビーム幅によって結果がばらつくので、
+// インスタンスごとに Config の tie_break_seed や beam_width を変えて実行し、
+// 一番よいものを採用する。
+// 使い方
+// auto configs = make_parallel_configs(config, 4, seed);
+// configs[1].beam_width = ...; // 必要ならインスタンスごとに変える
+// auto output = run_parallel(configs,
+//     [&](const BeamSearchUser::Config &config) { return beam_search.beam_search(config, state); },
+//     [&](const vector<Action> &output) { return (Cost)output.size(); });
+// ビームサーチはStateをコピーしてから探索するので、スレッドごとにStateが用意される。
+// 全インスタンスが同じ timer_library::timer を見るので、
+// Config の time_limit を揃えておけば締め切りも共有される。
+/**************************************************************/
+#pragma once
+#ifndef PARALLEL_BEAM_HPP
+#define PARALLEL_BEAM_HPP
+#include <bits/stdc++.h>
+#include "timer.cpp"
+#include "random.cpp"
+// 内部のusing namespace std;が他のプログラムを破壊する可能性があるため、
+// ライブラリ全体をnamespaceで囲っている。
+namespace parallel_beam_library
+{
+    using namespace std;
+
+    //@brief configをnum_instances個複製し、それぞれに異なる tie_break_seed を設定する
+    //@note tie_break_seed は0だと乱数を使わないので、0以外になるようにしている
+    template <class Config>
+    vector<Config> make_parallel_configs(const Config &config, int num_instances, uint64_t seed)
+    {
+        vector<Config> configs(num_instances, config);
+        for (Config &c : configs)
+        {
+            do
+            {
+                c.tie_break_seed = split_mix64(seed);
+            } while (c.tie_break_seed == 0);
+        }
+        return configs;
+    }
+
+    //@brief configs[i] を引数に search を別々のスレッドで実行し、evaluate が最も小さい結果を返す
+    //@param search Configを受け取り、探索結果を返す関数。複数のスレッドから同時に呼ばれる
+    //@param evaluate 探索結果を受け取り、小さいほどよい評価値を返す関数
+    //@note 評価値が等しいときは添字が小さいインスタンスの結果を返す
+    template <class Config, class Search, class Evaluate>
+    auto run_parallel(const vector<Config> &configs, Search search, Evaluate evaluate)
+    {
+        using Result = invoke_result_t<Search, const Config &>;
+        assert(!configs.empty());
+
+        vector<optional<Result>> results(configs.size());
+        vector<thread> threads;
+        threads.reserve(configs.size());
+        for (size_t i = 0; i < configs.size(); ++i)
+        {
+            threads.emplace_back([&, i]()
+                                 { results[i] = search(configs[i]); });
+        }
+        for (thread &th : threads)
+        {
+            th.join();
+        }
+
+        size_t best = 0;
+        auto best_score = evaluate(*results[0]);
+        for (size_t i = 1; i < results.size(); ++i)
+        {
+            auto score = evaluate(*results[i]);
+            if (score < best_score)
+            {
+                best = i;
+                best_score = score;
+            }
+        }
+        return move(*results[best]);
+    }
+} // namespace parallel_beam_library
+using namespace parallel_beam_library;
+#endif
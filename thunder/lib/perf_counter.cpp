@@ -0,0 +1,355 @@
+/**************************************************************/
+// 探索の各フェーズのハードウェアカウンタを計測するライブラリ
+// THUNDER_PERF を define してからインクルードすると、
+// THUNDER_PERF_SCOPE("ラベル") を書いた区間の
+// サイクル数、命令数、L1データキャッシュミス、LLCミス、分岐予測ミスを
+// Linux の perf_event_open で計測し、ラベルごとに集計する。
+// THUNDER_PERF_TURN_END() を呼ぶたびにそのターンの集計値を標準エラー出力に表示し、
+// プログラム終了時には全体の集計値を表示する。
+// THUNDER_TRACE も define していれば、ターンごとの値をトレースのカウンタとしても記録する(trace.cpp参照)
+// 表示の間隔は THUNDER_PERF_INTERVAL ターンごとに変更できる(デフォルトは1)。
+// カウンタが使えない環境(Linux以外、perf_event_paranoid の制限、コンテナなど)では
+// 時間だけを計測して表示する。
+// カウンタの読み出しはシステムコールなので、1回あたり数マイクロ秒かかる。
+// Selector::push のように1ターンに何度も呼ばれる場所ではなく、dfs などのフェーズ単位で使う。
+// 複数のスレッドで同時に探索したときは、各スレッドの値を足し合わせたものになる。
+// define しなければマクロは何もしないので、ライブラリに書いたままでもオーバーヘッドはない。
+/**************************************************************/
+#pragma once
+#ifndef PERF_COUNTER_HPP
+#define PERF_COUNTER_HPP
+#include <bits/stdc++.h>
+#include "timer.cpp"
+#ifdef THUNDER_TRACE
+#include "trace.cpp"
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#ifndef THUNDER_PERF_INTERVAL
+#define THUNDER_PERF_INTERVAL 1
+#endif
+// 内部のusing namespace std;が他のプログラムを破壊する可能性があるため、
+// ライブラリ全体をnamespaceで囲っている。
+namespace perf_counter_library
+{
+    using namespace std;
+
+    // 計測するハードウェアカウンタの数
+    constexpr int NUM_PERF_EVENTS = 5;
+    // 表示に使うカウンタの名前
+    constexpr const char *PERF_EVENT_NAMES[NUM_PERF_EVENTS] = {
+        "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+
+    //@brief ある時点でのカウンタの値
+    //@note 使えないカウンタは0のまま。最後の要素はrdtscのサイクル数
+    using PerfSample = array<uint64_t, NUM_PERF_EVENTS + 1>;
+
+    //@brief いずれかのスレッドで使えたカウンタのビット集合
+    //@note スレッドごとのカウンタはプログラム終了時の表示より先に破棄されるので、別に持っておく
+    inline atomic<uint32_t> &available_events()
+    {
+        static atomic<uint32_t> mask = 0;
+        return mask;
+    }
+
+    //@brief 呼び出したスレッドのハードウェアカウンタを1つのグループとしてまとめて読む
+    //@note perf_event_open はスレッドごとに計測するので、スレッドごとに作る
+    class PerfCounterGroup
+    {
+    public:
+        PerfCounterGroup()
+        {
+            fds_.fill(-1);
+            index_.fill(-1);
+#ifdef __linux__
+            // PERF_COUNT_HW_CACHE_MISSES はほとんどのCPUでLLCのミスを数える
+            constexpr pair<uint32_t, uint64_t> events[NUM_PERF_EVENTS] = {
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}};
+            int num_opened = 0;
+            for (int e = 0; e < NUM_PERF_EVENTS; ++e)
+            {
+                // 開けなかったカウンタは諦めて、残りだけで計測する
+                int fd = open_event(events[e].first, events[e].second, leader_);
+                if (fd == -1)
+                {
+                    continue;
+                }
+                if (leader_ == -1)
+                {
+                    leader_ = fd;
+                }
+                fds_[e] = fd;
+                index_[e] = num_opened++;
+                available_events().fetch_or(1u << e, memory_order_relaxed);
+            }
+            if (leader_ != -1)
+            {
+                ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+#endif
+        }
+
+        ~PerfCounterGroup()
+        {
+#ifdef __linux__
+            for (int fd : fds_)
+            {
+                if (fd != -1)
+                {
+                    close(fd);
+                }
+            }
+#endif
+        }
+
+        PerfCounterGroup(const PerfCounterGroup &) = delete;
+        PerfCounterGroup &operator=(const PerfCounterGroup &) = delete;
+
+        //@brief ハードウェアカウンタが1つでも使えるか
+        bool available() const
+        {
+            return leader_ != -1;
+        }
+
+        //@brief event 番目のカウンタが使えるか
+        bool has(int event) const
+        {
+            return index_[event] != -1;
+        }
+
+        //@brief 現在のカウンタの値を読む
+        //@note カウンタが多重化されているときは、計測できた時間の割合で補正する
+        PerfSample read() const
+        {
+            PerfSample sample{};
+#ifdef __linux__
+            if (available())
+            {
+                // PERF_FORMAT_GROUP | TOTAL_TIME_ENABLED | TOTAL_TIME_RUNNING の形式
+                // {nr, time_enabled, time_running, values[nr]}
+                uint64_t buffer[3 + NUM_PERF_EVENTS];
+                if (::read(leader_, buffer, sizeof(buffer)) > 0)
+                {
+                    uint64_t enabled = buffer[1];
+                    uint64_t running = buffer[2];
+                    for (int e = 0; e < NUM_PERF_EVENTS; ++e)
+                    {
+                        if (index_[e] == -1)
+                        {
+                            continue;
+                        }
+                        uint64_t value = buffer[3 + index_[e]];
+                        if (running != enabled && running != 0)
+                        {
+                            value = (uint64_t)((double)value * enabled / running);
+                        }
+                        sample[e] = value;
+                    }
+                }
+            }
+#endif
+            sample[NUM_PERF_EVENTS] = timer_library::read_cycles();
+            return sample;
+        }
+
+    private:
+        int leader_ = -1;
+        // カウンタごとのファイルディスクリプタ
+        array<int, NUM_PERF_EVENTS> fds_;
+        // グループで読んだときの位置。開けなかったカウンタは-1
+        array<int, NUM_PERF_EVENTS> index_;
+
+#ifdef __linux__
+        // 自スレッドのユーザ空間だけを計測するカウンタを開く
+        static int open_event(uint32_t type, uint64_t config, int group_fd)
+        {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            // グループのリーダーだけ止めておき、全て開いてからまとめて開始する
+            attr.disabled = group_fd == -1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+        }
+#endif
+    };
+
+    //@brief 呼び出したスレッドのカウンタ
+    //@note 初回の呼び出し時に開く
+    inline PerfCounterGroup &thread_counters()
+    {
+        thread_local PerfCounterGroup group;
+        return group;
+    }
+
+    //@brief THUNDER_PERF_SCOPE で計測する区間のラベルごとの集計値
+    //@note 複数のスレッドから同時に加算してもよい
+    struct PerfSection
+    {
+        const char *label;
+        // 前回表示してから加算された値
+        array<atomic<uint64_t>, NUM_PERF_EVENTS + 1> pending{};
+        // 全体の合計
+        array<atomic<uint64_t>, NUM_PERF_EVENTS + 1> total{};
+        // トレースのカウンタ名
+        array<string, NUM_PERF_EVENTS + 1> trace_names;
+
+        explicit PerfSection(const char *label) : label(label)
+        {
+            for (int e = 0; e < NUM_PERF_EVENTS; ++e)
+            {
+                trace_names[e] = string(label) + "." + PERF_EVENT_NAMES[e];
+            }
+            trace_names[NUM_PERF_EVENTS] = string(label) + ".tsc_cycles";
+            lock_guard<mutex> lock(sections_mutex());
+            sections().push_back(this);
+        }
+
+        void add(const PerfSample &begin, const PerfSample &end)
+        {
+            for (int e = 0; e <= NUM_PERF_EVENTS; ++e)
+            {
+                uint64_t delta = end[e] - begin[e];
+                pending[e].fetch_add(delta, memory_order_relaxed);
+                total[e].fetch_add(delta, memory_order_relaxed);
+            }
+        }
+
+        //@brief 登録された全ての区間
+        //@note プログラム終了時の表示より先に破棄されないように、解放しない
+        static vector<PerfSection *> &sections()
+        {
+            static vector<PerfSection *> *sections = new vector<PerfSection *>();
+            return *sections;
+        }
+
+        static mutex &sections_mutex()
+        {
+            static mutex *m = new mutex();
+            return *m;
+        }
+    };
+
+    //@brief 集計値を1行で表示する
+    inline void print_sample(ostream &os, const char *prefix, const char *label, const PerfSample &sample)
+    {
+        uint32_t mask = available_events();
+        os << "[perf] " << prefix << label
+           << " " << timer_library::timer.cycles_to_seconds(sample[NUM_PERF_EVENTS]) << " sec";
+        for (int e = 0; e < NUM_PERF_EVENTS; ++e)
+        {
+            if (mask >> e & 1)
+            {
+                os << " " << PERF_EVENT_NAMES[e] << " " << sample[e];
+            }
+        }
+        if ((mask & 3) == 3 && sample[0] != 0)
+        {
+            os << " ipc " << (double)sample[1] / sample[0];
+        }
+        os << "\n";
+    }
+
+    //@brief 1ターンの終わりに呼び、THUNDER_PERF_INTERVAL ターンごとに集計値を表示する
+    inline void end_turn()
+    {
+        static atomic<int> turn_counter = 0;
+        int turn = turn_counter.fetch_add(1);
+        if ((turn + 1) % THUNDER_PERF_INTERVAL != 0)
+        {
+            return;
+        }
+        string prefix = "turn " + to_string(turn) + " ";
+        lock_guard<mutex> lock(PerfSection::sections_mutex());
+        for (PerfSection *section : PerfSection::sections())
+        {
+            PerfSample sample;
+            for (int e = 0; e <= NUM_PERF_EVENTS; ++e)
+            {
+                sample[e] = section->pending[e].exchange(0, memory_order_relaxed);
+            }
+            if (sample[NUM_PERF_EVENTS] == 0)
+            {
+                // この間に一度も通らなかった区間
+                continue;
+            }
+            print_sample(clog, prefix.c_str(), section->label, sample);
+#ifdef THUNDER_TRACE
+            for (int e = 0; e <= NUM_PERF_EVENTS; ++e)
+            {
+                if (e == NUM_PERF_EVENTS || (available_events() >> e & 1))
+                {
+                    trace_library::trace_buffer().add_counter(section->trace_names[e].c_str(), sample[e]);
+                }
+            }
+#endif
+        }
+    }
+
+    //@brief スコープに入ってから出るまでのカウンタの増分をsectionに加算する
+    struct ScopedPerf
+    {
+        PerfSection &section;
+        PerfSample begin;
+
+        explicit ScopedPerf(PerfSection &section) : section(section), begin(thread_counters().read()) {}
+
+        ~ScopedPerf()
+        {
+            section.add(begin, thread_counters().read());
+        }
+    };
+
+#ifdef THUNDER_PERF
+    //@brief プログラム終了時に全体の集計値を表示する
+    struct PerfReporter
+    {
+        ~PerfReporter()
+        {
+            if (available_events() == 0)
+            {
+                clog << "[perf] hardware counters are unavailable, only time is reported\n";
+            }
+            lock_guard<mutex> lock(PerfSection::sections_mutex());
+            for (PerfSection *section : PerfSection::sections())
+            {
+                PerfSample sample;
+                for (int e = 0; e <= NUM_PERF_EVENTS; ++e)
+                {
+                    sample[e] = section->total[e];
+                }
+                print_sample(clog, "total ", section->label, sample);
+            }
+        }
+    };
+    PerfReporter perf_reporter;
+#endif
+} // namespace perf_counter_library
+using namespace perf_counter_library;
+
+#ifdef THUNDER_PERF
+// このマクロを書いた行からスコープの終わりまでのハードウェアカウンタの増分を label ごとに集計する
+// 集計値はプログラム終了時の表示より先に破棄されないように、解放しない
+#define THUNDER_PERF_SCOPE(label)                                                                                                     \
+    static perf_counter_library::PerfSection &THUNDER_PROFILE_CONCAT(thunder_perf_section_, __LINE__) = *new perf_counter_library::PerfSection(label); \
+    perf_counter_library::ScopedPerf THUNDER_PROFILE_CONCAT(thunder_perf_scope_, __LINE__)(THUNDER_PROFILE_CONCAT(thunder_perf_section_, __LINE__))
+// 1ターンの終わりに呼び、そのターンの集計値を表示する
+#define THUNDER_PERF_TURN_END() perf_counter_library::end_turn()
+#else
+#define THUNDER_PERF_SCOPE(label)
+#define THUNDER_PERF_TURN_END()
+#endif
+#endif
@@ -0,0 +1,315 @@
+/**************************************************************/
+// 探索の内側のループで使う軽い乱数生成器のライブラリ
+// mt19937 や rand() は状態が大きかったり遅かったりするので、
+// 焼きなましの近傍の乱択やビームサーチのタイブレークなど、1反復に何度も呼ぶ場所ではこちらを使う。
+// 生成器
+// Xoshiro256PlusPlus : 64bit出力。特に理由がなければこれを使う
+// Pcg32              : 32bit出力。状態が小さい
+// Xorshift64         : 64bit出力。最も軽いが質は落ちる。ビームサーチのタイブレークで使っている
+// Xoshiro128PlusPlusX8 : 32bitの乱数を8個ずつまとめて作る。AVX2が使えればベクトル命令で計算する
+// どの生成器も
+// random()               64bitの乱数
+// random.next_int(n)     [0, n) の整数(Lemireの方法で偏りなし、除算はほぼ起きない)
+// random.next_int(l, r)  [l, r] の整数
+// random.next_double()   [0, 1) の実数(分岐も整数から実数への変換もしない)
+// random.next_bool()     1/2 で true
+// を持つ。
+// スレッドごとに別の系列を使うときは make_thread_seed(seed, スレッドの番号) で種を作る。
+/**************************************************************/
+#pragma once
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+#include <bits/stdc++.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+// 内部のusing namespace std;が他のプログラムを破壊する可能性があるため、
+// ライブラリ全体をnamespaceで囲っている。
+namespace random_library
+{
+    using namespace std;
+
+    //@brief seed から互いに異なる64bitの値を作る
+    //@note 生成器の種の初期化に使う
+    constexpr uint64_t split_mix64(uint64_t &seed)
+    {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    //@brief seed と番号から、スレッドやインスタンスごとの種を作る
+    //@note 同じ seed でも index が違えば相関のない系列になる
+    constexpr uint64_t make_thread_seed(uint64_t seed, uint64_t index)
+    {
+        uint64_t s = seed ^ (index * 0xd1b54a32d192ed03ULL);
+        split_mix64(s);
+        return split_mix64(s);
+    }
+
+    //@brief xorshift64 の状態を1つ進めて返す
+    //@note state が0のままだと0しか返さない
+    inline uint64_t xorshift64(uint64_t &state)
+    {
+        state ^= state << 7;
+        state ^= state >> 9;
+        return state;
+    }
+
+    //@brief 64bitの乱数から各種の値を作る共通部分
+    //@note Derived は uint64_t operator()() を持つ
+    template <class Derived>
+    class RandomBase
+    {
+    public:
+        using result_type = uint64_t;
+
+        static constexpr uint64_t min()
+        {
+            return 0;
+        }
+
+        static constexpr uint64_t max()
+        {
+            return numeric_limits<uint64_t>::max();
+        }
+
+        //@brief [0, n) の整数
+        //@note Lemireの方法。乗算の上位ビットを使い、偏りが出るときだけ引き直す
+        uint64_t next_int(uint64_t n)
+        {
+            assert(n > 0);
+            __uint128_t m = (__uint128_t)next() * n;
+            uint64_t low = (uint64_t)m;
+            if (low < n)
+            {
+                // 2^64 mod n 未満のときだけ偏るので引き直す
+                uint64_t threshold = -n % n;
+                while (low < threshold)
+                {
+                    m = (__uint128_t)next() * n;
+                    low = (uint64_t)m;
+                }
+            }
+            return (uint64_t)(m >> 64);
+        }
+
+        //@brief [l, r] の整数
+        int64_t next_int(int64_t l, int64_t r)
+        {
+            assert(l <= r);
+            return l + (int64_t)next_int((uint64_t)(r - l) + 1);
+        }
+
+        //@brief [0, 1) の実数
+        //@note 上位52bitを仮数部に入れて[1, 2)の実数を作り、1を引く
+        double next_double()
+        {
+            return bit_cast<double>((next() >> 12) | 0x3ff0000000000000ULL) - 1.0;
+        }
+
+        //@brief [l, r) の実数
+        double next_double(double l, double r)
+        {
+            return l + (r - l) * next_double();
+        }
+
+        bool next_bool()
+        {
+            return next() >> 63;
+        }
+
+    private:
+        uint64_t next()
+        {
+            return static_cast<Derived &>(*this)();
+        }
+    };
+
+    //@brief xoshiro256++
+    //@note 周期 2^256 - 1。64bit全体の質がよく、速い
+    class Xoshiro256PlusPlus : public RandomBase<Xoshiro256PlusPlus>
+    {
+    public:
+        explicit Xoshiro256PlusPlus(uint64_t seed = 1)
+        {
+            for (uint64_t &s : s_)
+            {
+                s = split_mix64(seed);
+            }
+        }
+
+        uint64_t operator()()
+        {
+            uint64_t result = rotl(s_[0] + s_[3], 23) + s_[0];
+            uint64_t t = s_[1] << 17;
+            s_[2] ^= s_[0];
+            s_[3] ^= s_[1];
+            s_[1] ^= s_[2];
+            s_[0] ^= s_[3];
+            s_[2] ^= t;
+            s_[3] = rotl(s_[3], 45);
+            return result;
+        }
+
+    private:
+        array<uint64_t, 4> s_;
+    };
+
+    //@brief PCG32 (XSH RR)
+    //@note 状態は64bit。出力は32bitなので、64bitが必要なときは2回呼ぶ
+    class Pcg32 : public RandomBase<Pcg32>
+    {
+    public:
+        explicit Pcg32(uint64_t seed = 1, uint64_t stream = 0) : state_(0), inc_((stream << 1) | 1)
+        {
+            next_u32();
+            state_ += seed;
+            next_u32();
+        }
+
+        uint32_t next_u32()
+        {
+            uint64_t old = state_;
+            state_ = old * 6364136223846793005ULL + inc_;
+            uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+            uint32_t rot = old >> 59;
+            return rotr(xorshifted, rot);
+        }
+
+        uint64_t operator()()
+        {
+            uint64_t high = next_u32();
+            return (high << 32) | next_u32();
+        }
+
+    private:
+        uint64_t state_;
+        uint64_t inc_;
+    };
+
+    //@brief xorshift64
+    //@note 最も軽いが、下位ビットの質は落ちる
+    class Xorshift64 : public RandomBase<Xorshift64>
+    {
+    public:
+        explicit Xorshift64(uint64_t seed = 88172645463325252ULL) : state_(seed == 0 ? 88172645463325252ULL : seed) {}
+
+        uint64_t operator()()
+        {
+            return xorshift64(state_);
+        }
+
+    private:
+        uint64_t state_;
+    };
+
+    //@brief xoshiro128++ を8本並べて、32bitの乱数を8個ずつ作る
+    //@note AVX2が使えれば8本を1回のベクトル演算で進める。使えなくても同じ系列を返す
+    class Xoshiro128PlusPlusX8
+    {
+    public:
+        static constexpr int LANES = 8;
+
+        explicit Xoshiro128PlusPlusX8(uint64_t seed = 1)
+        {
+            for (int lane = 0; lane < LANES; ++lane)
+            {
+                for (int k = 0; k < 4; k += 2)
+                {
+                    uint64_t z = split_mix64(seed);
+                    s_[k][lane] = (uint32_t)z;
+                    s_[k + 1][lane] = (uint32_t)(z >> 32);
+                }
+            }
+        }
+
+        //@brief 8個の乱数を out[0..8) に書く
+        void next8(uint32_t *out)
+        {
+#ifdef __AVX2__
+            __m256i s0 = _mm256_loadu_si256((const __m256i *)s_[0].data());
+            __m256i s1 = _mm256_loadu_si256((const __m256i *)s_[1].data());
+            __m256i s2 = _mm256_loadu_si256((const __m256i *)s_[2].data());
+            __m256i s3 = _mm256_loadu_si256((const __m256i *)s_[3].data());
+            __m256i sum = _mm256_add_epi32(s0, s3);
+            __m256i result = _mm256_add_epi32(_mm256_or_si256(_mm256_slli_epi32(sum, 7), _mm256_srli_epi32(sum, 25)), s0);
+            __m256i t = _mm256_slli_epi32(s1, 9);
+            s2 = _mm256_xor_si256(s2, s0);
+            s3 = _mm256_xor_si256(s3, s1);
+            s1 = _mm256_xor_si256(s1, s2);
+            s0 = _mm256_xor_si256(s0, s3);
+            s2 = _mm256_xor_si256(s2, t);
+            s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11), _mm256_srli_epi32(s3, 21));
+            _mm256_storeu_si256((__m256i *)s_[0].data(), s0);
+            _mm256_storeu_si256((__m256i *)s_[1].data(), s1);
+            _mm256_storeu_si256((__m256i *)s_[2].data(), s2);
+            _mm256_storeu_si256((__m256i *)s_[3].data(), s3);
+            _mm256_storeu_si256((__m256i *)out, result);
+#else
+            for (int lane = 0; lane < LANES; ++lane)
+            {
+                uint32_t &s0 = s_[0][lane], &s1 = s_[1][lane], &s2 = s_[2][lane], &s3 = s_[3][lane];
+                out[lane] = rotl(s0 + s3, 7) + s0;
+                uint32_t t = s1 << 9;
+                s2 ^= s0;
+                s3 ^= s1;
+                s1 ^= s2;
+                s0 ^= s3;
+                s2 ^= t;
+                s3 = rotl(s3, 11);
+            }
+#endif
+        }
+
+        //@brief out[0..n) を32bitの乱数で埋める
+        void fill(uint32_t *out, size_t n)
+        {
+            size_t i = 0;
+            for (; i + LANES <= n; i += LANES)
+            {
+                next8(out + i);
+            }
+            if (i < n)
+            {
+                uint32_t rest[LANES];
+                next8(rest);
+                copy(rest, rest + (n - i), out + i);
+            }
+        }
+
+        //@brief out[0..n) を [0, bound) の整数で埋める
+        //@note 乗算の上位32bitを使う。bound が 2^32 に比べて十分小さければ偏りは無視できる
+        void fill_bounded(uint32_t *out, size_t n, uint32_t bound)
+        {
+            fill(out, n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                out[i] = (uint32_t)(((uint64_t)out[i] * bound) >> 32);
+            }
+        }
+
+        //@brief out[0..n) を [0, 1) の実数で埋める
+        //@note 精度は32bit
+        void fill_double(double *out, size_t n)
+        {
+            uint32_t buffer[LANES];
+            for (size_t i = 0; i < n; i += LANES)
+            {
+                next8(buffer);
+                size_t m = min<size_t>(LANES, n - i);
+                for (size_t k = 0; k < m; ++k)
+                {
+                    out[i + k] = buffer[k] * 0x1.0p-32;
+                }
+            }
+        }
+
+    private:
+        // s_[k][lane] は lane 本目の生成器の k 番目の状態
+        array<array<uint32_t, LANES>, 4> s_;
+    };
+} // namespace random_library
+using namespace random_library;
+#endif
@@ -21,12 +21,46 @@
 // 単にコピペしただけでも使えるが、ymatsuxさんの分割コンパイルツールと合わせると
 // ローカルのコードがすっきりしてオススメ
 // https://github.com/ymatsux/competitive-programming/tree/main/combiner
+// プロファイル
+// THUNDER_PROFILE を define すると、dfs, expand, select, add_leaf, update_root, remove_useless_nodes の区間ごとの時間を集計して終了時に表示する(timer.cpp参照)
+// THUNDER_TRACE を define すると、ターンごとの dfs, add_leaf, update_root, remove_useless_nodes の区間と生きているノード数を記録する(trace.cpp参照)
+// THUNDER_PERF を define すると、dfs, add_leaf, update_root, remove_useless_nodes, commit のハードウェアカウンタ(サイクル数、キャッシュミス、分岐予測ミスなど)をターンごとに表示する(perf_counter.cpp参照)
+// チェックポイント
+// THUNDER_CHECKPOINT を define して Config の checkpoint_path, checkpoint_interval を指定すると、beam_search の途中経過を定期的にファイルに保存し、
+// resume_from_checkpoint を true にして実行し直すと、保存したターンから再開する(checkpoint.cpp参照)
+// 探索のやり直し(beam stack search)
+// Config の backtrack_width を指定すると、ビームに入らなかった候補をターンごとに覚えておき、
+// 実行可能解が見つかる前にビームが途絶えたら、覚えている中で最も深いターンの候補から beam_search を続ける
+// 複数の初期状態
+// beam_search に roots を渡すと、渡した状態を仮想的な根とし、roots[k].action で移る複数の初期状態から1回で探索する
+// 複数のactionをまとめたノード
+// MultiSelectors::push_run で action の列を1つの候補として追加すると、列を持つ1つのノードになる
+// 数ターン分のまとまった遷移を、Action を最も長い列の大きさにせずに表せる。返すパスには列の action が順に並ぶ
+// State が move_forward_run, move_backward_run を実装していれば、列はそれでまとめて遷移する(RunState 参照)
 /**************************************************************/
 #pragma once
 #ifndef SKIP_BEAM_HPP
 #define SKIP_BEAM_HPP
 #include <bits/stdc++.h>
 #include <atcoder/segtree>
+#include "timer.cpp"
+// trace.cpp, perf_counter.cpp, checkpoint.cpp は有効にしたときだけ読み込む。無効なら計測用のマクロは何もしない
+#ifdef THUNDER_TRACE
+#include "trace.cpp"
+#else
+#define THUNDER_TRACE_SCOPE(label)
+#define THUNDER_TRACE_COUNTER(name, value)
+#endif
+#ifdef THUNDER_PERF
+#include "perf_counter.cpp"
+#else
+#define THUNDER_PERF_SCOPE(label)
+#define THUNDER_PERF_TURN_END()
+#endif
+#ifdef THUNDER_CHECKPOINT
+#include "checkpoint.cpp"
+#endif
+#include "random.cpp"
 // 内部のusing namespace std;が他のプログラムを破壊する可能性があるため、
 // ライブラリ全体をnamespaceで囲っている。
 namespace skip_beam_library
@@ -73,6 +107,19 @@ namespace skip_beam_library
             garbage_.push(i);
         }
 
+        // 全ての要素を削除する(メモリは解放しない)
+        void clear()
+        {
+            data_.clear();
+            garbage_ = stack<int>();
+        }
+
+        // 削除されていない要素の個数を得る
+        size_t live_size()
+        {
+            return data_.size() - garbage_.size();
+        }
+
         // 使用した最大のインデックス(+1)を得る
         // この値より少し大きい値をreserveすることでメモリの再割り当てがなくなる
         size_t size()
@@ -80,11 +127,116 @@ namespace skip_beam_library
             return data_.size();
         }
 
+#ifdef THUNDER_CHECKPOINT
+        // チェックポイントに保存する
+        void save(CheckpointWriter &writer) const
+        {
+            writer.write_vector(data_);
+            // stackは中身を直接見られないので、コピーを取り出して底から順に並べる
+            vector<int> garbage;
+            garbage.reserve(garbage_.size());
+            for (stack<int> s = garbage_; !s.empty(); s.pop())
+            {
+                garbage.push_back(s.top());
+            }
+            reverse(garbage.begin(), garbage.end());
+            writer.write_vector(garbage);
+        }
+
+        // save で保存した状態を読み込む
+        void load(CheckpointReader &reader)
+        {
+            size_t capacity = data_.capacity();
+            reader.read_vector(data_);
+            data_.reserve(capacity);
+            vector<int> garbage;
+            reader.read_vector(garbage);
+            garbage_ = stack<int>(deque<int>(garbage.begin(), garbage.end()));
+        }
+#endif
+
     private:
         vector<T> data_;
         stack<int> garbage_;
     };
 
+    // 長さがまちまちな列を1つの配列にまとめて置き、メモリの再利用を行うクラス
+    // 削除した列の場所は、同じ長さの列を追加するときに使い回す
+    template <class T>
+    class RunPool
+    {
+    public:
+        // 配列と同じようにアクセスできる
+        T &operator[](int i)
+        {
+            return data_[i];
+        }
+
+        // 長さ length の列 values を追加し、先頭のインデックスを返す
+        int push(const T *values, size_t length)
+        {
+            if (length < garbage_.size() && !garbage_[length].empty())
+            {
+                int i = garbage_[length].back();
+                garbage_[length].pop_back();
+                copy(values, values + length, data_.begin() + i);
+                return i;
+            }
+            int i = data_.size();
+            data_.insert(data_.end(), values, values + length);
+            return i;
+        }
+
+        // インデックス i から始まる長さ length の列を（見かけ上）削除する
+        void pop(int i, size_t length)
+        {
+            if (garbage_.size() <= length)
+            {
+                garbage_.resize(length + 1);
+            }
+            garbage_[length].push_back(i);
+        }
+
+        // 全ての列を削除する(メモリは解放しない)
+        void clear()
+        {
+            data_.clear();
+            for (vector<int> &garbage : garbage_)
+            {
+                garbage.clear();
+            }
+        }
+
+#ifdef THUNDER_CHECKPOINT
+        // チェックポイントに保存する
+        void save(CheckpointWriter &writer) const
+        {
+            writer.write_vector(data_);
+            writer.write(garbage_.size());
+            for (const vector<int> &garbage : garbage_)
+            {
+                writer.write_vector(garbage);
+            }
+        }
+
+        // save で保存した状態を読み込む
+        void load(CheckpointReader &reader)
+        {
+            reader.read_vector(data_);
+            garbage_.resize(reader.read<size_t>());
+            for (vector<int> &garbage : garbage_)
+            {
+                reader.read_vector(garbage);
+            }
+        }
+#endif
+
+    private:
+        vector<T> data_;
+        // garbage_[length] は削除した長さ length の列の先頭のインデックス
+        vector<vector<int>> garbage_;
+    };
+
     // 連想配列
     // Keyにハッシュ関数を適用しない
     // open addressing with linear probing
@@ -146,6 +298,247 @@ namespace skip_beam_library
         vector<pair<Key, T>> data_;
     };
 
+    // 複数のパスを、共通の接頭辞を共有したまま保持するトライ木
+    // nodes[v] = {親のノード(根の直下なら-1), action}
+    // k番目のパスは ends[k] から親をたどったactionを逆順に並べたもの
+    // k本のパスをそれぞれvectorで持つ場合と違い、共通部分をコピーしない
+    template <typename Action, typename Cost>
+    struct PathTrie
+    {
+        vector<pair<int, Action>> nodes;
+        vector<int> ends;
+        vector<Cost> costs;
+
+        // 保持しているパスの本数
+        size_t size() const
+        {
+            return ends.size();
+        }
+
+        // k番目のパスを復元する
+        vector<Action> get_path(size_t k) const
+        {
+            vector<Action> path;
+            for (int v = ends[k]; v != -1; v = nodes[v].first)
+            {
+                path.push_back(nodes[v].second);
+            }
+            reverse(path.begin(), path.end());
+            return path;
+        }
+
+        // parentを親とするノードを追加し、そのインデックスを返す
+        int add_node(int parent, const Action &action)
+        {
+            nodes.push_back({parent, action});
+            return nodes.size() - 1;
+        }
+
+        // 2つのトライ木に含まれるパスのうち、コストがよい順にk本を残したトライ木を返す
+        // 使われなくなったノードはコピーしない
+        static PathTrie merge_top_k(const PathTrie &a, const PathTrie &b, size_t k)
+        {
+            vector<tuple<Cost, int, int>> order;
+            for (size_t i = 0; i < a.size(); ++i)
+            {
+                order.emplace_back(a.costs[i], 0, i);
+            }
+            for (size_t i = 0; i < b.size(); ++i)
+            {
+                order.emplace_back(b.costs[i], 1, i);
+            }
+            k = min(k, order.size());
+            partial_sort(order.begin(), order.begin() + k, order.end());
+
+            PathTrie ret;
+            vector<int> remap_a(a.nodes.size(), -1);
+            vector<int> remap_b(b.nodes.size(), -1);
+            vector<int> stack;
+            for (size_t i = 0; i < k; ++i)
+            {
+                auto [cost, source, index] = order[i];
+                const PathTrie &trie = source == 0 ? a : b;
+                vector<int> &remap = source == 0 ? remap_a : remap_b;
+
+                // まだコピーしていない祖先を集めてから、根に近い順にコピーする
+                int v = trie.ends[index];
+                while (v != -1 && remap[v] == -1)
+                {
+                    stack.push_back(v);
+                    v = trie.nodes[v].first;
+                }
+                int parent = v == -1 ? -1 : remap[v];
+                while (!stack.empty())
+                {
+                    int u = stack.back();
+                    stack.pop_back();
+                    parent = remap[u] = ret.add_node(parent, trie.nodes[u].second);
+                }
+                ret.ends.push_back(parent);
+                ret.costs.push_back(cost);
+            }
+            return ret;
+        }
+    };
+
+    // ビームに入らなかった候補を、ターンごとに覚えておくクラス(beam stack search)
+    // layers_[t] は t ターン目の候補のうち、ビームに入らなかったものの中でよいもの最大 width 個
+    // 候補は根からのパスをトライ木で持つので、探索木から消えた後でもそこから探索をやり直せる
+    // Leaf は葉に持たせる値(コスト、またはコストとハッシュ値の組)で、小さいほどよい
+    template <typename Action, typename Leaf>
+    class PrunedFrontier
+    {
+    public:
+        using Layer = PathTrie<Action, Leaf>;
+
+        explicit PrunedFrontier(size_t width) : width_(width) {}
+
+        bool enabled() const
+        {
+            return width_ > 0;
+        }
+
+        // turn ターン目にビームに入らなかった候補のパスと、葉に持たせる値を追加する
+        // leaves[k] は paths の k 番目のパスに対応する
+        // 同じターンに既に覚えている候補があれば、合わせてよいもの width 個を残す
+        template <typename Cost>
+        void record(int turn, PathTrie<Action, Cost> &&paths, vector<Leaf> &&leaves)
+        {
+            if ((int)layers_.size() <= turn)
+            {
+                layers_.resize(turn + 1);
+            }
+            Layer layer;
+            layer.nodes = move(paths.nodes);
+            layer.ends = move(paths.ends);
+            layer.costs = move(leaves);
+            if (layers_[turn].size() == 0 && layer.size() <= width_)
+            {
+                layers_[turn] = move(layer);
+            }
+            else
+            {
+                layers_[turn] = Layer::merge_top_k(layers_[turn], layer, width_);
+            }
+        }
+
+        // turn ターン目以前で候補が残っている最も深いターンを探し、その候補を全て取り出してlayerに書く
+        // 取り出したターンを返す。候補が残っていなければ-1を返す
+        int pop(int turn, Layer &layer)
+        {
+            for (int t = min(turn, (int)layers_.size() - 1); t >= 0; --t)
+            {
+                if (layers_[t].size() > 0)
+                {
+                    layer = move(layers_[t]);
+                    layers_[t] = Layer();
+                    return t;
+                }
+            }
+            return -1;
+        }
+
+#ifdef THUNDER_CHECKPOINT
+        // チェックポイントに保存する
+        void save(CheckpointWriter &writer) const
+        {
+            writer.write(layers_.size());
+            for (const Layer &layer : layers_)
+            {
+                writer.write_vector(layer.nodes);
+                writer.write_vector(layer.ends);
+                writer.write_vector(layer.costs);
+            }
+        }
+
+        // save で保存した状態を読み込む
+        void load(CheckpointReader &reader)
+        {
+            layers_.resize(reader.read<size_t>());
+            for (Layer &layer : layers_)
+            {
+                reader.read_vector(layer.nodes);
+                reader.read_vector(layer.ends);
+                reader.read_vector(layer.costs);
+            }
+        }
+#endif
+
+    private:
+        size_t width_;
+        vector<Layer> layers_;
+    };
+
+    // 整数のコストの列から、小さい順に k 個を選ぶときの境目を求める基数選択
+    // 最小値との差を上の桁から11bitずつヒストグラムにして、k 個目が入る桶だけを次の桁で数え直す
+    // 比較による並べ替えをせずに配列を先頭から順に読むだけなので、要素数に対して線形時間
+    // コストの幅が狭ければ桁数が少なく済み、ほとんどの場合は数回読むだけで終わる
+    template <class Cost>
+    class RadixSelect
+    {
+    public:
+        // 戻り値の threshold より小さいものは全て選び、threshold と等しい num_ties 個のうち num_taken 個を選ぶと k 個になる
+        struct Result
+        {
+            Cost threshold;
+            size_t num_taken;
+            size_t num_ties;
+        };
+
+        RadixSelect() : histogram_(1 << DIGIT_BITS) {}
+
+        // 1 <= k <= n とする
+        Result select(const Cost *costs, size_t n, size_t k)
+        {
+            using Key = make_unsigned_t<Cost>;
+            Cost lo = costs[0];
+            Cost hi = costs[0];
+            for (size_t i = 1; i < n; ++i)
+            {
+                lo = min(lo, costs[i]);
+                hi = max(hi, costs[i]);
+            }
+            // 符号付きでも、符号なしに直してから引けば最小値との差になる
+            Key range = (Key)((Key)hi - (Key)lo);
+            if (range == 0)
+            {
+                return {lo, k, n};
+            }
+            int shift = (bit_width(range) - 1) / DIGIT_BITS * DIGIT_BITS;
+            // 上の桁から決めていった、k 個目の最小値との差
+            Key prefix = 0;
+            while (true)
+            {
+                fill(histogram_.begin(), histogram_.end(), 0);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    Key key = (Key)((Key)costs[i] - (Key)lo) >> shift;
+                    // 決めた上の桁が一致するものだけを数える
+                    if ((key >> DIGIT_BITS) == prefix)
+                    {
+                        ++histogram_[key & DIGIT_MASK];
+                    }
+                }
+                size_t digit = 0;
+                while (histogram_[digit] < k)
+                {
+                    k -= histogram_[digit++];
+                }
+                prefix = (prefix << DIGIT_BITS) | digit;
+                if (shift == 0)
+                {
+                    return {(Cost)((Key)lo + prefix), k, histogram_[digit]};
+                }
+                shift -= DIGIT_BITS;
+            }
+        }
+
+    private:
+        static constexpr int DIGIT_BITS = 11;
+        static constexpr size_t DIGIT_MASK = (1 << DIGIT_BITS) - 1;
+        vector<size_t> histogram_;
+    };
+
     template <typename HashType>
     concept HashConcept = requires(HashType hash) {
         { std::is_unsigned_v<HashType> };
@@ -164,6 +557,15 @@ namespace skip_beam_library
                                { state.move_backward(std::declval<ActionType>()) } -> same_as<void>;
                            };
 
+    // 長さ2以上の action の列(MultiSelectors::push_run)をまとめて遷移する State の関数(省略可)
+    // 列の action を順に move_forward(戻すときは逆順に move_backward)した場合と同じ状態にする
+    // 実装しなければ、ライブラリが1つずつ move_forward, move_backward を呼ぶ
+    template <typename StateType, typename ActionType>
+    concept RunState = requires(StateType state, const ActionType *actions, size_t length) {
+        { state.move_forward_run(actions, length) } -> same_as<void>;
+        { state.move_backward_run(actions, length) } -> same_as<void>;
+    };
+
     template <HashConcept Hash, typename Action, CostConcept Cost, template <typename> class State>
     struct BeamSearch
     {
@@ -174,6 +576,10 @@ namespace skip_beam_library
             Hash hash;
             int parent;
             Cost cost;
+            // 長さ2以上の action の列を1つの候補にしたときの、列の位置と長さ(push_run 参照)
+            // 列の先頭は action にも入れておく
+            int run = -1;
+            int run_length = 1;
 
             Candidate(Action action, Hash hash, int parent, Cost cost) : action(action),
                                                                          hash(hash),
@@ -188,6 +594,50 @@ namespace skip_beam_library
             size_t beam_width;
             size_t nodes_capacity;
             uint32_t hash_map_capacity;
+            // 制限時間(timer_library::timer の経過秒数)
+            // これを過ぎたターンを最終ターンとして扱う
+            double time_limit = numeric_limits<double>::infinity();
+            // 0以外を指定すると、ビームの末尾でコストが等しい候補のどちらを残すかをこの値をシードとした乱数で決める
+            // 並列に独立なビームサーチを行うときに、インスタンスごとに変えると探索が多様になる
+            uint64_t tie_break_seed = 0;
+            // ターンごとのビーム幅を返す関数。省略するとbeam_widthで一定になる
+            // 配列で指定したい場合は [&](int turn) { return widths[turn]; } のように渡す
+            // 返す値は1以上beam_width以下にする。メモリはbeam_widthの分だけ確保し、各ターンはその幅だけ使う
+            function<size_t(int)> beam_width_schedule = nullptr;
+            // 途中経過を保存するファイル
+            string checkpoint_path = "";
+            // 0以外を指定すると、beam_search で checkpoint_interval ターンごとに checkpoint_path に保存する
+            // checkpoint_interval, resume_from_checkpoint は THUNDER_CHECKPOINT を define したときだけ指定できる
+            // 保存にはノード数に比例する時間がかかるので、1ターンの時間に比べて十分大きくする
+            int checkpoint_interval = 0;
+            // trueにすると、checkpoint_path があればそのターンから beam_search を再開する
+            // 保存したときと同じ入力、同じ設定(beam_widthなど)で実行する必要がある
+            // 制限時間(time_limit)は再開してからの経過時間で判定する
+            bool resume_from_checkpoint = false;
+            // 0以外を指定すると、各ターンにビームに入らなかった候補のうちよいものをこの個数まで覚えておき、
+            // 実行可能解が見つかる前にビームが途絶えたとき(候補がなくなったとき)に、
+            // 覚えている中で最も深いターンの候補から探索をやり直す(beam stack search)
+            // Selectorはビーム幅がこの個数だけ広いのと同じだけ重くなり、覚える候補の根からのパスを毎ターン計算する
+            // beam_search だけで使う。覚えた候補はチェックポイントにも保存する
+            size_t backtrack_width = 0;
+            // backtrack_width を指定したときに0以外を指定すると、ビーム内の最もよいコストがこのターン数だけ
+            // 更新されなかったときも行き詰まったとみなして、今より浅いターンの候補から探索をやり直す
+            int backtrack_stall_turns = 0;
+            // 探索をやり直す回数の上限
+            int max_backtracks = numeric_limits<int>::max();
+
+            // turnターン目のビーム幅
+            // max_turn以降のターンはmax_turn - 1ターン目と同じ幅にする
+            size_t get_beam_width(int turn) const
+            {
+                if (!beam_width_schedule)
+                {
+                    return beam_width;
+                }
+                size_t width = beam_width_schedule(min(turn, max_turn - 1));
+                assert(1 <= width && width <= beam_width);
+                return width;
+            }
         };
 
         static pair<Cost, int> max_func(pair<Cost, int> a, pair<Cost, int> b)
@@ -212,6 +662,34 @@ namespace skip_beam_library
             max_func,
             min_func>;
 
+        // 複数の初期状態から探索するときの、初期状態を表す構造体
+        // beam_search に渡す root を仮想的な根とし、action で各初期状態に移る
+        // 根の分だけ State の深さが1段増えるので、UndoLog(max_turn + 1) のように深さで容量を決めるものは1つ多く確保する
+        struct Root
+        {
+            Action action;
+            Cost cost;
+            Hash hash;
+        };
+
+        // 複数のパスをまとめて返すときの型
+        using Paths = PathTrie<Action, Cost>;
+
+        // ビームに入らなかった候補を覚えておく型(backtrack_width 参照)
+        using Frontier = PrunedFrontier<Action, pair<Cost, Hash>>;
+
+        // 評価がよい順に最大k個の候補を返す
+        static vector<Candidate> select_top_k(const vector<Candidate> &candidates, size_t k)
+        {
+            vector<Candidate> ret = candidates;
+            k = min(k, ret.size());
+            partial_sort(ret.begin(), ret.begin() + k, ret.end(),
+                         [](const Candidate &a, const Candidate &b)
+                         { return a.cost < b.cost; });
+            ret.erase(ret.begin() + k, ret.end());
+            return ret;
+        }
+
         // ノードの候補から実際に追加するものを選ぶクラス
         // ビーム幅の個数だけ、評価がよいものを選ぶ
         // ハッシュ値が一致したものについては、評価がよいほうのみを残す
@@ -220,26 +698,65 @@ namespace skip_beam_library
         public:
             explicit Selector(const Config &config) : hash_to_index_(config.hash_map_capacity)
             {
-                beam_width = config.beam_width;
-                candidates_.reserve(beam_width);
+                tie_break_state_ = config.tie_break_seed;
+                // backtrack_width を指定したときは、ビームに入らなかった候補もその個数だけ一緒に選べるようにしておく
+                beam_width = config.beam_width + config.backtrack_width;
+                // Cost が整数型なら、segment treeの代わりに基数選択でビームを選ぶので、ビーム幅の2倍まで候補を溜める(radix_shrink 参照)
+                candidates_.reserve(is_integral_v<Cost> ? 2 * beam_width : beam_width);
                 full_ = false;
                 st_original_.resize(beam_width);
             }
 
+            // このSelectorが受け持つターンのビーム幅を変える
+            // 候補を持っていないとき(構築直後かclearの後)に呼ぶ。幅は構築時のbeam_width以下にする
+            // segment treeはこの幅で構築するので、幅が狭いターンはその分だけ軽くなる
+            void set_beam_width(size_t width)
+            {
+                assert(candidates_.empty() && 1 <= width && width <= candidates_.capacity());
+                beam_width = width;
+                st_original_.resize(width);
+            }
+
             // 候補を追加する
             // ターン数最小化型の問題で、candidateによって実行可能解が得られる場合にのみ finished = true とする
             // ビーム幅分の候補をCandidateを追加したときにsegment treeを構築する
             bool push(const Action &action, const Cost cost, const Hash hash, const int parent, bool finished)
             {
+                return push_run(&action, 1, cost, hash, parent, finished);
+            }
+
+            // 長さ length の action の列 actions を1つの候補として追加する
+            // 列は候補として残したときにだけ Selector 内にコピーするので、足切りされる候補ではコピーしない
+            bool push_run(const Action *actions, size_t length, const Cost cost, const Hash hash, const int parent, bool finished)
+            {
+                THUNDER_PROFILE_SCOPE("select");
                 if (finished)
                 {
-                    finished_candidates_.emplace_back(Candidate(action, hash, parent, cost));
+                    if (finished_candidates_.empty() || cost < finished_candidates_[best_finished_].cost)
+                    {
+                        best_finished_ = finished_candidates_.size();
+                    }
+                    finished_candidates_.emplace_back(make_candidate(actions, length, hash, parent, cost));
                     return true;
                 }
+                if constexpr (is_integral_v<Cost>)
+                {
+                    // 一度絞った後は、境目のコストより大きい候補は入らない
+                    // 境目と等しい候補は、tie_break_seed を指定したときだけ入れておき、絞るときに乱数で選ぶ
+                    if (full_ && (cost > cutoff_ || (cost == cutoff_ && tie_break_state_ == 0)))
+                    {
+                        return false;
+                    }
+                    return push_radix(actions, length, cost, hash, parent);
+                }
                 if (full_ && cost >= st_.all_prod().first)
                 {
                     // 保持しているどの候補よりもコストが小さくないとき
-                    return false;
+                    // コストが等しいときは、tie_break_seed が指定されていれば乱数で入れ替えるか決める
+                    if (cost > st_.all_prod().first || !tie_break(cost))
+                    {
+                        return false;
+                    }
                 }
                 int i = 0;
                 auto [valid, index] = hash_to_index_.get_index(hash);
@@ -254,7 +771,8 @@ namespace skip_beam_library
                         if (cost < candidates_[j].cost)
                         {
                             // 更新する場合
-                            candidates_[j] = Candidate(action, hash, parent, cost);
+                            candidates_[j] = make_candidate(actions, length, hash, parent, cost);
+                            update_best(j);
                             if (full_)
                             {
                                 st_.set(j, {cost, j});
@@ -269,14 +787,16 @@ namespace skip_beam_library
                     // segment treeが構築されている場合
                     int j = st_.all_prod().second;
                     hash_to_index_.set(i, hash, j);
-                    candidates_[j] = Candidate(action, hash, parent, cost);
+                    candidates_[j] = make_candidate(actions, length, hash, parent, cost);
+                    update_best(j);
                     st_.set(j, {cost, j});
                 }
                 else
                 {
                     // segment treeが構築されていない場合
                     hash_to_index_.set(i, hash, candidates_.size());
-                    candidates_.emplace_back(Candidate(action, hash, parent, cost));
+                    candidates_.emplace_back(make_candidate(actions, length, hash, parent, cost));
+                    update_best(candidates_.size() - 1);
 
                     if (candidates_.size() == beam_width)
                     {
@@ -300,30 +820,157 @@ namespace skip_beam_library
             }
 
             // 実行可能解に到達する「候補」を返す
-            vector<Candidate> get_finished_candidates() const
+            const vector<Candidate> &get_finished_candidates() const
             {
                 return finished_candidates_;
             }
 
+            // 実行可能解に到達する「候補」のうち最も評価がよいものを返す
+            // pushのたびに更新しているのでO(1)
+            const Candidate &get_best_finished_candidate() const
+            {
+                assert(have_finished());
+                return finished_candidates_[best_finished_];
+            }
+
+            // 候補の action の列の先頭を返す。列の長さは candidate.run_length
+            const Action *get_run(const Candidate &candidate) const
+            {
+                return candidate.run == -1 ? &candidate.action : runs_.data() + candidate.run;
+            }
+
+            // 候補の action の列を path の末尾に追加する
+            void append_run(const Candidate &candidate, vector<Action> &path) const
+            {
+                const Action *run = get_run(candidate);
+                path.insert(path.end(), run, run + candidate.run_length);
+            }
+
             // 最も評価がよい候補を返す
-            Candidate calc_best_candidate()
+            // pushのたびに更新しているのでO(1)
+            const Candidate &calc_best_candidate() const
             {
-                int best = 0;
-                for (size_t i = 0; i < candidates_.size(); ++i)
+                assert(best_ != -1);
+                return candidates_[best_];
+            }
+
+            // 評価がよい順に最大k個の候補を返す
+            vector<Candidate> calc_top_k_candidates(size_t k) const
+            {
+                return select_top_k(candidates_, k);
+            }
+
+            // 実行可能解に到達する「候補」を評価がよい順に最大k個返す
+            vector<Candidate> calc_top_k_finished_candidates(size_t k) const
+            {
+                return select_top_k(finished_candidates_, k);
+            }
+
+            // 選んだ候補を、コストがよい width 個とそれ以外に分け、それ以外を返す
+            // select() はよい width 個だけを返すようになる
+            // backtrack_width を指定したときに、ビームに入らなかった候補を取り出すために使う
+            // segment treeは作り直さないので、呼んだ後は clear するまで push しない
+            const vector<Candidate> &split_pruned(size_t width)
+            {
+                pruned_.clear();
+                if (candidates_.size() <= width)
+                {
+                    return pruned_;
+                }
+                nth_element(candidates_.begin(), candidates_.begin() + width, candidates_.end(),
+                            [](const Candidate &a, const Candidate &b)
+                            { return a.cost < b.cost; });
+                pruned_.assign(candidates_.begin() + width, candidates_.end());
+                candidates_.erase(candidates_.begin() + width, candidates_.end());
+                // 並べ替えたので、最もよい候補の添字を求め直す
+                best_ = -1;
+                for (size_t j = 0; j < candidates_.size(); ++j)
+                {
+                    update_best(j);
+                }
+                return pruned_;
+            }
+
+            // predを満たす候補を取り除く
+            template <class Predicate>
+            void remove_if(Predicate pred)
+            {
+                vector<Candidate> candidates = candidates_;
+                vector<Action> runs = runs_;
+                clear();
+                for (const Candidate &candidate : candidates)
                 {
-                    if (candidates_[i].cost < candidates_[best].cost)
+                    if (!pred(candidate))
                     {
-                        best = i;
+                        const Action *run = candidate.run == -1 ? &candidate.action : runs.data() + candidate.run;
+                        push_run(run, candidate.run_length, candidate.cost, candidate.hash, candidate.parent, false);
                     }
                 }
-                return candidates_[best];
+                erase_if(finished_candidates_, pred);
+                calc_best_finished();
+            }
+
+#ifdef THUNDER_CHECKPOINT
+            // チェックポイントに保存する
+            void save(CheckpointWriter &writer) const
+            {
+                writer.write(beam_width);
+                writer.write_vector(candidates_);
+                writer.write_vector(finished_candidates_);
+                writer.write_vector(runs_);
+                writer.write(tie_break_state_);
+                writer.write(tie_cost_);
+                writer.write(tie_count_);
+            }
+
+            // save で保存した状態を読み込む
+            // 構築直後に呼ぶ。候補を保存したときと同じ順番で追加し直すので、segment treeも同じものになる
+            void load(CheckpointReader &reader)
+            {
+                set_beam_width(reader.read<size_t>());
+                vector<Candidate> candidates;
+                reader.read_vector(candidates);
+                reader.read_vector(finished_candidates_);
+                calc_best_finished();
+                // 実行可能解の候補は保存したときの列の位置を指しているので、列はそのまま読み込む
+                vector<Action> runs;
+                reader.read_vector(runs);
+                runs_ = runs;
+                for (const Candidate &candidate : candidates)
+                {
+                    const Action *run = candidate.run == -1 ? &candidate.action : runs.data() + candidate.run;
+                    push_run(run, candidate.run_length, candidate.cost, candidate.hash, candidate.parent, false);
+                }
+                reader.read(tie_break_state_);
+                reader.read(tie_cost_);
+                reader.read(tie_count_);
+            }
+#endif
+
+            // 候補を追加し終えたら呼び、選んだ候補をビーム幅の個数に絞る
+            // 基数選択を使うときは、ビーム幅の2倍まで候補を溜めてから絞っているので、最後にもう一度絞る
+            void shrink_to_beam()
+            {
+                if constexpr (is_integral_v<Cost>)
+                {
+                    radix_shrink();
+                }
             }
 
             void clear()
             {
                 candidates_.clear();
+                best_ = -1;
+                radix_costs_.clear();
+                radix_slots_.clear();
                 hash_to_index_.clear();
                 full_ = false;
+                tie_count_ = 0;
+                // 実行可能解の候補が残っているときは、その列を消さない
+                if (finished_candidates_.empty())
+                {
+                    runs_.clear();
+                }
             }
 
         private:
@@ -333,7 +980,165 @@ namespace skip_beam_library
             bool full_;
             vector<pair<Cost, int>> st_original_;
             MaxSegtree st_;
+            uint64_t tie_break_state_;
+            // tie_break で数えている、最も悪い候補のコストとそのコストの候補の個数
+            Cost tie_cost_{};
+            size_t tie_count_ = 0;
+            // 基数選択でビームを選ぶときに使う(radix_shrink 参照)
+            RadixSelect<Cost> radix_;
+            // 候補のコストとハッシュ表での位置(candidates_ と同じ順番)
+            vector<Cost> radix_costs_;
+            vector<int> radix_slots_;
+            // 一度絞った後の、残した候補の最大のコスト
+            Cost cutoff_;
+
+            // 基数選択を使うときのpush
+            // 候補をビーム幅の2倍まで溜め、溜まったらコストが小さい順にビーム幅の個数に絞る
+            // 絞るたびに境目のコストが下がるので、segment treeを使う場合と同じく悪い候補はすぐに捨てられる
+            bool push_radix(const Action *actions, size_t length, Cost cost, Hash hash, int parent)
+            {
+                auto [valid, i] = hash_to_index_.get_index(hash);
+                if (valid)
+                {
+                    // 絞ったときに取り除いた候補の添字は、範囲外か別の候補を指している
+                    size_t j = hash_to_index_.get(i);
+                    if (j < candidates_.size() && hash == candidates_[j].hash)
+                    {
+                        // ハッシュ値が等しいものが存在しているとき
+                        if (cost < candidates_[j].cost)
+                        {
+                            candidates_[j] = make_candidate(actions, length, hash, parent, cost);
+                            radix_costs_[j] = cost;
+                            update_best(j);
+                            return true;
+                        }
+                        return false;
+                    }
+                }
+                int j = candidates_.size();
+                hash_to_index_.set(i, hash, j);
+                candidates_.emplace_back(make_candidate(actions, length, hash, parent, cost));
+                radix_costs_.push_back(cost);
+                radix_slots_.push_back(i);
+                update_best(j);
+                if (candidates_.size() == 2 * beam_width)
+                {
+                    radix_shrink();
+                }
+                return true;
+            }
+
+            // 基数選択で、コストが小さい順にビーム幅の個数だけ候補を残す
+            // コストが等しい候補は先に追加したほうを残し、tie_break_seed を指定したときは乱数で選ぶ
+            // 残す候補を前に詰めるだけなので、候補は追加した順に並んだまま
+            void radix_shrink()
+            {
+                if (candidates_.size() <= beam_width)
+                {
+                    return;
+                }
+                auto [threshold, num_taken, num_ties] = radix_.select(radix_costs_.data(), candidates_.size(), beam_width);
+                size_t m = 0;
+                best_ = -1;
+                for (size_t i = 0; i < candidates_.size(); ++i)
+                {
+                    Cost cost = radix_costs_[i];
+                    if (cost > threshold)
+                    {
+                        continue;
+                    }
+                    if (cost == threshold)
+                    {
+                        // 残りの num_ties 個から num_taken 個を選ぶ
+                        bool take = tie_break_state_ == 0 ? num_taken > 0 : xorshift64(tie_break_state_) % num_ties < num_taken;
+                        --num_ties;
+                        if (!take)
+                        {
+                            continue;
+                        }
+                        --num_taken;
+                    }
+                    candidates_[m] = candidates_[i];
+                    radix_costs_[m] = cost;
+                    radix_slots_[m] = radix_slots_[i];
+                    hash_to_index_.set(radix_slots_[m], candidates_[m].hash, m);
+                    update_best(m);
+                    ++m;
+                }
+                candidates_.erase(candidates_.begin() + m, candidates_.end());
+                radix_costs_.resize(m);
+                radix_slots_.resize(m);
+                cutoff_ = threshold;
+                full_ = true;
+            }
+
+            // 最も悪い候補とコストが等しい候補 cost で入れ替えるかどうかを返す
+            // そのコストの候補が来るのが n 個目なら、確率 1/n で入れ替える(reservoir sampling)
+            // 同じ枠を争った候補はどれも同じ確率で残るので、基数選択で境目の候補を乱数で選ぶのと揃う
+            // tie_break_seed が0なら常に入れ替えない
+            bool tie_break(const Cost &cost)
+            {
+                if (tie_break_state_ == 0)
+                {
+                    return false;
+                }
+                if (tie_count_ == 0 || cost != tie_cost_)
+                {
+                    // 最も悪い候補のコストは下がる一方なので、違うコストになったら数え直す
+                    // 枠を持っている候補を1個目とする
+                    tie_cost_ = cost;
+                    tie_count_ = 1;
+                }
+                ++tie_count_;
+                return xorshift64(tie_break_state_) % tie_count_ == 0;
+            }
             vector<Candidate> finished_candidates_;
+            size_t best_finished_ = 0;
+            // split_pruned で分けた、ビームに入らなかった候補
+            vector<Candidate> pruned_;
+            // 長さ2以上の候補の action の列を並べたもの
+            vector<Action> runs_;
+            // 最もよい候補の添字(候補がなければ-1)
+            int best_ = -1;
+
+            // j番目の候補を書き換えた後に呼び、最もよい候補の添字を更新する
+            // 書き換えるのは同じ盤面でコストがよくなるときか、コストが最大の候補を追い出すときだけで、
+            // どの添字のコストも大きくならないので、最もよい候補を探し直す必要はない
+            // コストが等しいときは添字が小さいほうを選ぶ
+            void update_best(int j)
+            {
+                if (best_ == -1 || candidates_[j].cost < candidates_[best_].cost ||
+                    (candidates_[j].cost == candidates_[best_].cost && j < best_))
+                {
+                    best_ = j;
+                }
+            }
+
+            // 実行可能解の候補を取り除いたときに、最もよいものの添字を求め直す
+            void calc_best_finished()
+            {
+                best_finished_ = 0;
+                for (size_t i = 0; i < finished_candidates_.size(); ++i)
+                {
+                    if (finished_candidates_[i].cost < finished_candidates_[best_finished_].cost)
+                    {
+                        best_finished_ = i;
+                    }
+                }
+            }
+
+            // 候補を作る。長さ2以上の列は runs_ の末尾にコピーし、その位置を候補に持たせる
+            Candidate make_candidate(const Action *actions, size_t length, Hash hash, int parent, Cost cost)
+            {
+                Candidate candidate(actions[0], hash, parent, cost);
+                if (length > 1)
+                {
+                    candidate.run = runs_.size();
+                    candidate.run_length = length;
+                    runs_.insert(runs_.end(), actions, actions + length);
+                }
+                return candidate;
+            }
 
             void construct_segment_tree()
             {
@@ -350,21 +1155,32 @@ namespace skip_beam_library
         class MultiSelectors
         {
         public:
-            explicit MultiSelectors(const Config &config) : config_(config)
+            // extra_width を指定すると、各ターンのビーム幅よりその個数だけ広く選ぶ(backtrack_width 参照)
+            explicit MultiSelectors(const Config &config, size_t extra_width = 0) : config_(config), extra_width_(extra_width)
             {
                 step_max_ = 1;
+                front_turn_ = 0;
             }
 
             // 候補を追加する
             // ターン数最小化型の問題で、candidateによって実行可能解が得られる場合にのみ finished = true とする
             // step は何ターン後に遷移するかを表す
             bool push(Action action, Cost cost, Hash hash, int parent, bool finished, size_t step)
+            {
+                return push_run(&action, 1, cost, hash, parent, finished, step);
+            }
+
+            // 長さ length の action の列 actions を、step ターン後に遷移する1つの候補として追加する
+            // 選ばれると列をまとめて持つ1つのノードになり、パスを復元すると列の action が順に並ぶ
+            // step を列の長さと揃える必要はない
+            bool push_run(const Action *actions, size_t length, Cost cost, Hash hash, int parent, bool finished, size_t step)
             {
                 while (selectors_.size() < step)
                 {
                     selectors_.emplace_back(Selector(config_));
+                    selectors_.back().set_beam_width(config_.get_beam_width(front_turn_ + selectors_.size() - 1) + extra_width_);
                 }
-                if (selectors_[step - 1].push(action, cost, hash, parent, finished))
+                if (selectors_[step - 1].push_run(actions, length, cost, hash, parent, finished))
                 {
                     if (step > step_max_)
                     {
@@ -391,6 +1207,8 @@ namespace skip_beam_library
             {
                 Selector ret = move(selectors_.front());
                 selectors_.pop_front();
+                ++front_turn_;
+                ret.shrink_to_beam();
                 return ret;
             }
 
@@ -398,12 +1216,75 @@ namespace skip_beam_library
             void push_selector(Selector &&selector)
             {
                 selector.clear();
+                selector.set_beam_width(config_.get_beam_width(front_turn_ + selectors_.size()) + extra_width_);
                 selectors_.push_back(move(selector));
             }
 
+            // 後のターンに追加する候補(実行可能解を含む)が残っているか
+            bool has_candidates() const
+            {
+                for (const Selector &selector : selectors_)
+                {
+                    if (!selector.select().empty() || selector.have_finished())
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // 全ての候補を捨て、front_turn ターン目の候補から持ち直す
+            // 候補が1つも追加されなくても pop_selector できるように、空のSelectorを1つ置いておく
+            void restart(int front_turn)
+            {
+                selectors_.clear();
+                front_turn_ = front_turn;
+                selectors_.emplace_back(Selector(config_));
+                selectors_.back().set_beam_width(config_.get_beam_width(front_turn_) + extra_width_);
+            }
+
+            // 保持している全てのSelectorから、predを満たす候補を取り除く
+            template <class Predicate>
+            void remove_candidates_if(Predicate pred)
+            {
+                for (Selector &selector : selectors_)
+                {
+                    selector.remove_if(pred);
+                }
+            }
+
+#ifdef THUNDER_CHECKPOINT
+            // チェックポイントに保存する
+            void save(CheckpointWriter &writer) const
+            {
+                writer.write(front_turn_);
+                writer.write(selectors_.size());
+                for (const Selector &selector : selectors_)
+                {
+                    selector.save(writer);
+                }
+            }
+
+            // save で保存した状態を読み込む
+            void load(CheckpointReader &reader)
+            {
+                reader.read(front_turn_);
+                size_t num_selectors = reader.read<size_t>();
+                selectors_.clear();
+                for (size_t i = 0; i < num_selectors; ++i)
+                {
+                    selectors_.emplace_back(Selector(config_));
+                    selectors_.back().load(reader);
+                }
+            }
+#endif
+
         private:
             Config config_;
+            size_t extra_width_;
+            // selectors_[k] は front_turn_ + k ターン目に追加するノードの候補を持つ
             deque<Selector> selectors_;
+            int front_turn_;
             size_t step_max_;
         };
 
@@ -416,6 +1297,8 @@ namespace skip_beam_library
             int parent, child, left, right;
             bool active;
             int remove_check_turn;
+            // 長さ2以上の action の列を持つときの、Tree 内での列の位置と長さ
+            int run, run_length;
 
             // 根のコンストラクタ
             Node(Action action, Cost cost, Hash hash) : action(action),
@@ -426,7 +1309,9 @@ namespace skip_beam_library
                                                         left(-1),
                                                         right(-1),
                                                         active(true),
-                                                        remove_check_turn(-1) {}
+                                                        remove_check_turn(-1),
+                                                        run(-1),
+                                                        run_length(1) {}
 
             // 通常のコンストラクタ
             Node(const Candidate &candidate, int right) : action(candidate.action),
@@ -437,7 +1322,9 @@ namespace skip_beam_library
                                                           left(-1),
                                                           right(right),
                                                           active(true),
-                                                          remove_check_turn(-1) {}
+                                                          remove_check_turn(-1),
+                                                          run(-1),
+                                                          run_length(1) {}
         };
 
         // 二重連鎖木に対する操作をまとめたクラス
@@ -448,11 +1335,15 @@ namespace skip_beam_library
             {
                 nodes_.reserve(nodes_capacity);
                 root_ = nodes_.push(root);
+                committed_ = root_;
             }
 
             // 状態を更新しながら深さ優先探索を行い、次のノードの候補を全てselectorに追加する
             void dfs(MultiSelectors &multi_selectors, int turn)
             {
+                THUNDER_PROFILE_SCOPE("dfs");
+                THUNDER_TRACE_SCOPE("dfs");
+                THUNDER_PERF_SCOPE("dfs");
                 remove_useless_nodes(turn);
                 update_root(turn);
 
@@ -469,7 +1360,10 @@ namespace skip_beam_library
                     v = move_to_leaf(v);
 
                     multi_selectors.reset_step_max();
-                    state_.expand(v, multi_selectors);
+                    {
+                        THUNDER_PROFILE_SCOPE("expand");
+                        state_.expand(v, multi_selectors);
+                    }
                     while (remove_nodes_.size() < multi_selectors.get_step_max())
                     {
                         remove_nodes_.emplace_back();
@@ -486,65 +1380,370 @@ namespace skip_beam_library
                 }
             }
 
-            // 根からノードvまでのパスを取得する
-            vector<Action> get_path(int v)
+            // 根からノードvまでのパスを取得する
+            vector<Action> get_path(int v)
+            {
+                // cerr << nodes_.size() << endl;
+
+                vector<Action> path;
+                while (nodes_[v].parent != -1)
+                {
+                    // 列は後ろから積む
+                    const Action *run = get_run(v);
+                    for (int i = nodes_[v].run_length - 1; i >= 0; --i)
+                    {
+                        path.push_back(run[i]);
+                    }
+                    v = nodes_[v].parent;
+                }
+                reverse(path.begin(), path.end());
+                return path;
+            }
+
+            // 各候補の根からのパスをまとめて取得する
+            // 親をたどる途中で既にたどったノードに合流したら、そこから先はトライ木のノードを共有する
+            // 戻り値のk番目のパスはcandidates[k]に対応する
+            // candidates は selector が持つ候補で、長さ2以上の列はトライ木では1つの action ごとのノードになる
+            Paths get_paths(const vector<Candidate> &candidates, const Selector &selector)
+            {
+                Paths paths;
+                vector<int> node_to_trie(nodes_.size(), -1);
+                vector<int> stack;
+                for (const Candidate &candidate : candidates)
+                {
+                    int v = candidate.parent;
+                    while (nodes_[v].parent != -1 && node_to_trie[v] == -1)
+                    {
+                        stack.push_back(v);
+                        v = nodes_[v].parent;
+                    }
+                    int parent = nodes_[v].parent == -1 ? -1 : node_to_trie[v];
+                    while (!stack.empty())
+                    {
+                        int u = stack.back();
+                        stack.pop_back();
+                        const Action *run = get_run(u);
+                        for (int i = 0; i < nodes_[u].run_length; ++i)
+                        {
+                            parent = paths.add_node(parent, run[i]);
+                        }
+                        node_to_trie[u] = parent;
+                    }
+                    const Action *run = selector.get_run(candidate);
+                    for (int i = 0; i < candidate.run_length; ++i)
+                    {
+                        parent = paths.add_node(parent, run[i]);
+                    }
+                    paths.ends.push_back(parent);
+                    paths.costs.push_back(candidate.cost);
+                }
+                return paths;
+            }
+
+            // 根から葉best_leafに向かう最初のノードを確定し、そのノードのactionの列を返す
+            // 確定済みのノードから root_ までが一本道なら、それを1つ進めるだけでよい
+            // そうでなければ、確定しなかった根の子の部分木を削除して root_ を進める
+            // 削除したノードを親とする候補は、multi_selectorsからも取り除く
+            vector<Action> commit(int best_leaf, MultiSelectors &multi_selectors)
+            {
+                THUNDER_PROFILE_SCOPE("commit");
+                THUNDER_TRACE_SCOPE("commit");
+                THUNDER_PERF_SCOPE("commit");
+                if (committed_ != root_)
+                {
+                    int v = root_;
+                    while (nodes_[v].parent != committed_)
+                    {
+                        v = nodes_[v].parent;
+                    }
+                    committed_ = v;
+                    return get_actions(v);
+                }
+
+                int child = best_leaf;
+                while (nodes_[child].parent != root_)
+                {
+                    child = nodes_[child].parent;
+                }
+
+                // 確定しなかった子の部分木を削除する
+                vector<bool> removed(nodes_.size(), false);
+                vector<int> stack;
+                for (int u = nodes_[root_].child; u != -1; u = nodes_[u].right)
+                {
+                    if (u != child)
+                    {
+                        stack.push_back(u);
+                    }
+                }
+                while (!stack.empty())
+                {
+                    int u = stack.back();
+                    stack.pop_back();
+                    removed[u] = true;
+                    for (int w = nodes_[u].child; w != -1; w = nodes_[w].right)
+                    {
+                        stack.push_back(w);
+                    }
+                    remove_node(u);
+                }
+                nodes_[root_].child = child;
+                nodes_[child].left = -1;
+                nodes_[child].right = -1;
+                for (vector<int> &remove_nodes : remove_nodes_)
+                {
+                    erase_if(remove_nodes, [&](int v)
+                             { return removed[v]; });
+                }
+                int old_root = root_;
+                multi_selectors.remove_candidates_if([&](const Candidate &candidate)
+                                                     { return candidate.parent == old_root || removed[candidate.parent]; });
+
+                root_ = child;
+                committed_ = child;
+                move_forward(child);
+                return get_actions(child);
+            }
+
+            // 根の子として複数の初期状態を置き、それらを葉とする
+            // 構築直後に呼ぶ
+            void set_roots(const vector<Root> &roots)
+            {
+                for (const Root &root : roots)
+                {
+                    Candidate candidate(root.action, root.hash, root_, root.cost);
+                    add_leaf(candidate, &candidate.action);
+                }
+            }
+
+            // 選ばれた候補を全て新しいノードとして追加する
+            void add_leaves(const Selector &selector)
+            {
+                THUNDER_TRACE_SCOPE("add_leaf");
+                THUNDER_PERF_SCOPE("add_leaf");
+                for (const Candidate &candidate : selector.select())
+                {
+                    add_leaf(candidate, selector.get_run(candidate));
+                }
+                THUNDER_TRACE_COUNTER("live_nodes", nodes_.live_size());
+            }
+
+            // 新しいノードを追加する
+            // run は候補の action の列の先頭(Selector::get_run)。列を持たない候補は &candidate.action を渡す
+            int add_leaf(const Candidate &candidate, const Action *run)
+            {
+                THUNDER_PROFILE_SCOPE("add_leaf");
+                int parent = candidate.parent;
+                int sibling = nodes_[parent].child;
+                int v = nodes_.push(Node(candidate, sibling));
+                if (candidate.run_length > 1)
+                {
+                    nodes_[v].run = runs_.push(run, candidate.run_length);
+                    nodes_[v].run_length = candidate.run_length;
+                }
+
+                nodes_[parent].child = v;
+
+                if (sibling != -1)
+                {
+                    nodes_[sibling].left = v;
+                }
+
+                // 祖先をactivateする
+                int u = parent;
+                while (!nodes_[u].active)
+                {
+                    nodes_[u].active = true;
+                    if (u == root_)
+                    {
+                        break;
+                    }
+                    u = nodes_[u].parent;
+                }
+
+                return v;
+            }
+
+            // 探索木を捨て、layer のパスの終点を葉とする木から探索をやり直す
+            // layer のパスは根から始まる
+            void restart(const typename Frontier::Layer &layer)
+            {
+                THUNDER_PROFILE_SCOPE("restart");
+                // state_ を根まで戻す
+                int v = root_;
+                while (nodes_[v].parent != -1)
+                {
+                    move_backward(v);
+                    v = nodes_[v].parent;
+                }
+                Node root(nodes_[v].action, nodes_[v].cost, nodes_[v].hash);
+                nodes_.clear();
+                runs_.clear();
+                root_ = nodes_.push(root);
+                committed_ = root_;
+                for (vector<int> &remove_nodes : remove_nodes_)
+                {
+                    remove_nodes.clear();
+                }
+
+                // トライ木のノードを親から順に木のノードにする
+                // トライ木では親のほうがインデックスが小さい
+                vector<int> end_index(layer.nodes.size(), -1);
+                for (size_t k = 0; k < layer.size(); ++k)
+                {
+                    end_index[layer.ends[k]] = k;
+                }
+                vector<int> trie_to_node(layer.nodes.size());
+                for (size_t u = 0; u < layer.nodes.size(); ++u)
+                {
+                    auto [trie_parent, action] = layer.nodes[u];
+                    int parent = trie_parent == -1 ? root_ : trie_to_node[trie_parent];
+                    // 途中のノードは展開しないので、コストとハッシュ値は使わない
+                    auto [cost, hash] = end_index[u] == -1 ? pair<Cost, Hash>() : layer.costs[end_index[u]];
+                    Candidate candidate(action, hash, parent, cost);
+                    trie_to_node[u] = add_leaf(candidate, &candidate.action);
+                }
+            }
+
+#ifdef THUNDER_CHECKPOINT
+            // チェックポイントに保存する
+            void save(CheckpointWriter &writer) const
+            {
+                nodes_.save(writer);
+                runs_.save(writer);
+                writer.write(root_);
+                writer.write(committed_);
+                writer.write(remove_nodes_.size());
+                for (const vector<int> &remove_nodes : remove_nodes_)
+                {
+                    writer.write_vector(remove_nodes);
+                }
+                if constexpr (CheckpointableState<State<MultiSelectors>>)
+                {
+                    state_.save(writer);
+                }
+            }
+
+            // save で保存した状態を読み込む
+            // 構築直後(state_ が根の状態)に呼ぶ
+            // State が save, load を実装していなければ、根から root_ までのactionをたどって復元する
+            void load(CheckpointReader &reader)
+            {
+                nodes_.load(reader);
+                runs_.load(reader);
+                reader.read(root_);
+                reader.read(committed_);
+                remove_nodes_.resize(reader.read<size_t>());
+                for (vector<int> &remove_nodes : remove_nodes_)
+                {
+                    reader.read_vector(remove_nodes);
+                }
+                if constexpr (CheckpointableState<State<MultiSelectors>>)
+                {
+                    state_.load(reader);
+                }
+                else
+                {
+                    for (const Action &action : get_path(root_))
+                    {
+                        state_.move_forward(action);
+                    }
+                }
+            }
+#endif
+
+        private:
+            State<MultiSelectors> state_;
+            ObjectPool<Node> nodes_;
+            // ノードが持つ長さ2以上の action の列
+            RunPool<Action> runs_;
+            int root_;
+            // 確定済みのノード。root_ はこのノードの子孫
+            int committed_;
+            deque<vector<int>> remove_nodes_;
+
+            // ノードvの action の列の先頭を返す
+            const Action *get_run(int v)
+            {
+                return nodes_[v].run == -1 ? &nodes_[v].action : &runs_[nodes_[v].run];
+            }
+
+            // ノードvの action の列を返す
+            vector<Action> get_actions(int v)
             {
-                // cerr << nodes_.size() << endl;
+                const Action *run = get_run(v);
+                return vector<Action>(run, run + nodes_[v].run_length);
+            }
 
-                vector<Action> path;
-                while (nodes_[v].parent != -1)
+            // ノードvの action の列で state_ を進める
+            // State が move_forward_run を実装していればまとめて、そうでなければ1つずつ進める
+            void move_forward(int v)
+            {
+                if (nodes_[v].run == -1)
                 {
-                    path.push_back(nodes_[v].action);
-                    v = nodes_[v].parent;
+                    state_.move_forward(nodes_[v].action);
+                    return;
+                }
+                const Action *run = &runs_[nodes_[v].run];
+                int length = nodes_[v].run_length;
+                if constexpr (RunState<State<MultiSelectors>, Action>)
+                {
+                    state_.move_forward_run(run, length);
+                }
+                else
+                {
+                    for (int i = 0; i < length; ++i)
+                    {
+                        state_.move_forward(run[i]);
+                    }
                 }
-                reverse(path.begin(), path.end());
-                return path;
             }
 
-            // 新しいノードを追加する
-            int add_leaf(const Candidate &candidate)
+            // ノードvの action の列の分だけ state_ を戻す
+            void move_backward(int v)
             {
-                int parent = candidate.parent;
-                int sibling = nodes_[parent].child;
-                int v = nodes_.push(Node(candidate, sibling));
-
-                nodes_[parent].child = v;
-
-                if (sibling != -1)
+                if (nodes_[v].run == -1)
                 {
-                    nodes_[sibling].left = v;
+                    state_.move_backward(nodes_[v].action);
+                    return;
                 }
-
-                // 祖先をactivateする
-                int u = parent;
-                while (!nodes_[u].active)
+                const Action *run = &runs_[nodes_[v].run];
+                int length = nodes_[v].run_length;
+                if constexpr (RunState<State<MultiSelectors>, Action>)
                 {
-                    nodes_[u].active = true;
-                    if (u == root_)
+                    state_.move_backward_run(run, length);
+                }
+                else
+                {
+                    for (int i = length - 1; i >= 0; --i)
                     {
-                        break;
+                        state_.move_backward(run[i]);
                     }
-                    u = nodes_[u].parent;
                 }
-
-                return v;
             }
 
-        private:
-            State<MultiSelectors> state_;
-            ObjectPool<Node> nodes_;
-            int root_;
-            deque<vector<int>> remove_nodes_;
+            // ノードvを削除する
+            void remove_node(int v)
+            {
+                if (nodes_[v].run != -1)
+                {
+                    runs_.pop(nodes_[v].run, nodes_[v].run_length);
+                }
+                nodes_.pop(v);
+            }
 
             // 根から一本道の部分は往復しないようにする
             void update_root(int turn)
             {
+                THUNDER_PROFILE_SCOPE("update_root");
+                THUNDER_TRACE_SCOPE("update_root");
+                THUNDER_PERF_SCOPE("update_root");
                 int child = nodes_[root_].child;
                 // 後で子供が追加されうるノードはスキップしないようにする
                 while (child != -1 && nodes_[child].right == -1 && nodes_[root_].remove_check_turn <= turn)
                 {
                     root_ = child;
-                    state_.move_forward(nodes_[child].action);
+                    move_forward(child);
                     child = nodes_[child].child;
                 }
             }
@@ -562,7 +1761,7 @@ namespace skip_beam_library
                     }
                     nodes_[v].active = false;
                     v = child;
-                    state_.move_forward(nodes_[child].action);
+                    move_forward(child);
                     child = nodes_[child].child;
                 }
                 nodes_[v].active = false;
@@ -574,7 +1773,7 @@ namespace skip_beam_library
             {
                 while (v != root_)
                 {
-                    state_.move_backward(nodes_[v].action);
+                    move_backward(v);
 
                     // activeなノードが見つかるまで右に移動する
                     int u = nodes_[v].right;
@@ -582,7 +1781,7 @@ namespace skip_beam_library
                     {
                         if (nodes_[u].active)
                         {
-                            state_.move_forward(nodes_[u].action);
+                            move_forward(u);
                             return u;
                         }
                         u = nodes_[u].right;
@@ -596,6 +1795,9 @@ namespace skip_beam_library
             // 不要になったノードを全て削除する
             void remove_useless_nodes(int turn)
             {
+                THUNDER_PROFILE_SCOPE("remove_useless_nodes");
+                THUNDER_TRACE_SCOPE("remove_useless_nodes");
+                THUNDER_PERF_SCOPE("remove_useless_nodes");
                 if (remove_nodes_.empty())
                 {
                     return;
@@ -636,7 +1838,7 @@ namespace skip_beam_library
                             cerr << "ERROR: root is removed" << endl;
                             exit(-1);
                         }
-                        nodes_.pop(v);
+                        remove_node(v);
                         nodes_[parent].child = right;
                         if (right != -1)
                         {
@@ -647,7 +1849,7 @@ namespace skip_beam_library
                     }
                     else
                     {
-                        nodes_.pop(v);
+                        remove_node(v);
                         nodes_[left].right = right;
                         if (right != -1)
                         {
@@ -659,15 +1861,185 @@ namespace skip_beam_library
             }
         };
 
+        // ローリングホライズン(オンライン)で探索するためのクラス
+        // step(turns) で探索をturnsターン深くしてから、根から最もよい葉に向かう最初のactionを確定して返す
+        // 確定しなかった根の子の部分木は削除し、残った部分木は次のstepでそのまま使うので、
+        // 毎回最初から探索し直す場合と違い、ビーム幅分の葉を作り直さずに済む
+        // 初回はビームの深さ分、2回目以降は1ターンずつ深くするのが基本的な使い方
+        class RollingSearch
+        {
+        public:
+            explicit RollingSearch(const Config &config, const State<MultiSelectors> &state, const Node &root) : tree_(state, config.nodes_capacity, root),
+                                                                                                                  multi_selectors_(config),
+                                                                                                                  turn_(0),
+                                                                                                                  best_leaf_(-1) {}
+
+            // 探索をturnsターン深くしてから、actionを1つ確定して返す
+            // 実行可能解が見つかった後は、そのパスに沿ってactionを返す
+            // 最後のターンに葉が追加されなかったときは、後のターンの候補が残っていれば葉が追加されるまで探索を続ける
+            // 返すactionがないとき(候補が残っていないとき、実行可能解のパスを返し終えたとき)はnulloptを返す
+            optional<Action> step(int turns)
+            {
+                if (!finished_path_.empty())
+                {
+                    if (finished_path_index_ == finished_path_.size())
+                    {
+                        return nullopt;
+                    }
+                    return finished_path_[finished_path_index_++];
+                }
+
+                for (int turn = 0; turn < turns; ++turn, ++turn_)
+                {
+                    // Euler Tour で selector に候補を追加する
+                    tree_.dfs(multi_selectors_, turn_);
+
+                    Selector selector = multi_selectors_.pop_selector();
+                    if (selector.have_finished())
+                    {
+                        // 実行可能解が見つかったら、以降はそのパスをたどる
+                        const Candidate &candidate = selector.get_best_finished_candidate();
+                        finished_path_ = tree_.get_path(candidate.parent);
+                        selector.append_run(candidate, finished_path_);
+                        finished_path_index_ = committed_size_;
+                        return step(0);
+                    }
+
+                    // 新しいノードを追加し、最もよい葉を覚えておく
+                    best_leaf_ = -1;
+                    Cost best_cost = numeric_limits<Cost>::max();
+                    for (const Candidate &candidate : selector.select())
+                    {
+                        int v = tree_.add_leaf(candidate, selector.get_run(candidate));
+                        if (best_leaf_ == -1 || candidate.cost < best_cost)
+                        {
+                            best_leaf_ = v;
+                            best_cost = candidate.cost;
+                        }
+                    }
+                    THUNDER_PERF_TURN_END();
+
+                    // Selector を使い回す
+                    multi_selectors_.push_selector(move(selector));
+                }
+                if (pending_index_ < pending_.size())
+                {
+                    // 確定したノードの列の残りを返す
+                    ++committed_size_;
+                    return pending_[pending_index_++];
+                }
+                if (best_leaf_ == -1)
+                {
+                    if (!multi_selectors_.has_candidates())
+                    {
+                        return nullopt;
+                    }
+                    return step(1);
+                }
+                pending_ = tree_.commit(best_leaf_, multi_selectors_);
+                pending_index_ = 1;
+                ++committed_size_;
+                return pending_[0];
+            }
+
+        private:
+            Tree tree_;
+            MultiSelectors multi_selectors_;
+            int turn_;
+            int best_leaf_;
+            // 確定したactionの個数
+            size_t committed_size_ = 0;
+            // 確定したノードが長さ2以上の列を持つときは、残りを1つずつ返す
+            vector<Action> pending_;
+            size_t pending_index_ = 0;
+            vector<Action> finished_path_;
+            size_t finished_path_index_ = 0;
+        };
+
+#ifdef THUNDER_CHECKPOINT
+        // beam_search の途中経過を config.checkpoint_path に保存する
+        // next_turn は再開したときに最初に探索するターン
+        void save_checkpoint(const Config &config, int next_turn, const Frontier &frontier, int backtracks,
+                             Cost stall_best_cost, int stall_turns, const Tree &tree, const MultiSelectors &multi_selectors) const
+        {
+            THUNDER_PROFILE_SCOPE("checkpoint");
+            CheckpointWriter writer(config.checkpoint_path);
+            // 読み込むときに設定や型が変わっていないかを確認するための値
+            writer.write(sizeof(Action));
+            writer.write(sizeof(Cost));
+            writer.write(sizeof(Hash));
+            writer.write(config.beam_width);
+            writer.write(config.max_turn);
+            writer.write(config.backtrack_width);
+
+            writer.write(next_turn);
+            frontier.save(writer);
+            writer.write(backtracks);
+            writer.write(stall_best_cost);
+            writer.write(stall_turns);
+            tree.save(writer);
+            multi_selectors.save(writer);
+            writer.commit();
+        }
+
+        // save_checkpoint で保存した途中経過を読み込み、再開するターンを返す
+        int load_checkpoint(const Config &config, Frontier &frontier, int &backtracks,
+                            Cost &stall_best_cost, int &stall_turns, Tree &tree, MultiSelectors &multi_selectors) const
+        {
+            THUNDER_PROFILE_SCOPE("checkpoint");
+            CheckpointReader reader(config.checkpoint_path);
+            reader.expect(sizeof(Action), "sizeof(Action)");
+            reader.expect(sizeof(Cost), "sizeof(Cost)");
+            reader.expect(sizeof(Hash), "sizeof(Hash)");
+            reader.expect(config.beam_width, "beam_width");
+            reader.expect(config.max_turn, "max_turn");
+            reader.expect(config.backtrack_width, "backtrack_width");
+
+            int next_turn = reader.read<int>();
+            frontier.load(reader);
+            reader.read(backtracks);
+            reader.read(stall_best_cost);
+            reader.read(stall_turns);
+            tree.load(reader);
+            multi_selectors.load(reader);
+            return next_turn;
+        }
+#endif
+
         // ビームサーチを行う関数
-        vector<Action> beam_search(const Config &config, State<MultiSelectors> state, Node root)
+        // roots を渡すと、root を仮想的な根としてその子の複数の初期状態から同時に探索する
+        // 初期状態どうしも同じSelectorで競わせるので、初期状態ごとに探索する場合と違い、木は1つで済む
+        // このとき返すパスの先頭は、どの初期状態から始めたかを表す roots[k].action になる
+        vector<Action> beam_search(const Config &config, State<MultiSelectors> state, Node root, const vector<Root> &roots = {})
         {
             Tree tree(state, config.nodes_capacity, root);
+            tree.set_roots(roots);
 
             // 新しいノード候補の集合
-            MultiSelectors multi_selectors(config);
-
-            for (int turn = 0; turn < config.max_turn; ++turn)
+            // ビームに入らなかった候補も覚えるときは、その分だけ広く選んでおいて後で分ける
+            MultiSelectors multi_selectors(config, config.backtrack_width);
+
+            // backtrack_width を指定したときに、ビームに入らなかった候補を覚えておく
+            Frontier frontier(config.backtrack_width);
+            int backtracks = 0;
+            // backtrack_stall_turns を指定したときに、ビーム内の最もよいコストが更新されなかったターン数を数える
+            Cost stall_best_cost = numeric_limits<Cost>::max();
+            int stall_turns = 0;
+
+            int start_turn = 0;
+#ifdef THUNDER_CHECKPOINT
+            if (config.resume_from_checkpoint && CheckpointReader::exists(config.checkpoint_path))
+            {
+                start_turn = load_checkpoint(config, frontier, backtracks, stall_best_cost, stall_turns, tree, multi_selectors);
+            }
+#else
+            if (config.checkpoint_interval > 0 || config.resume_from_checkpoint)
+            {
+                cerr << "ERROR: checkpoint_interval and resume_from_checkpoint require THUNDER_CHECKPOINT" << endl;
+                exit(-1);
+            }
+#endif
+            for (int turn = start_turn; turn < config.max_turn; ++turn)
             {
                 // Euler Tour で selector に候補を追加する
                 tree.dfs(multi_selectors, turn);
@@ -676,27 +2048,130 @@ namespace skip_beam_library
                 if (selector.have_finished())
                 {
                     // ターン数最小化型の問題で実行可能解が見つかったとき
-                    Candidate candidate = selector.get_finished_candidates()[0];
+                    const Candidate &candidate = selector.get_best_finished_candidate();
                     vector<Action> ret = tree.get_path(candidate.parent);
-                    ret.push_back(candidate.action);
+                    selector.append_run(candidate, ret);
                     return ret;
                 }
 
-                if (turn == config.max_turn - 1)
+                if (frontier.enabled() && backtracks < config.max_backtracks &&
+                    timer_library::timer.getTime() <= config.time_limit)
+                {
+                    // 実行可能解が見つかる前にビームが途絶えたか、行き詰まったときは、覚えている候補からやり直す
+                    // 後のターンに追加する候補が残っていれば、まだ途絶えていない
+                    bool dead = selector.select().empty() && !multi_selectors.has_candidates();
+                    bool stalled = false;
+                    if (!selector.select().empty() && config.backtrack_stall_turns > 0)
+                    {
+                        Cost cost = selector.calc_best_candidate().cost;
+                        if (cost < stall_best_cost)
+                        {
+                            stall_best_cost = cost;
+                            stall_turns = 0;
+                        }
+                        else
+                        {
+                            stalled = ++stall_turns >= config.backtrack_stall_turns;
+                        }
+                    }
+                    if (dead || stalled)
+                    {
+                        // 途絶えたときはこのターン以前、行き詰まったときは今より浅いターンの候補を使う
+                        typename Frontier::Layer layer;
+                        int restart_turn = frontier.pop(dead ? turn : turn - 1, layer);
+                        if (restart_turn != -1)
+                        {
+                            tree.restart(layer);
+                            // restart_turn ターン目の候補が葉になったので、次は restart_turn + 1 ターン目を探索する
+                            multi_selectors.restart(restart_turn + 1);
+                            ++backtracks;
+                            stall_best_cost = numeric_limits<Cost>::max();
+                            stall_turns = 0;
+                            turn = restart_turn;
+                            continue;
+                        }
+                    }
+                }
+
+                if (turn == config.max_turn - 1 ||
+                    (!selector.select().empty() && timer_library::timer.getTime() > config.time_limit))
                 {
-                    // 最終ターン
-                    Candidate candidate = selector.calc_best_candidate();
+                    // 最終ターン、または制限時間を過ぎたとき
+                    const Candidate &candidate = selector.calc_best_candidate();
                     vector<Action> ret = tree.get_path(candidate.parent);
-                    ret.push_back(candidate.action);
+                    selector.append_run(candidate, ret);
                     return ret;
                 }
 
+                if (frontier.enabled())
+                {
+                    // ビームに入らなかった候補を、根からのパスにして覚えておく
+                    const vector<Candidate> &pruned = selector.split_pruned(config.get_beam_width(turn));
+                    if (!pruned.empty())
+                    {
+                        vector<pair<Cost, Hash>> leaves;
+                        leaves.reserve(pruned.size());
+                        for (const Candidate &candidate : pruned)
+                        {
+                            leaves.push_back({candidate.cost, candidate.hash});
+                        }
+                        frontier.record(turn, tree.get_paths(pruned, selector), move(leaves));
+                    }
+                }
+
                 // 新しいノードを追加する
-                for (const Candidate &candidate : selector.select())
+                tree.add_leaves(selector);
+                THUNDER_PERF_TURN_END();
+
+                // Selector を使い回す
+                multi_selectors.push_selector(move(selector));
+
+#ifdef THUNDER_CHECKPOINT
+                if (config.checkpoint_interval > 0 && (turn + 1) % config.checkpoint_interval == 0)
+                {
+                    save_checkpoint(config, turn + 1, frontier, backtracks, stall_best_cost, stall_turns, tree, multi_selectors);
+                }
+#endif
+            }
+            assert(false);
+            return {};
+        }
+
+        // ビームサーチを行い、評価がよい順に最大k個の解のパスを返す
+        // 最終ターンのSelectorに残った候補(実行可能解が見つかった場合はその候補)からk個を選ぶ
+        // k回ビームサーチをする場合と違い、探索は1回で済む
+        // roots は beam_search と同じ
+        Paths beam_search_top_k(const Config &config, State<MultiSelectors> state, Node root, size_t k, const vector<Root> &roots = {})
+        {
+            Tree tree(state, config.nodes_capacity, root);
+            tree.set_roots(roots);
+
+            // 新しいノード候補の集合
+            MultiSelectors multi_selectors(config);
+
+            for (int turn = 0; turn < config.max_turn; ++turn)
+            {
+                // Euler Tour で selector に候補を追加する
+                tree.dfs(multi_selectors, turn);
+
+                Selector selector = multi_selectors.pop_selector();
+                if (selector.have_finished())
+                {
+                    // ターン数最小化型の問題で実行可能解が見つかったとき
+                    return tree.get_paths(selector.calc_top_k_finished_candidates(k), selector);
+                }
+
+                if (turn == config.max_turn - 1 ||
+                    (!selector.select().empty() && timer_library::timer.getTime() > config.time_limit))
                 {
-                    tree.add_leaf(candidate);
+                    // 最終ターン、または制限時間を過ぎたとき
+                    return tree.get_paths(selector.calc_top_k_candidates(k), selector);
                 }
 
+                // 新しいノードを追加する
+                tree.add_leaves(selector);
+                THUNDER_PERF_TURN_END();
+
                 // Selector を使い回す
                 multi_selectors.push_selector(move(selector));
             }
@@ -727,6 +2202,10 @@ namespace skip_beam_library
             Action action;
             int parent;
             Cost cost;
+            // 長さ2以上の action の列を1つの候補にしたときの、列の位置と長さ(push_run 参照)
+            // 列の先頭は action にも入れておく
+            int run = -1;
+            int run_length = 1;
 
             Candidate(Action action, int parent, Cost cost) : action(action),
                                                               parent(parent),
@@ -739,6 +2218,50 @@ namespace skip_beam_library
             int max_turn;
             size_t beam_width;
             size_t nodes_capacity;
+            // 制限時間(timer_library::timer の経過秒数)
+            // これを過ぎたターンを最終ターンとして扱う
+            double time_limit = numeric_limits<double>::infinity();
+            // 0以外を指定すると、ビームの末尾でコストが等しい候補のどちらを残すかをこの値をシードとした乱数で決める
+            // 並列に独立なビームサーチを行うときに、インスタンスごとに変えると探索が多様になる
+            uint64_t tie_break_seed = 0;
+            // ターンごとのビーム幅を返す関数。省略するとbeam_widthで一定になる
+            // 配列で指定したい場合は [&](int turn) { return widths[turn]; } のように渡す
+            // 返す値は1以上beam_width以下にする。メモリはbeam_widthの分だけ確保し、各ターンはその幅だけ使う
+            function<size_t(int)> beam_width_schedule = nullptr;
+            // 途中経過を保存するファイル
+            string checkpoint_path = "";
+            // 0以外を指定すると、beam_search で checkpoint_interval ターンごとに checkpoint_path に保存する
+            // checkpoint_interval, resume_from_checkpoint は THUNDER_CHECKPOINT を define したときだけ指定できる
+            // 保存にはノード数に比例する時間がかかるので、1ターンの時間に比べて十分大きくする
+            int checkpoint_interval = 0;
+            // trueにすると、checkpoint_path があればそのターンから beam_search を再開する
+            // 保存したときと同じ入力、同じ設定(beam_widthなど)で実行する必要がある
+            // 制限時間(time_limit)は再開してからの経過時間で判定する
+            bool resume_from_checkpoint = false;
+            // 0以外を指定すると、各ターンにビームに入らなかった候補のうちよいものをこの個数まで覚えておき、
+            // 実行可能解が見つかる前にビームが途絶えたとき(候補がなくなったとき)に、
+            // 覚えている中で最も深いターンの候補から探索をやり直す(beam stack search)
+            // Selectorはビーム幅がこの個数だけ広いのと同じだけ重くなり、覚える候補の根からのパスを毎ターン計算する
+            // beam_search だけで使う。覚えた候補はチェックポイントにも保存する
+            size_t backtrack_width = 0;
+            // backtrack_width を指定したときに0以外を指定すると、ビーム内の最もよいコストがこのターン数だけ
+            // 更新されなかったときも行き詰まったとみなして、今より浅いターンの候補から探索をやり直す
+            int backtrack_stall_turns = 0;
+            // 探索をやり直す回数の上限
+            int max_backtracks = numeric_limits<int>::max();
+
+            // turnターン目のビーム幅
+            // max_turn以降のターンはmax_turn - 1ターン目と同じ幅にする
+            size_t get_beam_width(int turn) const
+            {
+                if (!beam_width_schedule)
+                {
+                    return beam_width;
+                }
+                size_t width = beam_width_schedule(min(turn, max_turn - 1));
+                assert(1 <= width && width <= beam_width);
+                return width;
+            }
         };
 
         static pair<Cost, int> max_func(pair<Cost, int> a, pair<Cost, int> b)
@@ -763,6 +2286,33 @@ namespace skip_beam_library
             max_func,
             min_func>;
 
+        // 複数の初期状態から探索するときの、初期状態を表す構造体
+        // beam_search に渡す root を仮想的な根とし、action で各初期状態に移る
+        // 根の分だけ State の深さが1段増えるので、UndoLog(max_turn + 1) のように深さで容量を決めるものは1つ多く確保する
+        struct Root
+        {
+            Action action;
+            Cost cost;
+        };
+
+        // 複数のパスをまとめて返すときの型
+        using Paths = PathTrie<Action, Cost>;
+
+        // ビームに入らなかった候補を覚えておく型(backtrack_width 参照)
+        using Frontier = PrunedFrontier<Action, Cost>;
+
+        // 評価がよい順に最大k個の候補を返す
+        static vector<Candidate> select_top_k(const vector<Candidate> &candidates, size_t k)
+        {
+            vector<Candidate> ret = candidates;
+            k = min(k, ret.size());
+            partial_sort(ret.begin(), ret.begin() + k, ret.end(),
+                         [](const Candidate &a, const Candidate &b)
+                         { return a.cost < b.cost; });
+            ret.erase(ret.begin() + k, ret.end());
+            return ret;
+        }
+
         // ノードの候補から実際に追加するものを選ぶクラス
         // ビーム幅の個数だけ、評価がよいものを選ぶ
         // ハッシュ値が一致したものについては、評価がよいほうのみを残す
@@ -771,39 +2321,80 @@ namespace skip_beam_library
         public:
             explicit Selector(const Config &config)
             {
-                beam_width = config.beam_width;
-                candidates_.reserve(beam_width);
+                tie_break_state_ = config.tie_break_seed;
+                // backtrack_width を指定したときは、ビームに入らなかった候補もその個数だけ一緒に選べるようにしておく
+                beam_width = config.beam_width + config.backtrack_width;
+                // Cost が整数型なら、segment treeの代わりに基数選択でビームを選ぶので、ビーム幅の2倍まで候補を溜める(radix_shrink 参照)
+                candidates_.reserve(is_integral_v<Cost> ? 2 * beam_width : beam_width);
                 full_ = false;
                 st_original_.resize(beam_width);
             }
 
+            // このSelectorが受け持つターンのビーム幅を変える
+            // 候補を持っていないとき(構築直後かclearの後)に呼ぶ。幅は構築時のbeam_width以下にする
+            // segment treeはこの幅で構築するので、幅が狭いターンはその分だけ軽くなる
+            void set_beam_width(size_t width)
+            {
+                assert(candidates_.empty() && 1 <= width && width <= candidates_.capacity());
+                beam_width = width;
+                st_original_.resize(width);
+            }
+
             // 候補を追加する
             // ターン数最小化型の問題で、candidateによって実行可能解が得られる場合にのみ finished = true とする
             // ビーム幅分の候補をCandidateを追加したときにsegment treeを構築する
             bool push(const Action &action, const Cost cost, const int parent, bool finished)
             {
+                return push_run(&action, 1, cost, parent, finished);
+            }
+
+            // 長さ length の action の列 actions を1つの候補として追加する
+            // 列は候補として残したときにだけ Selector 内にコピーするので、足切りされる候補ではコピーしない
+            bool push_run(const Action *actions, size_t length, const Cost cost, const int parent, bool finished)
+            {
+                THUNDER_PROFILE_SCOPE("select");
                 if (finished)
                 {
-                    finished_candidates_.emplace_back(Candidate(action, parent, cost));
+                    if (finished_candidates_.empty() || cost < finished_candidates_[best_finished_].cost)
+                    {
+                        best_finished_ = finished_candidates_.size();
+                    }
+                    finished_candidates_.emplace_back(make_candidate(actions, length, parent, cost));
                     return true;
                 }
+                if constexpr (is_integral_v<Cost>)
+                {
+                    // 一度絞った後は、境目のコストより大きい候補は入らない
+                    // 境目と等しい候補は、tie_break_seed を指定したときだけ入れておき、絞るときに乱数で選ぶ
+                    if (full_ && (cost > cutoff_ || (cost == cutoff_ && tie_break_state_ == 0)))
+                    {
+                        return false;
+                    }
+                    return push_radix(actions, length, cost, parent);
+                }
                 if (full_ && cost >= st_.all_prod().first)
                 {
                     // 保持しているどの候補よりもコストが小さくないとき
-                    return false;
+                    // コストが等しいときは、tie_break_seed が指定されていれば乱数で入れ替えるか決める
+                    if (cost > st_.all_prod().first || !tie_break(cost))
+                    {
+                        return false;
+                    }
                 }
                 int i = 0;
                 if (full_)
                 {
                     // segment treeが構築されている場合
                     int j = st_.all_prod().second;
-                    candidates_[j] = Candidate(action, parent, cost);
+                    candidates_[j] = make_candidate(actions, length, parent, cost);
+                    update_best(j);
                     st_.set(j, {cost, j});
                 }
                 else
                 {
                     // segment treeが構築されていない場合
-                    candidates_.emplace_back(Candidate(action, parent, cost));
+                    candidates_.emplace_back(make_candidate(actions, length, parent, cost));
+                    update_best(candidates_.size() - 1);
 
                     if (candidates_.size() == beam_width)
                     {
@@ -827,29 +2418,155 @@ namespace skip_beam_library
             }
 
             // 実行可能解に到達する「候補」を返す
-            vector<Candidate> get_finished_candidates() const
+            const vector<Candidate> &get_finished_candidates() const
             {
                 return finished_candidates_;
             }
 
+            // 実行可能解に到達する「候補」のうち最も評価がよいものを返す
+            // pushのたびに更新しているのでO(1)
+            const Candidate &get_best_finished_candidate() const
+            {
+                assert(have_finished());
+                return finished_candidates_[best_finished_];
+            }
+
+            // 候補の action の列の先頭を返す。列の長さは candidate.run_length
+            const Action *get_run(const Candidate &candidate) const
+            {
+                return candidate.run == -1 ? &candidate.action : runs_.data() + candidate.run;
+            }
+
+            // 候補の action の列を path の末尾に追加する
+            void append_run(const Candidate &candidate, vector<Action> &path) const
+            {
+                const Action *run = get_run(candidate);
+                path.insert(path.end(), run, run + candidate.run_length);
+            }
+
             // 最も評価がよい候補を返す
-            Candidate calc_best_candidate()
+            // pushのたびに更新しているのでO(1)
+            const Candidate &calc_best_candidate() const
             {
-                int best = 0;
-                for (size_t i = 0; i < candidates_.size(); ++i)
+                assert(best_ != -1);
+                return candidates_[best_];
+            }
+
+            // 評価がよい順に最大k個の候補を返す
+            vector<Candidate> calc_top_k_candidates(size_t k) const
+            {
+                return select_top_k(candidates_, k);
+            }
+
+            // 実行可能解に到達する「候補」を評価がよい順に最大k個返す
+            vector<Candidate> calc_top_k_finished_candidates(size_t k) const
+            {
+                return select_top_k(finished_candidates_, k);
+            }
+
+            // 選んだ候補を、コストがよい width 個とそれ以外に分け、それ以外を返す
+            // select() はよい width 個だけを返すようになる
+            // backtrack_width を指定したときに、ビームに入らなかった候補を取り出すために使う
+            // segment treeは作り直さないので、呼んだ後は clear するまで push しない
+            const vector<Candidate> &split_pruned(size_t width)
+            {
+                pruned_.clear();
+                if (candidates_.size() <= width)
+                {
+                    return pruned_;
+                }
+                nth_element(candidates_.begin(), candidates_.begin() + width, candidates_.end(),
+                            [](const Candidate &a, const Candidate &b)
+                            { return a.cost < b.cost; });
+                pruned_.assign(candidates_.begin() + width, candidates_.end());
+                candidates_.erase(candidates_.begin() + width, candidates_.end());
+                // 並べ替えたので、最もよい候補の添字を求め直す
+                best_ = -1;
+                for (size_t j = 0; j < candidates_.size(); ++j)
+                {
+                    update_best(j);
+                }
+                return pruned_;
+            }
+
+            // predを満たす候補を取り除く
+            template <class Predicate>
+            void remove_if(Predicate pred)
+            {
+                vector<Candidate> candidates = candidates_;
+                vector<Action> runs = runs_;
+                clear();
+                for (const Candidate &candidate : candidates)
                 {
-                    if (candidates_[i].cost < candidates_[best].cost)
+                    if (!pred(candidate))
                     {
-                        best = i;
+                        const Action *run = candidate.run == -1 ? &candidate.action : runs.data() + candidate.run;
+                        push_run(run, candidate.run_length, candidate.cost, candidate.parent, false);
                     }
                 }
-                return candidates_[best];
+                erase_if(finished_candidates_, pred);
+                calc_best_finished();
+            }
+
+#ifdef THUNDER_CHECKPOINT
+            // チェックポイントに保存する
+            void save(CheckpointWriter &writer) const
+            {
+                writer.write(beam_width);
+                writer.write_vector(candidates_);
+                writer.write_vector(finished_candidates_);
+                writer.write_vector(runs_);
+                writer.write(tie_break_state_);
+                writer.write(tie_cost_);
+                writer.write(tie_count_);
+            }
+
+            // save で保存した状態を読み込む
+            // 構築直後に呼ぶ。候補を保存したときと同じ順番で追加し直すので、segment treeも同じものになる
+            void load(CheckpointReader &reader)
+            {
+                set_beam_width(reader.read<size_t>());
+                vector<Candidate> candidates;
+                reader.read_vector(candidates);
+                reader.read_vector(finished_candidates_);
+                calc_best_finished();
+                // 実行可能解の候補は保存したときの列の位置を指しているので、列はそのまま読み込む
+                vector<Action> runs;
+                reader.read_vector(runs);
+                runs_ = runs;
+                for (const Candidate &candidate : candidates)
+                {
+                    const Action *run = candidate.run == -1 ? &candidate.action : runs.data() + candidate.run;
+                    push_run(run, candidate.run_length, candidate.cost, candidate.parent, false);
+                }
+                reader.read(tie_break_state_);
+                reader.read(tie_cost_);
+                reader.read(tie_count_);
+            }
+#endif
+
+            // 候補を追加し終えたら呼び、選んだ候補をビーム幅の個数に絞る
+            // 基数選択を使うときは、ビーム幅の2倍まで候補を溜めてから絞っているので、最後にもう一度絞る
+            void shrink_to_beam()
+            {
+                if constexpr (is_integral_v<Cost>)
+                {
+                    radix_shrink();
+                }
             }
 
             void clear()
             {
                 candidates_.clear();
+                best_ = -1;
+                radix_costs_.clear();
                 full_ = false;
+                tie_count_ = 0;
+                // 実行可能解の候補が残っているときは、その列を消さない
+                if (finished_candidates_.empty())
+                {
+                    runs_.clear();
+                }
             }
 
         private:
@@ -858,7 +2575,141 @@ namespace skip_beam_library
             bool full_;
             vector<pair<Cost, int>> st_original_;
             MaxSegtree st_;
+            uint64_t tie_break_state_;
+            // tie_break で数えている、最も悪い候補のコストとそのコストの候補の個数
+            Cost tie_cost_{};
+            size_t tie_count_ = 0;
+            // 基数選択でビームを選ぶときに使う(radix_shrink 参照)
+            RadixSelect<Cost> radix_;
+            // 候補のコスト(candidates_ と同じ順番)
+            vector<Cost> radix_costs_;
+            // 一度絞った後の、残した候補の最大のコスト
+            Cost cutoff_;
+
+            // 基数選択を使うときのpush
+            // 候補をビーム幅の2倍まで溜め、溜まったらコストが小さい順にビーム幅の個数に絞る
+            // 絞るたびに境目のコストが下がるので、segment treeを使う場合と同じく悪い候補はすぐに捨てられる
+            bool push_radix(const Action *actions, size_t length, Cost cost, int parent)
+            {
+                int j = candidates_.size();
+                candidates_.emplace_back(make_candidate(actions, length, parent, cost));
+                radix_costs_.push_back(cost);
+                update_best(j);
+                if (candidates_.size() == 2 * beam_width)
+                {
+                    radix_shrink();
+                }
+                return true;
+            }
+
+            // 基数選択で、コストが小さい順にビーム幅の個数だけ候補を残す
+            // コストが等しい候補は先に追加したほうを残し、tie_break_seed を指定したときは乱数で選ぶ
+            // 残す候補を前に詰めるだけなので、候補は追加した順に並んだまま
+            void radix_shrink()
+            {
+                if (candidates_.size() <= beam_width)
+                {
+                    return;
+                }
+                auto [threshold, num_taken, num_ties] = radix_.select(radix_costs_.data(), candidates_.size(), beam_width);
+                size_t m = 0;
+                best_ = -1;
+                for (size_t i = 0; i < candidates_.size(); ++i)
+                {
+                    Cost cost = radix_costs_[i];
+                    if (cost > threshold)
+                    {
+                        continue;
+                    }
+                    if (cost == threshold)
+                    {
+                        // 残りの num_ties 個から num_taken 個を選ぶ
+                        bool take = tie_break_state_ == 0 ? num_taken > 0 : xorshift64(tie_break_state_) % num_ties < num_taken;
+                        --num_ties;
+                        if (!take)
+                        {
+                            continue;
+                        }
+                        --num_taken;
+                    }
+                    candidates_[m] = candidates_[i];
+                    radix_costs_[m] = cost;
+                    update_best(m);
+                    ++m;
+                }
+                candidates_.erase(candidates_.begin() + m, candidates_.end());
+                radix_costs_.resize(m);
+                cutoff_ = threshold;
+                full_ = true;
+            }
+
+            // 最も悪い候補とコストが等しい候補 cost で入れ替えるかどうかを返す
+            // そのコストの候補が来るのが n 個目なら、確率 1/n で入れ替える(reservoir sampling)
+            // 同じ枠を争った候補はどれも同じ確率で残るので、基数選択で境目の候補を乱数で選ぶのと揃う
+            // tie_break_seed が0なら常に入れ替えない
+            bool tie_break(const Cost &cost)
+            {
+                if (tie_break_state_ == 0)
+                {
+                    return false;
+                }
+                if (tie_count_ == 0 || cost != tie_cost_)
+                {
+                    // 最も悪い候補のコストは下がる一方なので、違うコストになったら数え直す
+                    // 枠を持っている候補を1個目とする
+                    tie_cost_ = cost;
+                    tie_count_ = 1;
+                }
+                ++tie_count_;
+                return xorshift64(tie_break_state_) % tie_count_ == 0;
+            }
             vector<Candidate> finished_candidates_;
+            size_t best_finished_ = 0;
+            // split_pruned で分けた、ビームに入らなかった候補
+            vector<Candidate> pruned_;
+            // 長さ2以上の候補の action の列を並べたもの
+            vector<Action> runs_;
+            // 最もよい候補の添字(候補がなければ-1)
+            int best_ = -1;
+
+            // j番目の候補を書き換えた後に呼び、最もよい候補の添字を更新する
+            // 書き換えるのは同じ盤面でコストがよくなるときか、コストが最大の候補を追い出すときだけで、
+            // どの添字のコストも大きくならないので、最もよい候補を探し直す必要はない
+            // コストが等しいときは添字が小さいほうを選ぶ
+            void update_best(int j)
+            {
+                if (best_ == -1 || candidates_[j].cost < candidates_[best_].cost ||
+                    (candidates_[j].cost == candidates_[best_].cost && j < best_))
+                {
+                    best_ = j;
+                }
+            }
+
+            // 実行可能解の候補を取り除いたときに、最もよいものの添字を求め直す
+            void calc_best_finished()
+            {
+                best_finished_ = 0;
+                for (size_t i = 0; i < finished_candidates_.size(); ++i)
+                {
+                    if (finished_candidates_[i].cost < finished_candidates_[best_finished_].cost)
+                    {
+                        best_finished_ = i;
+                    }
+                }
+            }
+
+            // 候補を作る。長さ2以上の列は runs_ の末尾にコピーし、その位置を候補に持たせる
+            Candidate make_candidate(const Action *actions, size_t length, int parent, Cost cost)
+            {
+                Candidate candidate(actions[0], parent, cost);
+                if (length > 1)
+                {
+                    candidate.run = runs_.size();
+                    candidate.run_length = length;
+                    runs_.insert(runs_.end(), actions, actions + length);
+                }
+                return candidate;
+            }
 
             void construct_segment_tree()
             {
@@ -875,21 +2726,32 @@ namespace skip_beam_library
         class MultiSelectors
         {
         public:
-            explicit MultiSelectors(const Config &config) : config_(config)
+            // extra_width を指定すると、各ターンのビーム幅よりその個数だけ広く選ぶ(backtrack_width 参照)
+            explicit MultiSelectors(const Config &config, size_t extra_width = 0) : config_(config), extra_width_(extra_width)
             {
                 step_max_ = 1;
+                front_turn_ = 0;
             }
 
             // 候補を追加する
             // ターン数最小化型の問題で、candidateによって実行可能解が得られる場合にのみ finished = true とする
             // step は何ターン後に遷移するかを表す
             bool push(Action action, Cost cost, int parent, bool finished, size_t step)
+            {
+                return push_run(&action, 1, cost, parent, finished, step);
+            }
+
+            // 長さ length の action の列 actions を、step ターン後に遷移する1つの候補として追加する
+            // 選ばれると列をまとめて持つ1つのノードになり、パスを復元すると列の action が順に並ぶ
+            // step を列の長さと揃える必要はない
+            bool push_run(const Action *actions, size_t length, Cost cost, int parent, bool finished, size_t step)
             {
                 while (selectors_.size() < step)
                 {
                     selectors_.emplace_back(Selector(config_));
+                    selectors_.back().set_beam_width(config_.get_beam_width(front_turn_ + selectors_.size() - 1) + extra_width_);
                 }
-                if (selectors_[step - 1].push(action, cost, parent, finished))
+                if (selectors_[step - 1].push_run(actions, length, cost, parent, finished))
                 {
                     if (step > step_max_)
                     {
@@ -916,6 +2778,8 @@ namespace skip_beam_library
             {
                 Selector ret = move(selectors_.front());
                 selectors_.pop_front();
+                ++front_turn_;
+                ret.shrink_to_beam();
                 return ret;
             }
 
@@ -923,12 +2787,75 @@ namespace skip_beam_library
             void push_selector(Selector &&selector)
             {
                 selector.clear();
+                selector.set_beam_width(config_.get_beam_width(front_turn_ + selectors_.size()) + extra_width_);
                 selectors_.push_back(move(selector));
             }
 
+            // 後のターンに追加する候補(実行可能解を含む)が残っているか
+            bool has_candidates() const
+            {
+                for (const Selector &selector : selectors_)
+                {
+                    if (!selector.select().empty() || selector.have_finished())
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            // 全ての候補を捨て、front_turn ターン目の候補から持ち直す
+            // 候補が1つも追加されなくても pop_selector できるように、空のSelectorを1つ置いておく
+            void restart(int front_turn)
+            {
+                selectors_.clear();
+                front_turn_ = front_turn;
+                selectors_.emplace_back(Selector(config_));
+                selectors_.back().set_beam_width(config_.get_beam_width(front_turn_) + extra_width_);
+            }
+
+            // 保持している全てのSelectorから、predを満たす候補を取り除く
+            template <class Predicate>
+            void remove_candidates_if(Predicate pred)
+            {
+                for (Selector &selector : selectors_)
+                {
+                    selector.remove_if(pred);
+                }
+            }
+
+#ifdef THUNDER_CHECKPOINT
+            // チェックポイントに保存する
+            void save(CheckpointWriter &writer) const
+            {
+                writer.write(front_turn_);
+                writer.write(selectors_.size());
+                for (const Selector &selector : selectors_)
+                {
+                    selector.save(writer);
+                }
+            }
+
+            // save で保存した状態を読み込む
+            void load(CheckpointReader &reader)
+            {
+                reader.read(front_turn_);
+                size_t num_selectors = reader.read<size_t>();
+                selectors_.clear();
+                for (size_t i = 0; i < num_selectors; ++i)
+                {
+                    selectors_.emplace_back(Selector(config_));
+                    selectors_.back().load(reader);
+                }
+            }
+#endif
+
         private:
             Config config_;
+            size_t extra_width_;
+            // selectors_[k] は front_turn_ + k ターン目に追加するノードの候補を持つ
             deque<Selector> selectors_;
+            int front_turn_;
             size_t step_max_;
         };
 
@@ -940,6 +2867,8 @@ namespace skip_beam_library
             int parent, child, left, right;
             bool active;
             int remove_check_turn;
+            // 長さ2以上の action の列を持つときの、Tree 内での列の位置と長さ
+            int run, run_length;
 
             // 根のコンストラクタ
             Node(Action action, Cost cost) : action(action),
@@ -949,7 +2878,9 @@ namespace skip_beam_library
                                              left(-1),
                                              right(-1),
                                              active(true),
-                                             remove_check_turn(-1) {}
+                                             remove_check_turn(-1),
+                                             run(-1),
+                                             run_length(1) {}
 
             // 通常のコンストラクタ
             Node(const Candidate &candidate, int right) : action(candidate.action),
@@ -959,7 +2890,9 @@ namespace skip_beam_library
                                                           left(-1),
                                                           right(right),
                                                           active(true),
-                                                          remove_check_turn(-1) {}
+                                                          remove_check_turn(-1),
+                                                          run(-1),
+                                                          run_length(1) {}
         };
 
         // 二重連鎖木に対する操作をまとめたクラス
@@ -970,11 +2903,15 @@ namespace skip_beam_library
             {
                 nodes_.reserve(nodes_capacity);
                 root_ = nodes_.push(root);
+                committed_ = root_;
             }
 
             // 状態を更新しながら深さ優先探索を行い、次のノードの候補を全てselectorに追加する
             void dfs(MultiSelectors &multi_selectors, int turn)
             {
+                THUNDER_PROFILE_SCOPE("dfs");
+                THUNDER_TRACE_SCOPE("dfs");
+                THUNDER_PERF_SCOPE("dfs");
                 remove_useless_nodes(turn);
                 update_root(turn);
 
@@ -991,7 +2928,10 @@ namespace skip_beam_library
                     v = move_to_leaf(v);
 
                     multi_selectors.reset_step_max();
-                    state_.expand(v, multi_selectors);
+                    {
+                        THUNDER_PROFILE_SCOPE("expand");
+                        state_.expand(v, multi_selectors);
+                    }
                     while (remove_nodes_.size() < multi_selectors.get_step_max())
                     {
                         remove_nodes_.emplace_back();
@@ -1016,19 +2956,159 @@ namespace skip_beam_library
                 vector<Action> path;
                 while (nodes_[v].parent != -1)
                 {
-                    path.push_back(nodes_[v].action);
+                    // 列は後ろから積む
+                    const Action *run = get_run(v);
+                    for (int i = nodes_[v].run_length - 1; i >= 0; --i)
+                    {
+                        path.push_back(run[i]);
+                    }
                     v = nodes_[v].parent;
                 }
                 reverse(path.begin(), path.end());
                 return path;
             }
 
+            // 各候補の根からのパスをまとめて取得する
+            // 親をたどる途中で既にたどったノードに合流したら、そこから先はトライ木のノードを共有する
+            // 戻り値のk番目のパスはcandidates[k]に対応する
+            // candidates は selector が持つ候補で、長さ2以上の列はトライ木では1つの action ごとのノードになる
+            Paths get_paths(const vector<Candidate> &candidates, const Selector &selector)
+            {
+                Paths paths;
+                vector<int> node_to_trie(nodes_.size(), -1);
+                vector<int> stack;
+                for (const Candidate &candidate : candidates)
+                {
+                    int v = candidate.parent;
+                    while (nodes_[v].parent != -1 && node_to_trie[v] == -1)
+                    {
+                        stack.push_back(v);
+                        v = nodes_[v].parent;
+                    }
+                    int parent = nodes_[v].parent == -1 ? -1 : node_to_trie[v];
+                    while (!stack.empty())
+                    {
+                        int u = stack.back();
+                        stack.pop_back();
+                        const Action *run = get_run(u);
+                        for (int i = 0; i < nodes_[u].run_length; ++i)
+                        {
+                            parent = paths.add_node(parent, run[i]);
+                        }
+                        node_to_trie[u] = parent;
+                    }
+                    const Action *run = selector.get_run(candidate);
+                    for (int i = 0; i < candidate.run_length; ++i)
+                    {
+                        parent = paths.add_node(parent, run[i]);
+                    }
+                    paths.ends.push_back(parent);
+                    paths.costs.push_back(candidate.cost);
+                }
+                return paths;
+            }
+
+            // 根から葉best_leafに向かう最初のノードを確定し、そのノードのactionの列を返す
+            // 確定済みのノードから root_ までが一本道なら、それを1つ進めるだけでよい
+            // そうでなければ、確定しなかった根の子の部分木を削除して root_ を進める
+            // 削除したノードを親とする候補は、multi_selectorsからも取り除く
+            vector<Action> commit(int best_leaf, MultiSelectors &multi_selectors)
+            {
+                THUNDER_PROFILE_SCOPE("commit");
+                THUNDER_TRACE_SCOPE("commit");
+                THUNDER_PERF_SCOPE("commit");
+                if (committed_ != root_)
+                {
+                    int v = root_;
+                    while (nodes_[v].parent != committed_)
+                    {
+                        v = nodes_[v].parent;
+                    }
+                    committed_ = v;
+                    return get_actions(v);
+                }
+
+                int child = best_leaf;
+                while (nodes_[child].parent != root_)
+                {
+                    child = nodes_[child].parent;
+                }
+
+                // 確定しなかった子の部分木を削除する
+                vector<bool> removed(nodes_.size(), false);
+                vector<int> stack;
+                for (int u = nodes_[root_].child; u != -1; u = nodes_[u].right)
+                {
+                    if (u != child)
+                    {
+                        stack.push_back(u);
+                    }
+                }
+                while (!stack.empty())
+                {
+                    int u = stack.back();
+                    stack.pop_back();
+                    removed[u] = true;
+                    for (int w = nodes_[u].child; w != -1; w = nodes_[w].right)
+                    {
+                        stack.push_back(w);
+                    }
+                    remove_node(u);
+                }
+                nodes_[root_].child = child;
+                nodes_[child].left = -1;
+                nodes_[child].right = -1;
+                for (vector<int> &remove_nodes : remove_nodes_)
+                {
+                    erase_if(remove_nodes, [&](int v)
+                             { return removed[v]; });
+                }
+                int old_root = root_;
+                multi_selectors.remove_candidates_if([&](const Candidate &candidate)
+                                                     { return candidate.parent == old_root || removed[candidate.parent]; });
+
+                root_ = child;
+                committed_ = child;
+                move_forward(child);
+                return get_actions(child);
+            }
+
+            // 根の子として複数の初期状態を置き、それらを葉とする
+            // 構築直後に呼ぶ
+            void set_roots(const vector<Root> &roots)
+            {
+                for (const Root &root : roots)
+                {
+                    Candidate candidate(root.action, root_, root.cost);
+                    add_leaf(candidate, &candidate.action);
+                }
+            }
+
+            // 選ばれた候補を全て新しいノードとして追加する
+            void add_leaves(const Selector &selector)
+            {
+                THUNDER_TRACE_SCOPE("add_leaf");
+                THUNDER_PERF_SCOPE("add_leaf");
+                for (const Candidate &candidate : selector.select())
+                {
+                    add_leaf(candidate, selector.get_run(candidate));
+                }
+                THUNDER_TRACE_COUNTER("live_nodes", nodes_.live_size());
+            }
+
             // 新しいノードを追加する
-            int add_leaf(const Candidate &candidate)
+            // run は候補の action の列の先頭(Selector::get_run)。列を持たない候補は &candidate.action を渡す
+            int add_leaf(const Candidate &candidate, const Action *run)
             {
+                THUNDER_PROFILE_SCOPE("add_leaf");
                 int parent = candidate.parent;
                 int sibling = nodes_[parent].child;
                 int v = nodes_.push(Node(candidate, sibling));
+                if (candidate.run_length > 1)
+                {
+                    nodes_[v].run = runs_.push(run, candidate.run_length);
+                    nodes_[v].run_length = candidate.run_length;
+                }
 
                 nodes_[parent].child = v;
 
@@ -1052,21 +3132,186 @@ namespace skip_beam_library
                 return v;
             }
 
+            // 探索木を捨て、layer のパスの終点を葉とする木から探索をやり直す
+            // layer のパスは根から始まる
+            void restart(const typename Frontier::Layer &layer)
+            {
+                THUNDER_PROFILE_SCOPE("restart");
+                // state_ を根まで戻す
+                int v = root_;
+                while (nodes_[v].parent != -1)
+                {
+                    move_backward(v);
+                    v = nodes_[v].parent;
+                }
+                Node root(nodes_[v].action, nodes_[v].cost);
+                nodes_.clear();
+                runs_.clear();
+                root_ = nodes_.push(root);
+                committed_ = root_;
+                for (vector<int> &remove_nodes : remove_nodes_)
+                {
+                    remove_nodes.clear();
+                }
+
+                // トライ木のノードを親から順に木のノードにする
+                // トライ木では親のほうがインデックスが小さい
+                vector<int> end_index(layer.nodes.size(), -1);
+                for (size_t k = 0; k < layer.size(); ++k)
+                {
+                    end_index[layer.ends[k]] = k;
+                }
+                vector<int> trie_to_node(layer.nodes.size());
+                for (size_t u = 0; u < layer.nodes.size(); ++u)
+                {
+                    auto [trie_parent, action] = layer.nodes[u];
+                    int parent = trie_parent == -1 ? root_ : trie_to_node[trie_parent];
+                    // 途中のノードは展開しないので、コストは使わない
+                    Cost cost = end_index[u] == -1 ? Cost() : layer.costs[end_index[u]];
+                    Candidate candidate(action, parent, cost);
+                    trie_to_node[u] = add_leaf(candidate, &candidate.action);
+                }
+            }
+
+#ifdef THUNDER_CHECKPOINT
+            // チェックポイントに保存する
+            void save(CheckpointWriter &writer) const
+            {
+                nodes_.save(writer);
+                runs_.save(writer);
+                writer.write(root_);
+                writer.write(committed_);
+                writer.write(remove_nodes_.size());
+                for (const vector<int> &remove_nodes : remove_nodes_)
+                {
+                    writer.write_vector(remove_nodes);
+                }
+                if constexpr (CheckpointableState<State<MultiSelectors>>)
+                {
+                    state_.save(writer);
+                }
+            }
+
+            // save で保存した状態を読み込む
+            // 構築直後(state_ が根の状態)に呼ぶ
+            // State が save, load を実装していなければ、根から root_ までのactionをたどって復元する
+            void load(CheckpointReader &reader)
+            {
+                nodes_.load(reader);
+                runs_.load(reader);
+                reader.read(root_);
+                reader.read(committed_);
+                remove_nodes_.resize(reader.read<size_t>());
+                for (vector<int> &remove_nodes : remove_nodes_)
+                {
+                    reader.read_vector(remove_nodes);
+                }
+                if constexpr (CheckpointableState<State<MultiSelectors>>)
+                {
+                    state_.load(reader);
+                }
+                else
+                {
+                    for (const Action &action : get_path(root_))
+                    {
+                        state_.move_forward(action);
+                    }
+                }
+            }
+#endif
+
         private:
             State<MultiSelectors> state_;
             ObjectPool<Node> nodes_;
+            // ノードが持つ長さ2以上の action の列
+            RunPool<Action> runs_;
             int root_;
+            // 確定済みのノード。root_ はこのノードの子孫
+            int committed_;
             deque<vector<int>> remove_nodes_;
 
+            // ノードvの action の列の先頭を返す
+            const Action *get_run(int v)
+            {
+                return nodes_[v].run == -1 ? &nodes_[v].action : &runs_[nodes_[v].run];
+            }
+
+            // ノードvの action の列を返す
+            vector<Action> get_actions(int v)
+            {
+                const Action *run = get_run(v);
+                return vector<Action>(run, run + nodes_[v].run_length);
+            }
+
+            // ノードvの action の列で state_ を進める
+            // State が move_forward_run を実装していればまとめて、そうでなければ1つずつ進める
+            void move_forward(int v)
+            {
+                if (nodes_[v].run == -1)
+                {
+                    state_.move_forward(nodes_[v].action);
+                    return;
+                }
+                const Action *run = &runs_[nodes_[v].run];
+                int length = nodes_[v].run_length;
+                if constexpr (RunState<State<MultiSelectors>, Action>)
+                {
+                    state_.move_forward_run(run, length);
+                }
+                else
+                {
+                    for (int i = 0; i < length; ++i)
+                    {
+                        state_.move_forward(run[i]);
+                    }
+                }
+            }
+
+            // ノードvの action の列の分だけ state_ を戻す
+            void move_backward(int v)
+            {
+                if (nodes_[v].run == -1)
+                {
+                    state_.move_backward(nodes_[v].action);
+                    return;
+                }
+                const Action *run = &runs_[nodes_[v].run];
+                int length = nodes_[v].run_length;
+                if constexpr (RunState<State<MultiSelectors>, Action>)
+                {
+                    state_.move_backward_run(run, length);
+                }
+                else
+                {
+                    for (int i = length - 1; i >= 0; --i)
+                    {
+                        state_.move_backward(run[i]);
+                    }
+                }
+            }
+
+            // ノードvを削除する
+            void remove_node(int v)
+            {
+                if (nodes_[v].run != -1)
+                {
+                    runs_.pop(nodes_[v].run, nodes_[v].run_length);
+                }
+                nodes_.pop(v);
+            }
+
             // 根から一本道の部分は往復しないようにする
             void update_root(int turn)
             {
+                THUNDER_PROFILE_SCOPE("update_root");
+                THUNDER_TRACE_SCOPE("update_root");
+                THUNDER_PERF_SCOPE("update_root");
                 int child = nodes_[root_].child;
                 // 後で子供が追加されうるノードはスキップしないようにする
                 while (child != -1 && nodes_[child].right == -1 && nodes_[root_].remove_check_turn <= turn)
                 {
                     root_ = child;
-                    state_.move_forward(nodes_[child].action);
+                    move_forward(child);
                     child = nodes_[child].child;
                 }
             }
@@ -1084,7 +3329,7 @@ namespace skip_beam_library
                     }
                     nodes_[v].active = false;
                     v = child;
-                    state_.move_forward(nodes_[child].action);
+                    move_forward(child);
                     child = nodes_[child].child;
                 }
                 nodes_[v].active = false;
@@ -1096,7 +3341,7 @@ namespace skip_beam_library
             {
                 while (v != root_)
                 {
-                    state_.move_backward(nodes_[v].action);
+                    move_backward(v);
 
                     // activeなノードが見つかるまで右に移動する
                     int u = nodes_[v].right;
@@ -1104,7 +3349,7 @@ namespace skip_beam_library
                     {
                         if (nodes_[u].active)
                         {
-                            state_.move_forward(nodes_[u].action);
+                            move_forward(u);
                             return u;
                         }
                         u = nodes_[u].right;
@@ -1118,6 +3363,9 @@ namespace skip_beam_library
             // 不要になったノードを全て削除する
             void remove_useless_nodes(int turn)
             {
+                THUNDER_PROFILE_SCOPE("remove_useless_nodes");
+                THUNDER_TRACE_SCOPE("remove_useless_nodes");
+                THUNDER_PERF_SCOPE("remove_useless_nodes");
                 if (remove_nodes_.empty())
                 {
                     return;
@@ -1158,7 +3406,7 @@ namespace skip_beam_library
                             cerr << "ERROR: root is removed" << endl;
                             exit(-1);
                         }
-                        nodes_.pop(v);
+                        remove_node(v);
                         nodes_[parent].child = right;
                         if (right != -1)
                         {
@@ -1169,7 +3417,7 @@ namespace skip_beam_library
                     }
                     else
                     {
-                        nodes_.pop(v);
+                        remove_node(v);
                         nodes_[left].right = right;
                         if (right != -1)
                         {
@@ -1181,15 +3429,183 @@ namespace skip_beam_library
             }
         };
 
+        // ローリングホライズン(オンライン)で探索するためのクラス
+        // step(turns) で探索をturnsターン深くしてから、根から最もよい葉に向かう最初のactionを確定して返す
+        // 確定しなかった根の子の部分木は削除し、残った部分木は次のstepでそのまま使うので、
+        // 毎回最初から探索し直す場合と違い、ビーム幅分の葉を作り直さずに済む
+        // 初回はビームの深さ分、2回目以降は1ターンずつ深くするのが基本的な使い方
+        class RollingSearch
+        {
+        public:
+            explicit RollingSearch(const Config &config, const State<MultiSelectors> &state, const Node &root) : tree_(state, config.nodes_capacity, root),
+                                                                                                                  multi_selectors_(config),
+                                                                                                                  turn_(0),
+                                                                                                                  best_leaf_(-1) {}
+
+            // 探索をturnsターン深くしてから、actionを1つ確定して返す
+            // 実行可能解が見つかった後は、そのパスに沿ってactionを返す
+            // 最後のターンに葉が追加されなかったときは、後のターンの候補が残っていれば葉が追加されるまで探索を続ける
+            // 返すactionがないとき(候補が残っていないとき、実行可能解のパスを返し終えたとき)はnulloptを返す
+            optional<Action> step(int turns)
+            {
+                if (!finished_path_.empty())
+                {
+                    if (finished_path_index_ == finished_path_.size())
+                    {
+                        return nullopt;
+                    }
+                    return finished_path_[finished_path_index_++];
+                }
+
+                for (int turn = 0; turn < turns; ++turn, ++turn_)
+                {
+                    // Euler Tour で selector に候補を追加する
+                    tree_.dfs(multi_selectors_, turn_);
+
+                    Selector selector = multi_selectors_.pop_selector();
+                    if (selector.have_finished())
+                    {
+                        // 実行可能解が見つかったら、以降はそのパスをたどる
+                        const Candidate &candidate = selector.get_best_finished_candidate();
+                        finished_path_ = tree_.get_path(candidate.parent);
+                        selector.append_run(candidate, finished_path_);
+                        finished_path_index_ = committed_size_;
+                        return step(0);
+                    }
+
+                    // 新しいノードを追加し、最もよい葉を覚えておく
+                    best_leaf_ = -1;
+                    Cost best_cost = numeric_limits<Cost>::max();
+                    for (const Candidate &candidate : selector.select())
+                    {
+                        int v = tree_.add_leaf(candidate, selector.get_run(candidate));
+                        if (best_leaf_ == -1 || candidate.cost < best_cost)
+                        {
+                            best_leaf_ = v;
+                            best_cost = candidate.cost;
+                        }
+                    }
+                    THUNDER_PERF_TURN_END();
+
+                    // Selector を使い回す
+                    multi_selectors_.push_selector(move(selector));
+                }
+                if (pending_index_ < pending_.size())
+                {
+                    // 確定したノードの列の残りを返す
+                    ++committed_size_;
+                    return pending_[pending_index_++];
+                }
+                if (best_leaf_ == -1)
+                {
+                    if (!multi_selectors_.has_candidates())
+                    {
+                        return nullopt;
+                    }
+                    return step(1);
+                }
+                pending_ = tree_.commit(best_leaf_, multi_selectors_);
+                pending_index_ = 1;
+                ++committed_size_;
+                return pending_[0];
+            }
+
+        private:
+            Tree tree_;
+            MultiSelectors multi_selectors_;
+            int turn_;
+            int best_leaf_;
+            // 確定したactionの個数
+            size_t committed_size_ = 0;
+            // 確定したノードが長さ2以上の列を持つときは、残りを1つずつ返す
+            vector<Action> pending_;
+            size_t pending_index_ = 0;
+            vector<Action> finished_path_;
+            size_t finished_path_index_ = 0;
+        };
+
+#ifdef THUNDER_CHECKPOINT
+        // beam_search の途中経過を config.checkpoint_path に保存する
+        // next_turn は再開したときに最初に探索するターン
+        void save_checkpoint(const Config &config, int next_turn, const Frontier &frontier, int backtracks,
+                             Cost stall_best_cost, int stall_turns, const Tree &tree, const MultiSelectors &multi_selectors) const
+        {
+            THUNDER_PROFILE_SCOPE("checkpoint");
+            CheckpointWriter writer(config.checkpoint_path);
+            // 読み込むときに設定や型が変わっていないかを確認するための値
+            writer.write(sizeof(Action));
+            writer.write(sizeof(Cost));
+            writer.write(config.beam_width);
+            writer.write(config.max_turn);
+            writer.write(config.backtrack_width);
+
+            writer.write(next_turn);
+            frontier.save(writer);
+            writer.write(backtracks);
+            writer.write(stall_best_cost);
+            writer.write(stall_turns);
+            tree.save(writer);
+            multi_selectors.save(writer);
+            writer.commit();
+        }
+
+        // save_checkpoint で保存した途中経過を読み込み、再開するターンを返す
+        int load_checkpoint(const Config &config, Frontier &frontier, int &backtracks,
+                            Cost &stall_best_cost, int &stall_turns, Tree &tree, MultiSelectors &multi_selectors) const
+        {
+            THUNDER_PROFILE_SCOPE("checkpoint");
+            CheckpointReader reader(config.checkpoint_path);
+            reader.expect(sizeof(Action), "sizeof(Action)");
+            reader.expect(sizeof(Cost), "sizeof(Cost)");
+            reader.expect(config.beam_width, "beam_width");
+            reader.expect(config.max_turn, "max_turn");
+            reader.expect(config.backtrack_width, "backtrack_width");
+
+            int next_turn = reader.read<int>();
+            frontier.load(reader);
+            reader.read(backtracks);
+            reader.read(stall_best_cost);
+            reader.read(stall_turns);
+            tree.load(reader);
+            multi_selectors.load(reader);
+            return next_turn;
+        }
+#endif
+
         // ビームサーチを行う関数
-        vector<Action> beam_search(const Config &config, State<MultiSelectors> state, Node root)
+        // roots を渡すと、root を仮想的な根としてその子の複数の初期状態から同時に探索する
+        // 初期状態どうしも同じSelectorで競わせるので、初期状態ごとに探索する場合と違い、木は1つで済む
+        // このとき返すパスの先頭は、どの初期状態から始めたかを表す roots[k].action になる
+        vector<Action> beam_search(const Config &config, State<MultiSelectors> state, Node root, const vector<Root> &roots = {})
         {
             Tree tree(state, config.nodes_capacity, root);
+            tree.set_roots(roots);
 
             // 新しいノード候補の集合
-            MultiSelectors multi_selectors(config);
-
-            for (int turn = 0; turn < config.max_turn; ++turn)
+            // ビームに入らなかった候補も覚えるときは、その分だけ広く選んでおいて後で分ける
+            MultiSelectors multi_selectors(config, config.backtrack_width);
+
+            // backtrack_width を指定したときに、ビームに入らなかった候補を覚えておく
+            Frontier frontier(config.backtrack_width);
+            int backtracks = 0;
+            // backtrack_stall_turns を指定したときに、ビーム内の最もよいコストが更新されなかったターン数を数える
+            Cost stall_best_cost = numeric_limits<Cost>::max();
+            int stall_turns = 0;
+
+            int start_turn = 0;
+#ifdef THUNDER_CHECKPOINT
+            if (config.resume_from_checkpoint && CheckpointReader::exists(config.checkpoint_path))
+            {
+                start_turn = load_checkpoint(config, frontier, backtracks, stall_best_cost, stall_turns, tree, multi_selectors);
+            }
+#else
+            if (config.checkpoint_interval > 0 || config.resume_from_checkpoint)
+            {
+                cerr << "ERROR: checkpoint_interval and resume_from_checkpoint require THUNDER_CHECKPOINT" << endl;
+                exit(-1);
+            }
+#endif
+            for (int turn = start_turn; turn < config.max_turn; ++turn)
             {
                 // Euler Tour で selector に候補を追加する
                 tree.dfs(multi_selectors, turn);
@@ -1198,27 +3614,130 @@ namespace skip_beam_library
                 if (selector.have_finished())
                 {
                     // ターン数最小化型の問題で実行可能解が見つかったとき
-                    Candidate candidate = selector.get_finished_candidates()[0];
+                    const Candidate &candidate = selector.get_best_finished_candidate();
                     vector<Action> ret = tree.get_path(candidate.parent);
-                    ret.push_back(candidate.action);
+                    selector.append_run(candidate, ret);
                     return ret;
                 }
 
-                if (turn == config.max_turn - 1)
+                if (frontier.enabled() && backtracks < config.max_backtracks &&
+                    timer_library::timer.getTime() <= config.time_limit)
+                {
+                    // 実行可能解が見つかる前にビームが途絶えたか、行き詰まったときは、覚えている候補からやり直す
+                    // 後のターンに追加する候補が残っていれば、まだ途絶えていない
+                    bool dead = selector.select().empty() && !multi_selectors.has_candidates();
+                    bool stalled = false;
+                    if (!selector.select().empty() && config.backtrack_stall_turns > 0)
+                    {
+                        Cost cost = selector.calc_best_candidate().cost;
+                        if (cost < stall_best_cost)
+                        {
+                            stall_best_cost = cost;
+                            stall_turns = 0;
+                        }
+                        else
+                        {
+                            stalled = ++stall_turns >= config.backtrack_stall_turns;
+                        }
+                    }
+                    if (dead || stalled)
+                    {
+                        // 途絶えたときはこのターン以前、行き詰まったときは今より浅いターンの候補を使う
+                        typename Frontier::Layer layer;
+                        int restart_turn = frontier.pop(dead ? turn : turn - 1, layer);
+                        if (restart_turn != -1)
+                        {
+                            tree.restart(layer);
+                            // restart_turn ターン目の候補が葉になったので、次は restart_turn + 1 ターン目を探索する
+                            multi_selectors.restart(restart_turn + 1);
+                            ++backtracks;
+                            stall_best_cost = numeric_limits<Cost>::max();
+                            stall_turns = 0;
+                            turn = restart_turn;
+                            continue;
+                        }
+                    }
+                }
+
+                if (turn == config.max_turn - 1 ||
+                    (!selector.select().empty() && timer_library::timer.getTime() > config.time_limit))
                 {
-                    // 最終ターン
-                    Candidate candidate = selector.calc_best_candidate();
+                    // 最終ターン、または制限時間を過ぎたとき
+                    const Candidate &candidate = selector.calc_best_candidate();
                     vector<Action> ret = tree.get_path(candidate.parent);
-                    ret.push_back(candidate.action);
+                    selector.append_run(candidate, ret);
                     return ret;
                 }
 
+                if (frontier.enabled())
+                {
+                    // ビームに入らなかった候補を、根からのパスにして覚えておく
+                    const vector<Candidate> &pruned = selector.split_pruned(config.get_beam_width(turn));
+                    if (!pruned.empty())
+                    {
+                        vector<Cost> leaves;
+                        leaves.reserve(pruned.size());
+                        for (const Candidate &candidate : pruned)
+                        {
+                            leaves.push_back(candidate.cost);
+                        }
+                        frontier.record(turn, tree.get_paths(pruned, selector), move(leaves));
+                    }
+                }
+
                 // 新しいノードを追加する
-                for (const Candidate &candidate : selector.select())
+                tree.add_leaves(selector);
+                THUNDER_PERF_TURN_END();
+
+                // Selector を使い回す
+                multi_selectors.push_selector(move(selector));
+
+#ifdef THUNDER_CHECKPOINT
+                if (config.checkpoint_interval > 0 && (turn + 1) % config.checkpoint_interval == 0)
+                {
+                    save_checkpoint(config, turn + 1, frontier, backtracks, stall_best_cost, stall_turns, tree, multi_selectors);
+                }
+#endif
+            }
+            assert(false);
+            return {};
+        }
+
+        // ビームサーチを行い、評価がよい順に最大k個の解のパスを返す
+        // 最終ターンのSelectorに残った候補(実行可能解が見つかった場合はその候補)からk個を選ぶ
+        // k回ビームサーチをする場合と違い、探索は1回で済む
+        // roots は beam_search と同じ
+        Paths beam_search_top_k(const Config &config, State<MultiSelectors> state, Node root, size_t k, const vector<Root> &roots = {})
+        {
+            Tree tree(state, config.nodes_capacity, root);
+            tree.set_roots(roots);
+
+            // 新しいノード候補の集合
+            MultiSelectors multi_selectors(config);
+
+            for (int turn = 0; turn < config.max_turn; ++turn)
+            {
+                // Euler Tour で selector に候補を追加する
+                tree.dfs(multi_selectors, turn);
+
+                Selector selector = multi_selectors.pop_selector();
+                if (selector.have_finished())
+                {
+                    // ターン数最小化型の問題で実行可能解が見つかったとき
+                    return tree.get_paths(selector.calc_top_k_finished_candidates(k), selector);
+                }
+
+                if (turn == config.max_turn - 1 ||
+                    (!selector.select().empty() && timer_library::timer.getTime() > config.time_limit))
                 {
-                    tree.add_leaf(candidate);
+                    // 最終ターン、または制限時間を過ぎたとき
+                    return tree.get_paths(selector.calc_top_k_candidates(k), selector);
                 }
 
+                // 新しいノードを追加する
+                tree.add_leaves(selector);
+                THUNDER_PERF_TURN_END();
+
                 // Selector を使い回す
                 multi_selectors.push_selector(move(selector));
             }
@@ -2,41 +2,188 @@
 // プログラムの実行時間を計測するライブラリ
 // インクルードした時点から計測が開始されるため、
 // ユーザ側は何も気にせずtimer.getTime()を呼べば現時点の実行時間がわかる
+// ループの中など、呼び出し回数が多い場所ではtimer.elapsed_cycles()を使うと
+// rdtscを読むだけなので軽い
+// THUNDER_PROFILE を define してからインクルードすると、
+// THUNDER_PROFILE_SCOPE("ラベル") を書いた区間のサイクル数をラベルごとに集計し、
+// プログラム終了時に標準エラー出力に表示する。
+// define しなければ THUNDER_PROFILE_SCOPE は何もしない。
 /**************************************************************/
 #pragma once
 #ifndef TIMER_HPP
 #define TIMER_HPP
 #include <bits/stdc++.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 // 内部のusing namespace std;が他のプログラムを破壊する可能性があるため、
 // ライブラリ全体をnamespaceで囲っている。
 namespace timer_library
 {
     using namespace std;
 
+    //@brief CPUのサイクル数を読む
+    //@note x86以外ではsteady_clockのナノ秒で代用する
+    inline uint64_t read_cycles()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
     //@brief プログラムの実行時間を計測する
     struct Timer
     {
-        chrono::system_clock::time_point start;
+        chrono::steady_clock::time_point start;
+        uint64_t start_cycles;
 
         Timer()
         {
-            start = chrono::system_clock::now();
+            reset();
         }
 
         void reset()
         {
-            start = chrono::system_clock::now();
+            start = chrono::steady_clock::now();
+            start_cycles = read_cycles();
         }
 
         //@brief プログラムの実行時間を取得する
         //@return プログラムの実行時間(秒)
         double getTime()
         {
-            auto now = chrono::system_clock::now();
+            auto now = chrono::steady_clock::now();
             return chrono::duration<double>(now - start).count();
         }
+
+        //@brief 計測開始からのサイクル数を取得する
+        //@note getTimeより軽いので、呼び出し回数が多い場所での時間確認に使う
+        uint64_t elapsed_cycles() const
+        {
+            return read_cycles() - start_cycles;
+        }
+
+        //@brief 1秒あたりのサイクル数を返す
+        //@note 初回の呼び出し時に数ミリ秒かけてsteady_clockと比べて較正する
+        static double get_cycles_per_second()
+        {
+            static const double cycles_per_second = []()
+            {
+#if defined(__x86_64__) || defined(__i386__)
+                auto begin = chrono::steady_clock::now();
+                uint64_t begin_cycles = read_cycles();
+                while (chrono::steady_clock::now() - begin < chrono::milliseconds(5))
+                {
+                }
+                auto end = chrono::steady_clock::now();
+                uint64_t end_cycles = read_cycles();
+                return (end_cycles - begin_cycles) / chrono::duration<double>(end - begin).count();
+#else
+                return 1e9;
+#endif
+            }();
+            return cycles_per_second;
+        }
+
+        //@brief サイクル数を秒に変換する
+        double cycles_to_seconds(uint64_t cycles)
+        {
+            return cycles / get_cycles_per_second();
+        }
+
+        //@brief プログラムの実行時間をサイクル数から計算して取得する
+        //@return プログラムの実行時間(秒)
+        double getFastTime()
+        {
+            return cycles_to_seconds(elapsed_cycles());
+        }
     };
     Timer timer;
+
+    //@brief THUNDER_PROFILE_SCOPE で計測する区間のラベルごとの集計値
+    //@note 複数のスレッドから同時に加算してもよい
+    struct ProfileSection
+    {
+        const char *label;
+        atomic<uint64_t> cycles = 0;
+        atomic<uint64_t> count = 0;
+
+        explicit ProfileSection(const char *label) : label(label)
+        {
+            lock_guard<mutex> lock(sections_mutex());
+            sections().push_back(this);
+        }
+
+        //@brief 登録された全ての区間
+        //@note プログラム終了時の表示より先に破棄されないように、解放しない
+        static vector<ProfileSection *> &sections()
+        {
+            static vector<ProfileSection *> *sections = new vector<ProfileSection *>();
+            return *sections;
+        }
+
+        static mutex &sections_mutex()
+        {
+            static mutex *m = new mutex();
+            return *m;
+        }
+
+        //@brief 全ての区間の集計値を表示する
+        static void print(ostream &os)
+        {
+            lock_guard<mutex> lock(sections_mutex());
+            for (ProfileSection *section : sections())
+            {
+                uint64_t cycles = section->cycles;
+                uint64_t count = section->count;
+                os << "[profile] " << section->label
+                   << " " << timer.cycles_to_seconds(cycles) << " sec"
+                   << " count " << count
+                   << " cycles/call " << (count == 0 ? 0 : cycles / count) << "\n";
+            }
+        }
+    };
+
+    //@brief スコープに入ってから出るまでのサイクル数をsectionに加算する
+    struct ScopedProfile
+    {
+        ProfileSection &section;
+        uint64_t begin;
+
+        explicit ScopedProfile(ProfileSection &section) : section(section), begin(read_cycles()) {}
+
+        ~ScopedProfile()
+        {
+            section.cycles.fetch_add(read_cycles() - begin, memory_order_relaxed);
+            section.count.fetch_add(1, memory_order_relaxed);
+        }
+    };
+
+#ifdef THUNDER_PROFILE
+    //@brief プログラム終了時に集計値を表示する
+    struct ProfileReporter
+    {
+        ~ProfileReporter()
+        {
+            ProfileSection::print(clog);
+        }
+    };
+    ProfileReporter profile_reporter;
+#endif
 } // namespace timer_library
 using namespace timer_library;
-#endif
\ No newline at end of file
+
+#define THUNDER_PROFILE_CONCAT_IMPL(a, b) a##b
+#define THUNDER_PROFILE_CONCAT(a, b) THUNDER_PROFILE_CONCAT_IMPL(a, b)
+#ifdef THUNDER_PROFILE
+// このマクロを書いた行からスコープの終わりまでのサイクル数を label ごとに集計する
+// 集計値はプログラム終了時の表示より先に破棄されないように、解放しない
+#define THUNDER_PROFILE_SCOPE(label)                                                                                             \
+    static timer_library::ProfileSection &THUNDER_PROFILE_CONCAT(thunder_profile_section_, __LINE__) = *new timer_library::ProfileSection(label); \
+    timer_library::ScopedProfile THUNDER_PROFILE_CONCAT(thunder_profile_scope_, __LINE__)(THUNDER_PROFILE_CONCAT(thunder_profile_section_, __LINE__))
+#else
+#define THUNDER_PROFILE_SCOPE(label)
+#endif
+#endif
@@ -0,0 +1,152 @@
+/**************************************************************/
+// 探索の各フェーズをタイムラインとして記録するライブラリ
+// THUNDER_TRACE を define してからインクルードすると、
+// THUNDER_TRACE_SCOPE("ラベル") を書いた区間と
+// THUNDER_TRACE_COUNTER("名前", 値) で記録した値を
+// プログラム終了時に Chrome trace event 形式のJSONに書き出す。
+// chrome://tracing や https://ui.perfetto.dev で開くと、
+// ターンごとの dfs や update の時間、Euler Tourの長さなどを時系列で確認できる。
+// 出力先は THUNDER_TRACE_FILE で変更できる(デフォルトは trace.json)。
+// イベントはリングバッファに保存するので、バッファがあふれたときは古いものから捨てる。
+// バッファの大きさは THUNDER_TRACE_CAPACITY で変更できる。
+// define しなければマクロは何もしないので、ライブラリに書いたままでもオーバーヘッドはない。
+/**************************************************************/
+#pragma once
+#ifndef TRACE_HPP
+#define TRACE_HPP
+#include <bits/stdc++.h>
+#include "timer.cpp"
+#ifndef THUNDER_TRACE_FILE
+#define THUNDER_TRACE_FILE "trace.json"
+#endif
+#ifndef THUNDER_TRACE_CAPACITY
+#define THUNDER_TRACE_CAPACITY (1 << 18)
+#endif
+// 内部のusing namespace std;が他のプログラムを破壊する可能性があるため、
+// ライブラリ全体をnamespaceで囲っている。
+namespace trace_library
+{
+    using namespace std;
+
+    //@brief 記録する1つのイベント
+    //@note phase が 'X' なら区間、'C' ならカウンタ
+    struct TraceEvent
+    {
+        const char *name;
+        uint64_t begin_cycles;
+        uint64_t duration_cycles;
+        double value;
+        uint32_t thread_id;
+        char phase;
+    };
+
+    //@brief イベントを保存するリングバッファ
+    //@note 複数のスレッドから同時に記録してもよい
+    class TraceBuffer
+    {
+    public:
+        explicit TraceBuffer(size_t capacity) : events_(capacity), head_(0) {}
+
+        ~TraceBuffer()
+        {
+            flush(THUNDER_TRACE_FILE);
+        }
+
+        void add_complete(const char *name, uint64_t begin_cycles, uint64_t end_cycles)
+        {
+            TraceEvent &event = next();
+            event = {name, begin_cycles, end_cycles - begin_cycles, 0, get_thread_id(), 'X'};
+        }
+
+        void add_counter(const char *name, double value)
+        {
+            TraceEvent &event = next();
+            event = {name, timer_library::read_cycles(), 0, value, get_thread_id(), 'C'};
+        }
+
+        //@brief 保存しているイベントをJSONに書き出す
+        void flush(const char *path)
+        {
+            ofstream ofs(path);
+            if (!ofs)
+            {
+                return;
+            }
+            size_t head = head_.load();
+            size_t size = min(head, events_.size());
+            uint64_t start_cycles = timer_library::timer.start_cycles;
+            double us_per_cycle = 1e6 / timer_library::Timer::get_cycles_per_second();
+
+            ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            for (size_t i = head - size; i < head; ++i)
+            {
+                const TraceEvent &event = events_[i % events_.size()];
+                double ts = (int64_t)(event.begin_cycles - start_cycles) * us_per_cycle;
+                ofs << "{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase
+                    << "\",\"pid\":0,\"tid\":" << event.thread_id << ",\"ts\":" << fixed << setprecision(3) << ts;
+                if (event.phase == 'X')
+                {
+                    ofs << ",\"dur\":" << event.duration_cycles * us_per_cycle;
+                }
+                else
+                {
+                    ofs << ",\"args\":{\"value\":" << defaultfloat << event.value << "}";
+                }
+                ofs << (i + 1 == head ? "}\n" : "},\n");
+            }
+            ofs << "]}\n";
+        }
+
+    private:
+        vector<TraceEvent> events_;
+        atomic<size_t> head_;
+
+        TraceEvent &next()
+        {
+            return events_[head_.fetch_add(1, memory_order_relaxed) % events_.size()];
+        }
+
+        // スレッドごとに0から順に番号を振る
+        static uint32_t get_thread_id()
+        {
+            static atomic<uint32_t> counter = 0;
+            thread_local uint32_t id = counter.fetch_add(1);
+            return id;
+        }
+    };
+
+    //@brief 全体で共有するバッファ
+    //@note プログラム終了時に破棄され、そのときにファイルへ書き出す
+    inline TraceBuffer &trace_buffer()
+    {
+        static TraceBuffer buffer(THUNDER_TRACE_CAPACITY);
+        return buffer;
+    }
+
+    //@brief スコープに入ってから出るまでを1つの区間として記録する
+    struct ScopedTrace
+    {
+        const char *name;
+        uint64_t begin;
+
+        explicit ScopedTrace(const char *name) : name(name), begin(timer_library::read_cycles()) {}
+
+        ~ScopedTrace()
+        {
+            trace_buffer().add_complete(name, begin, timer_library::read_cycles());
+        }
+    };
+} // namespace trace_library
+using namespace trace_library;
+
+#ifdef THUNDER_TRACE
+// このマクロを書いた行からスコープの終わりまでを label という名前の区間として記録する
+#define THUNDER_TRACE_SCOPE(label) \
+    trace_library::ScopedTrace THUNDER_PROFILE_CONCAT(thunder_trace_scope_, __LINE__)(label)
+// name という名前のカウンタの値を記録する
+#define THUNDER_TRACE_COUNTER(name, value) trace_library::trace_buffer().add_counter(name, value)
+#else
+#define THUNDER_TRACE_SCOPE(label)
+#define THUNDER_TRACE_COUNTER(name, value)
+#endif
+#endif
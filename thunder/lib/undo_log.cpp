@@ -0,0 +1,100 @@
+/**************************************************************/
+// State の move_backward で元に戻す値を記録する固定容量のスタック
+// move_forward で変更前の値をまとめて push し、
+// move_backward で pop すると、同じ変数に一度に書き戻される。
+// 使い方
+// UndoLog<Hash, int> history_(max_turn + 1);
+// void move_forward(Action action)
+// {
+//     history_.push(hash_, target_ball_);
+//     ...
+// }
+// void move_backward(Action action)
+// {
+//     ...
+//     history_.pop(hash_, target_ball_);
+// }
+// 容量は構築時に確保し、以降はメモリ確保も容量の確認もしない。
+// 根から最も深いノードまでの深さ(+expandでの仮の遷移分の1)を容量にすればあふれない。
+// 1手分の値は tuple として連続して並ぶので、push, pop はそれぞれ1回のコピーで済む。
+// Stateはビームサーチの開始時にコピーされるので、UndoLog もコピーできるようにしている。
+/**************************************************************/
+#pragma once
+#ifndef UNDO_LOG_HPP
+#define UNDO_LOG_HPP
+#include <bits/stdc++.h>
+// 内部のusing namespace std;が他のプログラムを破壊する可能性があるため、
+// ライブラリ全体をnamespaceで囲っている。
+namespace undo_log_library
+{
+    using namespace std;
+
+    //@brief 1手ごとに Fields... をまとめて記録する固定容量のスタック
+    //@note Fields はデフォルト構築とコピーができる必要がある
+    template <class... Fields>
+    class UndoLog
+    {
+    public:
+        // 1手分の記録
+        using Frame = tuple<Fields...>;
+
+        UndoLog() = default;
+
+        //@param capacity 記録できる手数の上限
+        explicit UndoLog(size_t capacity) : frames_(capacity), size_(0) {}
+
+        //@brief 容量を変更して空にする
+        void reset(size_t capacity)
+        {
+            frames_.assign(capacity, Frame());
+            size_ = 0;
+        }
+
+        //@brief 変更前の値をまとめて記録する
+        void push(const Fields &...fields)
+        {
+            assert(size_ < frames_.size());
+            frames_[size_++] = Frame(fields...);
+        }
+
+        //@brief 最後に記録した1手分の値を fields に書き戻して取り除く
+        void pop(Fields &...fields)
+        {
+            assert(size_ > 0);
+            tie(fields...) = frames_[--size_];
+        }
+
+        //@brief 最後に記録した1手分の値を取り除かずに返す
+        const Frame &top() const
+        {
+            assert(size_ > 0);
+            return frames_[size_ - 1];
+        }
+
+        size_t size() const
+        {
+            return size_;
+        }
+
+        size_t capacity() const
+        {
+            return frames_.size();
+        }
+
+        bool empty() const
+        {
+            return size_ == 0;
+        }
+
+        void clear()
+        {
+            size_ = 0;
+        }
+
+    private:
+        vector<Frame> frames_;
+        size_t size_ = 0;
+    };
+} // namespace undo_log_library
+using namespace undo_log_library;
+#endif
@@ -0,0 +1,105 @@
+/**************************************************************/
+// Zobrist hash を計算するライブラリ
+// 「位置 × 値」の特徴空間を宣言すると、各特徴に割り当てる乱数表をコンパイル時に生成する。
+// 盤面のハッシュは、その盤面が持つ特徴の乱数のXORで表し、
+// 1マスの値が変わったら、古い値と新しい値の乱数をXORするだけで差分更新できる。
+// 使い方
+// using Zobrist = ZobristTable<Hash, n * n, num_colors>;
+// hash = Zobrist::replace(hash, position, old_color, new_color);
+// Hash は uint32_t か uint64_t を指定し、ビームサーチの Hash と揃える。
+// 乱数表は constexpr で作るので、実行時の初期化は不要。
+// 位置と値の組がとても多い(100万を超えるくらい)と、コンパイル時の計算量の上限に達することがある。
+// そのときは -fconstexpr-ops-limit を大きくする。
+/**************************************************************/
+#pragma once
+#ifndef ZOBRIST_HPP
+#define ZOBRIST_HPP
+#include <bits/stdc++.h>
+// 内部のusing namespace std;が他のプログラムを破壊する可能性があるため、
+// ライブラリ全体をnamespaceで囲っている。
+namespace zobrist_library
+{
+    using namespace std;
+
+    //@brief 位置 × 値 の特徴空間に対する Zobrist hash の乱数表
+    //@param Hash ハッシュの型(符号なし整数)
+    //@param NumPositions 位置の数
+    //@param NumValues 1つの位置がとりうる値の数
+    //@param Seed 乱数表を変えたいときに指定する
+    template <class Hash, size_t NumPositions, size_t NumValues = 1, uint64_t Seed = 0x2545f4914f6cdd1dULL>
+    class ZobristTable
+    {
+        static_assert(is_unsigned_v<Hash> && sizeof(Hash) <= sizeof(uint64_t), "Hash must be an unsigned integer of at most 64 bits");
+
+    public:
+        //@brief position に value があることを表す乱数
+        static constexpr Hash get(size_t position, size_t value = 0)
+        {
+            assert(position < NumPositions && value < NumValues);
+            return table_[position * NumValues + value];
+        }
+
+        //@brief position の value を加える、または取り除く
+        static constexpr Hash toggle(Hash hash, size_t position, size_t value = 0)
+        {
+            return hash ^ get(position, value);
+        }
+
+        //@brief position の値を old_value から new_value に変える
+        static constexpr Hash replace(Hash hash, size_t position, size_t old_value, size_t new_value)
+        {
+            return hash ^ get(position, old_value) ^ get(position, new_value);
+        }
+
+        //@brief 全ての位置の値からハッシュを一から計算する
+        //@param values values[position] がその位置の値
+        template <class Values>
+        static constexpr Hash compute(const Values &values)
+        {
+            Hash hash = 0;
+            size_t position = 0;
+            for (const auto &value : values)
+            {
+                hash ^= get(position++, value);
+            }
+            return hash;
+        }
+
+    private:
+        using Table = array<Hash, NumPositions * NumValues>;
+
+        static constexpr uint64_t split_mix64(uint64_t &state)
+        {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        }
+
+        // コンパイラのループ回数の上限にかからないように、位置と値の二重ループで作る
+        static constexpr Table make_table()
+        {
+            Table table{};
+            uint64_t state = Seed;
+            for (size_t position = 0; position < NumPositions; ++position)
+            {
+                for (size_t value = 0; value < NumValues; ++value)
+                {
+                    Hash hash = 0;
+                    // 0だとXORしても変化しないので引き直す
+                    while (hash == 0)
+                    {
+                        // 上位ビットのほうが質がよいので、32bitのときは上位を使う
+                        hash = (Hash)(split_mix64(state) >> (64 - 8 * sizeof(Hash)));
+                    }
+                    table[position * NumValues + value] = hash;
+                }
+            }
+            return table;
+        }
+
+        static constexpr Table table_ = make_table();
+    };
+} // namespace zobrist_library
+using namespace zobrist_library;
+#endif
@@ -0,0 +1,77 @@
+/**************************************************************/
+// 焼きなまし法のライブラリを使うサンプルコード
+// 全体行数が長そうに見えるが、ライブラリ部分を除くとそれなりに短い。
+// ライブラリ部分はnamespaceで囲っているので、折りたたんで読むことを推奨。
+/**************************************************************/
+
+#include "lib/annealing.cpp"
+using namespace std;
+
+/// @brief TODO: 近傍(状態をどう変えるか)を表す情報
+/// @note revert で元に戻せるだけの情報を持たせる
+struct Neighbor
+{
+    // TODO: 何書いてもいい
+};
+
+/// @brief TODO: コストを表す型を算術型で指定(e.g. int, long long, double)
+using Cost = int;
+
+/// @brief TODO: 焼きなます状態
+/// @note propose, apply, revert, evaluate の4つのメソッドを実装する必要がある
+/// @note template<typename Random>を最初に記述する必要がある
+template <typename Random>
+class StateBase
+{
+
+public:
+    /// @brief TODO: 近傍を1つ乱択してneighborに書く
+    /// @note 状態は変えない
+    void propose([[maybe_unused]] Neighbor &neighbor, [[maybe_unused]] Random &random)
+    {
+    }
+
+    /// @brief TODO: neighborに遷移する
+    void apply([[maybe_unused]] const Neighbor &neighbor)
+    {
+    }
+
+    /// @brief TODO: applyする前の状態に戻す
+    /// @param neighbor applyした近傍
+    void revert([[maybe_unused]] const Neighbor &neighbor)
+    {
+    }
+
+    /// @brief TODO: 今のコストを返す(小さいほどよい)
+    Cost evaluate() const
+    {
+        return 0;
+    }
+
+    // 任意: 遷移せずにコストの変化量を計算できるなら実装すると速い
+    // Cost delta(const Neighbor &neighbor) const
+    // {
+    //     return 0;
+    // }
+};
+
+// TODO: Neighbor,Cost,StateBase の定義より後に以下を記述
+using AnnealingUser = SimulatedAnnealing<Neighbor, Cost, StateBase>;
+AnnealingUser annealing;
+using State = StateBase<AnnealingUser::Random>;
+// TODO: ここまで
+
+int main()
+{
+    // 適切な設定を問題ごとに指定
+    AnnealingUser::Config config = {
+        .time_limit = 1.9,
+        .start_temperature = 0,
+        .end_temperature = 0,
+    };
+    State state;
+    auto result = annealing.anneal(config, state);
+    // result.stateを問題設定に従い標準出力に掃き出す
+    cerr << "cost: " << result.cost << ", iterations: " << result.iterations << ", accepted: " << result.accepted << endl;
+    return 0;
+}
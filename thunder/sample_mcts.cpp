@@ -0,0 +1,83 @@
+/**************************************************************/
+// モンテカルロ木探索のライブラリを使うサンプルコード
+// 全体行数が長そうに見えるが、ライブラリ部分を除くとそれなりに短い。
+// ライブラリ部分はnamespaceで囲っているので、折りたたんで読むことを推奨。
+/**************************************************************/
+
+#include "lib/mcts.cpp"
+using namespace std;
+
+/// @brief TODO: 1手の行動を表す情報
+/// @note move_backward で元に戻せるだけの情報は State 側で覚えてもよい
+struct Action
+{
+    // TODO: 何書いてもいい
+};
+
+/// @brief TODO: 探索する状態
+/// @note legal_actions, move_forward, move_backward, is_terminal, evaluate の5つのメソッドを実装する必要がある
+class State
+{
+
+public:
+    /// @brief TODO: 今の状態で選べる行動を actions に入れる
+    /// @param actions 空の配列
+    void legal_actions([[maybe_unused]] vector<Action> &actions)
+    {
+    }
+
+    /// @brief TODO: action を実行して次の状態に遷移する
+    /// @note 遷移に乱数が絡むなら State が持つ乱数を使い、戻すための情報を覚えておく
+    void move_forward([[maybe_unused]] const Action &action)
+    {
+    }
+
+    /// @brief TODO: action を実行する前の状態に戻る
+    void move_backward([[maybe_unused]] const Action &action)
+    {
+    }
+
+    /// @brief TODO: 終了状態か
+    bool is_terminal() const
+    {
+        return true;
+    }
+
+    /// @brief TODO: 今の状態の報酬を返す(大きいほどよい)
+    /// @note 0以上1以下にそろえると exploration を調整しやすい
+    double evaluate() const
+    {
+        return 0;
+    }
+
+    // 任意: 複数のスレッドで探索するとき、スレッドごとに乱数の種を変える
+    // void reseed(uint64_t seed)
+    // {
+    // }
+};
+
+// TODO: Action,State の定義より後に以下を記述
+using MCTSUser = MonteCarloTreeSearch<Action, State>;
+MCTSUser mcts;
+// TODO: ここまで
+
+int main()
+{
+    State state;
+    while (!state.is_terminal())
+    {
+        // 適切な設定を問題ごとに指定
+        MCTSUser::Config config = {
+            .time_limit = timer_library::timer.getTime() + 0.01,
+            .nodes_capacity = 100000,
+        };
+        auto action = mcts.search(config, state);
+        if (!action)
+        {
+            break;
+        }
+        // *actionを問題設定に従い標準出力に掃き出す
+        state.move_forward(*action);
+    }
+    return 0;
+}
@@ -47,6 +47,9 @@ public:
 
             multi_selectors.push(new_action, new_cost, new_hash, parent, finished, skip_count);
         }
+        // 任意: 複数のactionの列を1つの候補にするときは、列をそのまま渡す(Actionを列の分だけ大きくしなくてよい)
+        // Action run[2] = {first_action, second_action};
+        // multi_selectors.push_run(run, 2, new_cost, new_hash, parent, finished, skip_count);
     }
 
     /// @brief TODO: actionを実行して次の状態に遷移する
@@ -59,6 +62,15 @@ public:
     void move_backward(const Action action)
     {
     }
+
+    // 任意: push_run で渡した列をまとめて実行する、またはまとめて戻す
+    // 列のactionを順に move_forward した場合と同じ状態にする。実装しなければ1つずつ move_forward, move_backward する
+    // void move_forward_run(const Action *actions, size_t length)
+    // {
+    // }
+    // void move_backward_run(const Action *actions, size_t length)
+    // {
+    // }
 };
 
 // TODO: Hash,Action,Cost,StateBase の定義より後に以下を記述